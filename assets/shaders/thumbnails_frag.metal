@@ -0,0 +1,14 @@
+using namespace metal;
+
+struct VertexOut
+{
+    float4 position [[position]];
+    float2 uv;
+};
+
+fragment float4 fragment_main(VertexOut vert [[stage_in]],
+                              texture2d<float, access::sample> atlas,
+                              sampler atlas_sampler)
+{
+    return atlas.sample(atlas_sampler, vert.uv);
+}
@@ -0,0 +1,19 @@
+precision mediump float;
+
+// one instance per thumbnail: a unit quad is stretched over the thumbnail's rectangle in the grid
+in vec2 corner;  // per vertex, in [0,1]^2
+in vec4 rect;    // per instance, position and size of the thumbnail in the grid (in points, y down)
+in vec4 uv_rect; // per instance, top-left and bottom-right texture coordinates in the atlas
+
+uniform vec2  view_size; // size of the visible part of the grid (in points)
+uniform float scroll;    // vertical scroll offset of the grid (in points)
+
+out vec2 uv;
+
+void main()
+{
+    vec2 pos = (rect.xy + corner * rect.zw - vec2(0.0, scroll)) / view_size;
+    // the target is displayed with ImGui::Image(), which puts texture row 0 at the top, so render upside down
+    gl_Position = vec4(2.0 * pos - 1.0, 0.5, 1.0);
+    uv          = mix(uv_rect.xy, uv_rect.zw, corner);
+}
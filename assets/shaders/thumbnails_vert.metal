@@ -0,0 +1,24 @@
+using namespace metal;
+
+struct VertexOut
+{
+    float4 position [[position]];
+    float2 uv;
+};
+
+// one instance per thumbnail: a unit quad is stretched over the thumbnail's rectangle in the grid
+vertex VertexOut vertex_main(const device float2 *corner,  // per vertex, in [0,1]^2
+                             const device float4 *rect,    // per instance, position and size in the grid (points)
+                             const device float4 *uv_rect, // per instance, texture coordinates in the atlas
+                             constant float2 &view_size,
+                             constant float &scroll,
+                             uint id [[vertex_id]],
+                             uint instance [[instance_id]])
+{
+    float2 pos = (rect[instance].xy + corner[id] * rect[instance].zw - float2(0.0, scroll)) / view_size;
+
+    VertexOut vert = {};
+    vert.position  = float4(2.0 * pos.x - 1.0, 1.0 - 2.0 * pos.y, 0.5, 1.0);
+    vert.uv        = mix(uv_rect[instance].xy, uv_rect[instance].zw, corner[id]);
+    return vert;
+}
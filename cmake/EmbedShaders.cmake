@@ -0,0 +1,55 @@
+# Generates a C++ source file that embeds all files in assets/shaders into the executable, together with a table
+# mapping their (compile-time hashed) filenames to their contents, sorted by hash. See include/shader_assets.h.
+#
+# Usage: cmake -DASSETS_DIR=<path to assets> -DOUTPUT=<generated .cpp file> -P EmbedShaders.cmake
+
+cmake_minimum_required(VERSION 3.13)
+
+if(NOT ASSETS_DIR OR NOT OUTPUT)
+  message(FATAL_ERROR "EmbedShaders.cmake: ASSETS_DIR and OUTPUT must be specified.")
+endif()
+
+file(
+  GLOB shaders
+  RELATIVE "${ASSETS_DIR}"
+  "${ASSETS_DIR}/shaders/*"
+)
+list(SORT shaders)
+
+set(contents "// Generated by cmake/EmbedShaders.cmake from the files in assets/shaders. Do not edit.\n\n")
+string(APPEND contents "#include \"shader_assets.h\"\n\n")
+string(APPEND contents "// clang-format off\n")
+
+set(entries "")
+set(i 0)
+foreach(shader ${shaders})
+  file(READ "${ASSETS_DIR}/${shader}" hex HEX)
+  string(LENGTH "${hex}" hex_length)
+  math(EXPR num_bytes "${hex_length} / 2")
+
+  # as string literals of hex escapes, 32 bytes per line: unlike a {0xNN, ...} initializer of a char array, these
+  # accept bytes >= 0x80 (e.g. UTF-8 in comments) without narrowing errors, and keep the table constexpr
+  set(bytes "")
+  set(offset 0)
+  while(offset LESS hex_length)
+    string(SUBSTRING "${hex}" ${offset} 64 line)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "\\\\x\\1" line "${line}")
+    string(APPEND bytes "    \"${line}\"\n")
+    math(EXPR offset "${offset} + 64")
+  endwhile()
+  if(bytes STREQUAL "")
+    set(bytes "    \"\"\n")
+  endif()
+  string(APPEND contents "static constexpr char shader_${i}[] =\n${bytes};\n\n")
+  string(APPEND entries "    {shader_name_hash(\"${shader}\"), \"${shader}\", {shader_${i}, ${num_bytes}}},\n")
+  math(EXPR i "${i} + 1")
+endforeach()
+
+# sorted by hash at compile time (see sort_by_hash()), since CMake cannot compute the 64-bit hashes itself
+string(APPEND contents "static constexpr auto sorted_shaders =\n")
+string(APPEND contents "    sort_by_hash(std::array<EmbeddedShader, ${i}>{{\n${entries}}});\n\n")
+string(APPEND contents "const EmbeddedShader *const embedded_shaders = sorted_shaders.data();\n")
+string(APPEND contents "const size_t num_embedded_shaders = sorted_shaders.size();\n")
+string(APPEND contents "// clang-format on\n")
+
+file(WRITE "${OUTPUT}" "${contents}")
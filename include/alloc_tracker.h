@@ -0,0 +1,104 @@
+/**
+    \file alloc_tracker.h
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+    An opt-in counter of the heap allocations made through the global operator new, per frame and per \ref profiler
+    zone, to find (and keep out) allocations in the frame loop. The goal is a steady-state frame without any.
+
+    alloc_tracker.cpp replaces the global operator new and delete (except for the over-aligned variants) with versions
+    that forward to malloc and free. While tracking is disabled (the default), they only add the check of an atomic
+    flag. While enabled, each allocation is attributed to the innermost CPU zone open on its thread (see \ref
+    profiler::current_zone()), and, if enabled as well, its call stack is captured, which is much slower. Allocations
+    made with malloc directly (e.g. by ImGui, or by C libraries) are not seen.
+
+    Each frame's totals are also reported as the "Heap allocations" and "Heap bytes" profiler counters, so that they
+    show up in the Performance window and in exported traces.
+*/
+namespace alloc_tracker
+{
+
+/// The number of zones whose allocations are counted separately in a frame; the others are merged into "(other)"
+static constexpr size_t max_zones = 64;
+
+/// The number of distinct call stacks kept; later ones are merged into the counts of the frame and the zone only
+static constexpr size_t max_stacks = 1024;
+
+/// The number of return addresses captured for each call stack
+static constexpr size_t max_stack_depth = 16;
+
+/// Is capturing call stacks supported on this platform?
+bool stacks_supported();
+
+/// Enable or disable counting allocations (disabled by default)
+void set_enabled(bool enabled);
+
+/// Is counting allocations enabled?
+bool enabled();
+
+/// Enable or disable capturing the call stack of each allocation while counting (disabled by default)
+void set_capture_stacks(bool capture);
+
+/// Is capturing call stacks enabled?
+bool capture_stacks();
+
+/// Set the number of allocations per frame above which a frame is over budget (0 by default)
+void set_budget(size_t allocations);
+
+/// Return the number of allocations per frame above which a frame is over budget
+size_t budget();
+
+/// The allocations made within one zone during a frame
+struct Zone
+{
+    const char *label       = nullptr; ///< interned by the profiler, or nullptr for allocations outside any zone
+    size_t      allocations = 0;
+    size_t      bytes       = 0;
+};
+
+/// The allocations made during a frame
+struct Frame
+{
+    uint64_t index       = 0; ///< profiler frame index
+    size_t   allocations = 0;
+    size_t   bytes       = 0;
+    size_t   frees       = 0;
+    size_t   num_zones   = 0;
+    Zone     zones[max_zones + 1]; ///< the zones that allocated, most allocations first (+1 for "(other)")
+};
+
+/// Finish the current frame's counts. Call once per frame from the main thread, before \ref profiler::new_frame().
+void new_frame();
+
+/// Return the counts of the last finished frame
+const Frame &last_frame();
+
+/// Return the number of frames over budget since tracking was enabled
+uint64_t frames_over_budget();
+
+/// A call stack that allocated, with its counts summed over all frames since stacks were last cleared
+struct Stack
+{
+    void       *frames[max_stack_depth] = {};
+    size_t      depth                   = 0;
+    const char *zone                    = nullptr; ///< the zone the first allocation was made in
+    size_t      allocations             = 0;
+    size_t      bytes                   = 0;
+};
+
+/// Return the \p count call stacks with the most allocations, most first
+std::vector<Stack> top_stacks(size_t count);
+
+/// Forget the captured call stacks
+void clear_stacks();
+
+/// Return a human-readable description of each return address of a call stack (e.g. a function name and offset)
+std::vector<std::string> symbolize(const Stack &stack);
+
+} // namespace alloc_tracker
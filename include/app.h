@@ -36,10 +36,16 @@ using namespace linalg::aliases;
 
 #include "arcball.h"
 #include "hello_imgui/hello_imgui.h"
+#include "hitch_detector.h"
 #include "misc/cpp/imgui_stdlib.h"
+#include "performance_window.h"
 #include "renderpass.h"
 #include "shader.h"
+#include "shader_queue.h"
 #include "texture.h"
+#ifndef __EMSCRIPTEN__
+#include "thumbnail_browser.h"
+#endif
 #include <map>
 #include <string>
 #include <vector>
@@ -58,10 +64,70 @@ public:
     void draw_background();
     void run();
 
+    /// Set the frame time (in milliseconds) above which frames are logged as hitches
+    void set_hitch_threshold(float ms)
+    {
+        m_hitches.set_threshold(ms);
+    }
+
+    /// Print the startup breakdown as JSON and exit once the first frame has been presented
+    void set_startup_report(bool report)
+    {
+        m_startup_report = report;
+    }
+
 private:
     RenderPass *m_render_pass = nullptr;
     Shader     *m_shader      = nullptr;
     Texture    *m_null_image  = nullptr;
+    Texture    *m_image       = nullptr; ///< The opened image, if any (shown in place of m_null_image)
+
+    /// Show \p image (taking ownership of it) in place of the previously opened one, which is deleted
+    void set_image(Texture *image);
+
+    Texture    *m_layer                = nullptr; ///< Cached rendering of the image layer, composited onto the screen
+    RenderPass *m_layer_pass           = nullptr; ///< Renders into m_layer, only when the layer is damaged
+    Shader     *m_layer_shader         = nullptr; ///< The shader that last rendered m_layer...
+    uint64_t    m_layer_revision       = 0;       ///< ...and its Shader::revision() at the time...
+    uint64_t    m_layer_image_revision = 0;       ///< ...and the Texture::revision() of the image it showed
+
+    /// How the image layer is anti-aliased
+    enum class Antialiasing
+    {
+        None,
+        MSAA,       ///< render into a multisampled target and resolve it into m_layer
+        Supersample ///< render at twice the resolution and downsample into m_layer
+    };
+    Antialiasing m_aa         = Antialiasing::None;
+    int          m_aa_samples = 4;       ///< samples per pixel for Antialiasing::MSAA
+    Texture     *m_aa_target  = nullptr; ///< Multisampled or supersampled rendering of the layer, if any
+    RenderPass  *m_aa_pass    = nullptr; ///< Renders into m_aa_target
+
+    map<const char *, int64_t> m_aa_gpu_ns; ///< Last measured GPU time of a layer redraw, by GPU timer label
+
+    /// Return the render pass the image layer should be drawn with, (re)creating the anti-aliasing target if needed
+    RenderPass *layer_render_pass();
+
+    /// Return the GPU timer label of a layer redraw with the given anti-aliasing settings
+    static const char *aa_label(Antialiasing aa, int samples);
+
+    ShaderQueue m_shader_queue; ///< Shaders still being compiled by the driver
+
+    PerformanceWindow m_performance; ///< Contents of the "Performance" window
+    HitchDetector     m_hitches;     ///< Logs frames that took too long
+
+    bool m_first_frame_started = false; ///< Has the first frame begun (so that the next one means it was presented)?
+    bool m_startup_report      = false; ///< See set_startup_report()
+
+#ifndef __EMSCRIPTEN__
+    ThumbnailBrowser *m_thumbnails = nullptr; ///< Created when a directory is first browsed
+
+    /// Load an image file and show it
+    void open_image(const string &filename);
+
+    /// Show the images in a directory in the "Thumbnails" window
+    void browse_directory(const string &directory);
+#endif
 
     map<int, ImFont *> m_regular, m_bold; // regular and bold fonts at various sizes
 
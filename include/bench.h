@@ -0,0 +1,107 @@
+/**
+    \file bench.h
+*/
+#pragma once
+
+#include "timer.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/**
+    The pieces shared by the benchmarks of HelloGuiExperiments_bench: its options, its results and the timing loop.
+
+    The CPU benchmarks are in bench.cpp, the GPU benchmarks (which need EGL to create an OpenGL context without a
+    window) in bench_gpu.cpp, and the replay of captures (see \ref capture) in bench_replay.cpp.
+*/
+namespace bench
+{
+
+/// Timed batches per benchmark; the median is reported
+static constexpr int num_samples = 5;
+
+struct Options
+{
+    std::string              output;           ///< file to write the JSON report to (none if empty)
+    std::string              baseline;         ///< JSON report to compare against (none if empty)
+    double                   tolerance = 10.0; ///< slowdown (in percent) relative to the baseline that is a regression
+    double                   min_time  = 0.5;  ///< seconds spent timing each benchmark
+    std::string              filter;           ///< only run the benchmarks whose name contains this
+    std::vector<std::string> images;           ///< image files to decode in addition to the generated ones
+    bool                     gpu   = false;    ///< also run the GPU benchmarks
+    int                      draws = 1000;     ///< number of draw calls in the draw call overhead benchmark
+    std::vector<std::string> replays;          ///< captures to replay instead of running the other benchmarks
+};
+
+struct Result
+{
+    std::string name;
+    int64_t     iterations  = 0;
+    double      ns_per_iter = 0.0;
+    size_t      bytes       = 0;   ///< bytes processed per iteration (0 if a throughput makes no sense)
+    double      baseline_ns = 0.0; ///< ns per iteration in the baseline (0 if not in the baseline)
+};
+
+/// Consumes results so that the compiler cannot optimize the benchmarked work away
+inline volatile size_t sink = 0;
+
+/**
+    Time \p f and append the result to \p results, unless it is filtered out.
+
+    The batch size is first grown until a batch takes about min_time / num_samples (which also warms up the caches),
+    then num_samples batches are timed and the median time per call is reported.
+*/
+template <typename F>
+void run(const Options &opt, std::vector<Result> &results, const std::string &name, size_t bytes, F &&f)
+{
+    if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos)
+        return;
+
+    const double sample_ns = opt.min_time * 1e9 / num_samples;
+
+    int64_t batch = 1;
+    for (;;)
+    {
+        Timer timer;
+        for (int64_t i = 0; i < batch; ++i)
+            f();
+        double ns = (double)timer.elapsed_ns();
+        if (ns >= sample_ns || batch >= (int64_t(1) << 40))
+            break;
+        batch = int64_t(batch * std::clamp(ns > 0.0 ? 1.2 * sample_ns / ns : 10.0, 2.0, 10.0));
+    }
+
+    double samples[num_samples];
+    for (auto &s : samples)
+    {
+        Timer timer;
+        for (int64_t i = 0; i < batch; ++i)
+            f();
+        s = (double)timer.elapsed_ns() / batch;
+    }
+    std::sort(std::begin(samples), std::end(samples));
+
+    results.push_back({name, batch * (num_samples + 1), samples[num_samples / 2], bytes});
+}
+
+/**
+    Create an OpenGL context without a window and run the GPU benchmarks: drawing the image shader at several
+    resolutions and texture formats, texture uploads and readbacks, and the overhead of many small draw calls.
+
+    Returns a description of the renderer (e.g. "llvmpipe (LLVM 15.0.7, 256 bits), 4.5 (Core Profile) Mesa 23.2.1").
+    Throws if no OpenGL context can be created.
+*/
+std::string run_gpu(const Options &opt, std::vector<Result> &results);
+
+/**
+    Create an OpenGL context without a window and replay each capture in opt.replays: once frame by frame, waiting for
+    the GPU at the end of each frame, which gives the median and 95th percentile frame times, and then as a whole,
+    repeatedly, like any other benchmark.
+
+    Returns a description of the renderer. Throws if no OpenGL context can be created, or if a capture cannot be read.
+*/
+std::string run_replays(const Options &opt, std::vector<Result> &results);
+
+} // namespace bench
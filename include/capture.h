@@ -0,0 +1,297 @@
+/**
+    \file capture.h
+*/
+#pragma once
+
+#include "linalg.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+class Texture;
+class RenderPass;
+class Shader;
+class DrawList;
+
+/**
+    Records the calls made to the public methods of \ref Texture, \ref RenderPass and \ref Shader, with their
+    payloads, into a compact binary file, so that a session can be replayed (and timed) offline with
+    `HelloGuiExperiments_bench --replay`.
+
+    Each object gets a small integer id when it is created. A call is recorded as its \ref Op followed by the id of
+    the object and the arguments, with integers as (zigzag) LEB128 varints and floats as raw little-endian bytes.
+    Payloads of 64 bytes or more (texture pixels, buffer contents, shader sources) are stored once as a \ref Op::Blob
+    record the first time their contents are seen, and referred to by id after that, so re-uploading unchanged data
+    costs a few bytes.
+
+    Only the outermost call is recorded, e.g. \ref RenderPass::resize() but not the resizes of its targets, or the
+    draws of the clear shader within \ref RenderPass::begin() on Metal. Calls on objects created before the capture
+    started, or through other constructors (e.g. \ref ComputeShader), are not recorded, so a capture should be started
+    before any rendering objects are created.
+*/
+namespace capture
+{
+
+/// The records of a capture, and (in parentheses) the arguments that follow the id of the object
+enum class Op : uint8_t
+{
+    Frame,                  ///< start of a new frame (no object)
+    Blob,                   ///< a payload referred to by later records (blob id, size, bytes; no object)
+    CreateTexture,          ///< (type, pixel and component format, size, depth, min and mag interpolation, wrap mode,
+                            ///< samples, flags, manual mipmapping)
+    DestroyTexture,         ///< ()
+    TextureUpload,          ///< (pixels)
+    TextureUploadSubRegion, ///< (pixels, int2 origin, int2 size)
+    TextureUploadSubVolume, ///< (pixels, int3 origin, int3 size)
+    TextureDownload,        ///< ()
+    TextureResize,          ///< (size)
+    TextureGenerateMipmap,  ///< ()
+    CreateRenderPass,       ///< (color targets, depth target, clear, write depth), where no targets at all means the
+                            ///< default framebuffer
+    DestroyRenderPass,      ///< ()
+    RenderPassBegin,        ///< ()
+    RenderPassEnd,          ///< ()
+    RenderPassClearColor,   ///< (color)
+    RenderPassClearDepth,   ///< (depth)
+    RenderPassDepthTest,    ///< (depth test, depth write)
+    RenderPassViewport,     ///< (offset, size)
+    RenderPassCullMode,     ///< (cull mode)
+    RenderPassResize,       ///< (size)
+    RenderPassBlitTo,       ///< (source offset, source size, destination pass, destination offset)
+    RenderPassResolve,      ///< (target, index)
+    CreateShader,           ///< (render pass, name, vertex source, fragment source, blend mode)
+    DestroyShader,          ///< ()
+    ShaderSetBuffer,        ///< (name, type, shape, data)
+    ShaderBufferDivisor,    ///< (name, divisor)
+    ShaderBufferOffset,     ///< (name, offset)
+    ShaderBufferUsage,      ///< (name, usage)
+    ShaderSetTexture,       ///< (name, texture)
+    ShaderBegin,            ///< ()
+    ShaderEnd,              ///< ()
+    ShaderDrawArray,        ///< (primitive type, offset, count, indexed, instances)
+    ShaderDrawList,         ///< (primitive type, indexed, commands)
+    Count
+};
+
+/// A payload argument (e.g. pixels); \p data may be nullptr
+struct Blob
+{
+    const void *data;
+    size_t      size;
+};
+
+/// The dimensions of an array argument (e.g. of a shader buffer)
+struct Shape
+{
+    size_t        ndim;
+    const size_t *dims;
+
+    /// Return the number of elements
+    size_t count() const
+    {
+        size_t result = 1;
+        for (size_t i = 0; i < ndim; ++i)
+            result *= dims[i];
+        return result;
+    }
+};
+
+/// Start recording into \p filename, replacing any capture in progress. Throws if the file cannot be created.
+void start(const std::string &filename);
+
+/// Finish the capture (if any) and close its file
+void stop();
+
+/// Is a capture being recorded?
+bool recording();
+
+/// Return the number of bytes written to the capture so far
+uint64_t bytes_written();
+
+/// Mark the start of a new frame. Call once per frame from the main thread.
+void new_frame();
+
+/// \name Writing records (used through \ref capture::Call)
+/// @{
+bool begin_record(Op op, const void *object); ///< returns false (and records nothing) if the object is unknown
+void end_record(Op op, const void *object);
+void put_varint(uint64_t value);
+void put_bytes(const void *data, size_t size);
+void put_blob(const void *data, size_t size);
+void put_object(const void *object);
+/// @}
+
+inline void put(bool value)
+{
+    put_varint(value);
+}
+
+template <typename T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>, int> = 0>
+void put(T value)
+{
+    if constexpr (std::is_enum_v<T>)
+        put_varint((uint64_t)value);
+    else if constexpr (std::is_signed_v<T>)
+        put_varint(((uint64_t)value << 1) ^ (uint64_t)(int64_t(value) >> 63));
+    else
+        put_varint((uint64_t)value);
+}
+
+inline void put(float value)
+{
+    put_bytes(&value, sizeof(value));
+}
+
+template <typename T, int M>
+void put(const linalg::vec<T, M> &value)
+{
+    for (int i = 0; i < M; ++i)
+        put(value[i]);
+}
+
+inline void put(std::string_view value)
+{
+    put_varint(value.size());
+    put_bytes(value.data(), value.size());
+}
+
+inline void put(const Blob &blob)
+{
+    put_blob(blob.data, blob.size);
+}
+
+inline void put(const Texture *texture)
+{
+    put_object(texture);
+}
+
+inline void put(const RenderPass *pass)
+{
+    put_object(pass);
+}
+
+inline void put(const Shader *shader)
+{
+    put_object(shader);
+}
+
+/// Written as the number of dimensions, followed by the dimensions
+inline void put(const Shape &shape)
+{
+    put_varint(shape.ndim);
+    for (size_t i = 0; i < shape.ndim; ++i)
+        put_varint(shape.dims[i]);
+}
+
+/// Written as the number of targets, followed by the targets
+void put(const std::vector<Texture *> &targets);
+
+/// Written as the number of commands, followed by the offset, count, instances and base instance of each
+void put(const DrawList &list);
+
+/// Mark the calling thread as being inside a call, and return whether it is the outermost one
+bool enter();
+
+/// Leave the call entered with \ref enter()
+void leave();
+
+/**
+    Records a call (if capturing and if it is the outermost one) when constructed, and stays alive for the duration
+    of the call, so that the calls made from within it are not recorded.
+*/
+class Call
+{
+public:
+    template <typename Object, typename... Args>
+    Call(Op op, const Object *object, const Args &...args)
+    {
+        if (!enter() || !recording() || !begin_record(op, object))
+            return;
+        (put(args), ...);
+        end_record(op, object);
+    }
+    ~Call()
+    {
+        leave();
+    }
+
+    Call(const Call &)            = delete;
+    Call &operator=(const Call &) = delete;
+};
+
+/**
+    Reads the records of a capture, which is loaded into memory as a whole.
+
+    Blob records are handled internally: \ref op() skips them, and \ref blob() returns the payloads they hold.
+*/
+class Reader
+{
+public:
+    /// Load \p filename. Throws if it cannot be read or is not a capture.
+    explicit Reader(const std::string &filename);
+
+    /// Go back to the first record
+    void rewind();
+
+    /// Have all records been read?
+    bool done();
+
+    /// Read the next record's operation (followed by its object id, see \ref object(), unless it is Op::Frame)
+    Op op();
+
+    uint64_t varint();
+    int64_t  svarint();
+    float    f32();
+    uint32_t object();
+
+    std::string_view string();
+
+    /// Return a payload (whose data is nullptr if a null pointer was recorded)
+    std::string_view blob();
+
+    template <typename T>
+    T get()
+    {
+        if constexpr (std::is_same_v<T, bool>)
+            return varint() != 0;
+        else if constexpr (std::is_enum_v<T>)
+            return (T)varint();
+        else if constexpr (std::is_floating_point_v<T>)
+            return f32();
+        else if constexpr (std::is_signed_v<T>)
+            return (T)svarint();
+        else
+            return (T)varint();
+    }
+
+    template <typename T, int M>
+    linalg::vec<T, M> vec()
+    {
+        linalg::vec<T, M> result;
+        for (int i = 0; i < M; ++i)
+            result[i] = get<T>();
+        return result;
+    }
+
+    /// Return the size of the capture in bytes
+    size_t size() const
+    {
+        return m_data.size();
+    }
+
+protected:
+    void    need(size_t bytes);
+    uint8_t byte();
+    void    read_blobs(); ///< read the blob records (if any) at the current position
+
+    std::string                                    m_data;
+    size_t                                         m_pos   = 0;
+    size_t                                         m_start = 0; ///< position of the first record
+    std::unordered_map<uint64_t, std::string_view> m_blobs;
+};
+
+} // namespace capture
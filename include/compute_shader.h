@@ -0,0 +1,84 @@
+/**
+    \file compute_shader.h
+*/
+#pragma once
+
+#include "linalg.h"
+#include "shader.h"
+
+using namespace linalg::aliases;
+
+/**
+    A compute kernel, with the same argument model as \ref Shader.
+
+    The arguments are reflected from the program when it is linked, and set by name: uniforms with \ref
+    set_uniform(), samplers with \ref set_texture(), images (for load/store) with \ref set_image(), and shader storage
+    buffers with \ref set_buffer(). Storage buffers are untyped, i.e. they accept data of any type and shape, since
+    their layout is up to the shader; passing \c nullptr data just allocates them (e.g. for results). \ref dispatch()
+    sends the arguments that changed and launches a grid of work groups.
+
+    Writes made by a dispatch are not guaranteed to be visible to later commands until a \ref memory_barrier() that
+    covers the way they are going to be read.
+
+    Compute shaders require OpenGL 4.3 (or ARB_compute_shader), so they are unavailable on OpenGL ES / WebGL, where the
+    constructor throws (see \ref supported()). There is no Metal implementation: Metal builds only define \ref
+    supported() (which returns false), so any other use fails to link.
+*/
+class ComputeShader : protected Shader
+{
+public:
+    /// Ways in which the results of a dispatch can be consumed (a combination of these is passed to \ref
+    /// memory_barrier())
+    enum Barrier : uint32_t
+    {
+        ImageAccess       = 1 << 0, ///< image load/store in later dispatches or draws
+        TextureFetch      = 1 << 1, ///< sampling textures that were written as images
+        StorageAccess     = 1 << 2, ///< storage buffer reads and writes in later dispatches or draws
+        VertexInput       = 1 << 3, ///< using storage buffers as vertex or index buffers
+        BufferTransfer    = 1 << 4, ///< \ref download_buffer() and buffer updates
+        TextureTransfer   = 1 << 5, ///< \ref Texture::download() and texture uploads
+        FramebufferAccess = 1 << 6, ///< rendering into (or blitting) textures that were written as images
+        AllBarriers       = 0x7f
+    };
+
+    using Shader::Async;
+
+    /// Compile and link the compute shader source (without a \c \#version line, which is added automatically)
+    ComputeShader(const std::string &name, const std::string &cs_source);
+
+    /// Submit the compute shader for compilation without waiting for it; see \ref Shader::Shader(..., Async)
+    ComputeShader(const std::string &name, const std::string &cs_source, Async);
+
+    using Shader::name;
+    using Shader::poll;
+    using Shader::ready;
+    using Shader::revision;
+    using Shader::set_buffer;
+    using Shader::set_buffer_usage;
+    using Shader::set_texture;
+    using Shader::set_uniform;
+
+    /// Does the current context support compute shaders?
+    static bool supported();
+
+    /// Bind a texture to a named image uniform (e.g. an \c image2D) for load/store, at mip level 0 with read/write access
+    void set_image(const std::string &name, Texture *texture);
+
+    /// Read back \p size bytes of a storage buffer, starting at byte \p offset
+    void download_buffer(const std::string &name, void *data, size_t size, size_t offset = 0);
+
+    /// Return the work group size declared by the shader (its \c local_size_x/y/z layout qualifiers)
+    int3 local_size() const;
+
+    /// Launch \c groups.x * \c groups.y * \c groups.z work groups
+    void dispatch(const int3 &groups);
+
+    /// Launch enough work groups to cover (at least) the given number of invocations in each dimension
+    void dispatch_threads(const int3 &threads);
+
+    /// Make the writes of previous dispatches visible to the given kinds of later accesses (see \ref Barrier)
+    static void memory_barrier(uint32_t barriers = AllBarriers);
+
+private:
+    mutable int3 m_local_size = int3{0}; ///< queried on first use
+};
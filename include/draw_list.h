@@ -0,0 +1,108 @@
+/**
+    \file draw_list.h
+*/
+#pragma once
+
+#include "shader.h"
+#include <cstdint>
+#include <vector>
+
+/**
+    Records many independent draws against a shader's shared vertex/index buffers so they can be submitted together.
+
+    Draws that are contiguous continuations of the previous one (with the same instancing parameters) are merged as
+    they are recorded. On OpenGL 4.3+ (or with ARB_multi_draw_indirect), \ref Shader::draw() then submits all
+    remaining draws with a single glMultiDrawArraysIndirect/glMultiDrawElementsIndirect call; elsewhere it falls back to
+    one draw call per recorded command.
+*/
+class DrawList
+{
+public:
+    /// A single recorded draw
+    struct Command
+    {
+        uint32_t offset;        ///< first vertex (or index, for indexed draws)
+        uint32_t count;         ///< number of vertices (or indices)
+        uint32_t instances;     ///< number of instances (at least 1)
+        uint32_t base_instance; ///< instance index of the first instance
+    };
+
+    /**
+        Create an empty draw list.
+
+        \param primitive_type
+            The type of geometry that all draws in this list render
+
+        \param indexed
+            Do the draws index into the shader's \c indices buffer?
+    */
+    DrawList(Shader::PrimitiveType primitive_type, bool indexed = false);
+
+    /// Release all resources
+    ~DrawList();
+
+    DrawList(const DrawList &)            = delete;
+    DrawList &operator=(const DrawList &) = delete;
+
+    /// Remove all recorded draws (keeping the allocated memory)
+    void clear();
+
+    /**
+        Record a draw (see \ref Shader::draw_array() for the meaning of the parameters).
+
+        As for \ref Shader::draw_array(), \p instances == 0 means a single, non-instanced draw, so it is recorded as
+        one instance: every submission path then draws it exactly once.
+    */
+    void add(size_t offset, size_t count, size_t instances = 1, size_t base_instance = 0);
+
+    Shader::PrimitiveType primitive_type() const
+    {
+        return m_primitive_type;
+    }
+
+    bool indexed() const
+    {
+        return m_indexed;
+    }
+
+    /// Return the recorded (merged) draw commands
+    const std::vector<Command> &commands() const
+    {
+        return m_commands;
+    }
+
+    /// Return the number of draws recorded with \ref add() since the last \ref clear()
+    size_t draws() const
+    {
+        return m_draws;
+    }
+
+    /// Return the number of draw calls issued by the last submission
+    size_t calls() const
+    {
+        return m_calls;
+    }
+
+    /// Return how many of the recorded draws were merged away (did not require a draw call of their own)
+    size_t merged() const
+    {
+        return m_draws - m_calls;
+    }
+
+protected:
+    friend class Shader;
+
+    Shader::PrimitiveType m_primitive_type;
+    bool                  m_indexed;
+    std::vector<Command>  m_commands;
+    size_t                m_draws = 0;
+    size_t                m_calls = 0;
+
+#if defined(HELLOIMGUI_HAS_OPENGL)
+    std::vector<uint32_t> m_indirect_data;           ///< commands in the layout expected by glMultiDraw*Indirect
+    uint32_t              m_indirect_buffer   = 0;
+    size_t                m_indirect_capacity = 0;
+    size_t                m_indirect_base     = 0;    ///< index buffer offset baked into the uploaded commands
+    bool                  m_indirect_dirty    = true; ///< do the commands need to be uploaded again?
+#endif
+};
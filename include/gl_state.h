@@ -0,0 +1,115 @@
+/**
+    \file gl_state.h
+*/
+#pragma once
+
+#include "linalg.h"
+#include <cstdint>
+
+/**
+    A small process-wide shadow of the OpenGL state that \ref Shader, \ref RenderPass and \ref Texture change.
+
+    All of our state changes go through these functions, so that calls which would not change anything never reach
+    the driver, and so that saving state (e.g. in \ref RenderPass::begin()) can read the shadow instead of issuing
+    glGet* queries, which stall the pipeline on many drivers and in WebGL. Only state that is not yet known (at
+    startup, or after \ref gl_state::invalidate()) is queried from GL, once.
+
+    Code that changes the same state behind our back (without restoring it afterwards) must either report the change
+    (see \ref gl_state::assume_viewport()) or call \ref gl_state::invalidate(). The ImGui renderer restores everything
+    it touches, so it needs neither. When validation is enabled, \ref gl_state::validate() compares the shadow against
+    the real GL state and reports any drift.
+
+    Parameters are plain integers (GLenum/GLuint) so that this header does not need to pull in the OpenGL headers.
+*/
+namespace gl_state
+{
+
+/// Forget everything we know about the current state
+void invalidate();
+
+/// Equivalent to glUseProgram
+void use_program(uint32_t program);
+
+/// Equivalent to glBindVertexArray
+void bind_vertex_array(uint32_t vertex_array);
+
+/// Equivalent to glActiveTexture(GL_TEXTURE0 + unit)
+void active_texture(uint32_t unit);
+
+/// Equivalent to glBindTexture on the currently active texture unit
+void bind_texture(uint32_t target, uint32_t texture);
+
+/// Bind a texture to the given texture unit, only switching the active texture unit if a bind is necessary
+void bind_texture_to_unit(uint32_t unit, uint32_t target, uint32_t texture);
+
+/// Equivalent to glEnable/glDisable for the capabilities we use (blending, depth/scissor test, culling, point size)
+void set_enabled(uint32_t capability, bool enabled);
+
+/// Equivalent to glBlendFunc
+void blend_func(uint32_t src_factor, uint32_t dst_factor);
+
+/// Equivalent to glViewport
+void viewport(const linalg::aliases::int4 &rect);
+
+/// The current viewport (x, y, width, height)
+const linalg::aliases::int4 &viewport();
+
+/// Record a viewport that was set by code outside our control (e.g. HelloImGui, at the start of each frame)
+void assume_viewport(const linalg::aliases::int4 &rect);
+
+/// Equivalent to glScissor
+void scissor(const linalg::aliases::int4 &rect);
+
+/// The current scissor box (x, y, width, height)
+const linalg::aliases::int4 &scissor();
+
+/// Equivalent to glDepthMask
+void depth_mask(bool enabled);
+
+/// The current depth write mask
+bool depth_mask();
+
+/// Equivalent to glDepthFunc
+void depth_func(uint32_t func);
+
+/// Equivalent to glCullFace
+void cull_face(uint32_t mode);
+
+/// Is the given capability (one of those supported by \ref set_enabled) currently enabled?
+bool is_enabled(uint32_t capability);
+
+/// Equivalent to glBindFramebuffer; GL_FRAMEBUFFER binds both the read and the draw framebuffer
+void bind_framebuffer(uint32_t target, uint32_t framebuffer);
+
+/// The framebuffer currently bound to GL_READ_FRAMEBUFFER or GL_DRAW_FRAMEBUFFER
+uint32_t framebuffer(uint32_t target);
+
+/// Enable or disable cross-checking the shadow against the real GL state in \ref validate()
+void set_validation(bool enabled);
+
+/// Is cross-checking the shadow against the real GL state enabled?
+bool validation();
+
+/**
+    If validation is enabled, compare every known value in the shadow against the real GL state.
+
+    Mismatches are logged (naming \p where) and the shadow is corrected, so each drift is reported once.
+
+    \return
+        true if drift was detected
+*/
+bool validate(const char *where);
+
+/// Must be called when a program is deleted so that a recycled handle is not mistaken for a cached binding
+void program_deleted(uint32_t program);
+
+/// Must be called when a vertex array object is deleted (this reverts its binding to 0)
+void vertex_array_deleted(uint32_t vertex_array);
+
+/// Must be called when a texture is deleted (this reverts all of its bindings to 0)
+void texture_deleted(uint32_t texture);
+
+/// Must be called when a framebuffer is deleted (this reverts its bindings to the default framebuffer)
+void framebuffer_deleted(uint32_t framebuffer);
+
+} // namespace gl_state
@@ -0,0 +1,66 @@
+/**
+    \file gpu_timer.h
+*/
+#pragma once
+
+#include <cstdint>
+
+/**
+    Scoped GPU timers, reported to the \ref profiler alongside the CPU timings.
+
+    On OpenGL, each zone brackets its commands with a pair of GL_TIMESTAMP queries (so zones can nest). The queries of
+    each frame come from a ring that is several frames deep, and results are only read back once the GPU has had
+    time to produce them, so timing never stalls the pipeline. Results that are still not available by the time
+    their slot in the ring is reused are dropped rather than waited for.
+
+    \ref RenderPass, \ref Shader draws and \ref Texture transfers are timed automatically, labelled by the shader
+    name or texture operation.
+
+    On Metal, individual zones are not supported; instead each \ref RenderPass reports the GPU time of its command
+    buffer.
+*/
+namespace gpu_timer
+{
+
+/// Does the current context support GPU timers?
+bool supported();
+
+/// Enable or disable GPU timing (enabled by default where supported)
+void set_enabled(bool enabled);
+
+/// Is GPU timing enabled (and supported)?
+bool enabled();
+
+/// Read back the results that have become available and start a new slot of the query ring. Call once per frame,
+/// after \ref profiler::new_frame().
+void new_frame();
+
+/// Return the number of frames whose results were dropped because the GPU had not finished them in time
+uint64_t dropped_frames();
+
+/// Start timing a zone with the given (interned) label. Returns a handle for \ref end(), or -1 if not timing.
+int begin(const char *label);
+
+/// Stop timing the zone started with \ref begin()
+void end(int zone);
+
+/// Times the GPU commands issued during its lifetime
+class Scope
+{
+public:
+    explicit Scope(const char *label) : m_zone(begin(label))
+    {
+    }
+    ~Scope()
+    {
+        end(m_zone);
+    }
+
+    Scope(const Scope &)            = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    int m_zone;
+};
+
+} // namespace gpu_timer
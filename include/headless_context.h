@@ -0,0 +1,99 @@
+/**
+    \file headless_context.h
+*/
+#pragma once
+
+#include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+
+#include <fmt/core.h>
+#include <stdexcept>
+
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/**
+    An OpenGL core profile context that renders into nothing but offscreen targets.
+
+    The display comes from Mesa's surfaceless platform when available, which needs neither a display server nor a GPU
+    (it falls back to the llvmpipe software rasterizer), and from the default display otherwise.
+*/
+class HeadlessContext
+{
+public:
+    HeadlessContext()
+    {
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display)
+            m_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (m_display == EGL_NO_DISPLAY)
+            m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+            throw std::runtime_error("HeadlessContext::HeadlessContext(): cannot initialize an EGL display!");
+        m_initialized = true;
+
+        // any config will do: we never create a surface
+        const EGLint config_attribs[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+        EGLConfig    config;
+        EGLint       num_configs = 0;
+        if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(m_display, config_attribs, &config, 1, &num_configs) ||
+            num_configs < 1)
+        {
+            release();
+            throw std::runtime_error("HeadlessContext::HeadlessContext(): no EGL config supports OpenGL!");
+        }
+
+        // our shaders are written for "#version 330 core"
+        const EGLint context_attribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                          3,
+                                          EGL_CONTEXT_MINOR_VERSION,
+                                          3,
+                                          EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                          EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                          EGL_NONE};
+        m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, context_attribs);
+        if (m_context == EGL_NO_CONTEXT || !eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+        {
+            EGLint error = eglGetError();
+            release();
+            throw std::runtime_error(
+                fmt::format("HeadlessContext::HeadlessContext(): cannot create a surfaceless OpenGL 3.3 context "
+                            "(EGL error 0x{:x})!",
+                            error));
+        }
+
+#if defined(HELLOIMGUI_USE_GLAD)
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            release();
+            throw std::runtime_error("HeadlessContext::HeadlessContext(): cannot load the OpenGL functions!");
+        }
+#endif
+    }
+
+    ~HeadlessContext()
+    {
+        release();
+    }
+
+    HeadlessContext(const HeadlessContext &)            = delete;
+    HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+protected:
+    void release()
+    {
+        if (m_context != EGL_NO_CONTEXT)
+        {
+            eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(m_display, m_context);
+            m_context = EGL_NO_CONTEXT;
+        }
+        if (m_initialized)
+            eglTerminate(m_display);
+        m_initialized = false;
+    }
+
+    EGLDisplay m_display     = EGL_NO_DISPLAY;
+    EGLContext m_context     = EGL_NO_CONTEXT;
+    bool       m_initialized = false;
+};
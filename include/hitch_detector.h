@@ -0,0 +1,119 @@
+/**
+    \file hitch_detector.h
+*/
+#pragma once
+
+#include "profiler.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+    Watches the \ref profiler for frames that take longer than a threshold, and logs what was going on during them.
+
+    Each hitch is logged (with HelloImGui::Log) with the zones that took the most time, and the frame's context: the
+    number of bytes uploaded to textures, the number of shaders compiled, and the number of bytes read from and written
+    to files. The most recent hitches are also kept in a fixed-size history, which can be exported as JSON to attach to
+    a bug report.
+
+    Frames are checked once they are complete (i.e. their GPU results have arrived), so hitches are reported a few
+    frames after they happened.
+*/
+class HitchDetector
+{
+public:
+    /// The number of hitches kept in the history
+    static constexpr size_t history_size = 64;
+
+    /// The number of zones recorded for each hitch
+    static constexpr size_t max_zones = 5;
+
+    /// The smallest threshold (in milliseconds), about one frame at 60 Hz, below which most frames would be hitches
+    static constexpr float min_threshold = 16.f;
+
+    /// A zone that took long during a hitch (merged over all calls, see \ref profiler::aggregate())
+    struct LongZone
+    {
+        const char      *label   = nullptr;
+        profiler::Source source  = profiler::Source::CPU;
+        uint32_t         calls   = 0;
+        float            self_ms = 0.f; ///< time spent in the zone itself, excluding its child zones
+    };
+
+    /// A frame that took longer than the threshold
+    struct Hitch
+    {
+        uint64_t frame           = 0;
+        double   time            = 0.0; ///< seconds since the detector was created
+        float    frame_ms        = 0.f;
+        float    cpu_ms          = 0.f;
+        float    gpu_ms          = 0.f;
+        int64_t  upload_bytes    = 0; ///< uploaded to textures
+        int64_t  shader_compiles = 0;
+        int64_t  read_bytes      = 0; ///< read from files
+        int64_t  written_bytes   = 0; ///< written to files
+        size_t   num_zones       = 0;
+        LongZone zones[max_zones];    ///< the zones with the longest self time, longest first
+    };
+
+    HitchDetector();
+
+    /// Set the frame time (in milliseconds) above which a frame counts as a hitch (at least \ref min_threshold)
+    void set_threshold(float ms)
+    {
+        m_threshold = ms < min_threshold ? min_threshold : ms;
+    }
+
+    /// Return the frame time (in milliseconds) above which a frame counts as a hitch
+    float threshold() const
+    {
+        return m_threshold;
+    }
+
+    /// Check the frames that completed since the last call. Call once per frame, after \ref profiler::new_frame().
+    void new_frame();
+
+    /// Return the number of hitches in the history
+    size_t size() const
+    {
+        return m_count;
+    }
+
+    /// Return a hitch from the history, from the oldest (0) to the most recent (\ref size() - 1)
+    const Hitch &hitch(size_t i) const
+    {
+        return m_history[(m_next + history_size - m_count + i) % history_size];
+    }
+
+    /// Return the total number of hitches detected, including those no longer in the history
+    uint64_t total() const
+    {
+        return m_total;
+    }
+
+    /// Forget the hitches in the history
+    void clear()
+    {
+        m_count = 0;
+    }
+
+    /// Write the history to \p filename as JSON. Throws on failure.
+    void export_history(const std::string &filename) const;
+
+    /// Draw the threshold, the history and an export button into the current ImGui window
+    void draw();
+
+protected:
+    void check(const profiler::Frame &frame);
+    void log(const Hitch &h, const profiler::Frame &frame) const;
+
+    std::array<Hitch, history_size> m_history;
+    size_t                          m_count        = 0; ///< number of hitches in the history
+    size_t                          m_next         = 0; ///< position of the next hitch in the history
+    uint64_t                        m_total        = 0;
+    uint64_t                        m_last_checked = 0; ///< index of the newest frame checked so far
+    float                           m_threshold    = 50.f;
+    int64_t                         m_origin_ns    = 0;
+    std::vector<profiler::Node>     m_nodes; ///< scratch space for the per-zone breakdown, reused across frames
+};
@@ -0,0 +1,120 @@
+/**
+    \file memory_tracker.h
+*/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+    A process-wide registry of the large allocations: the GPU storage of textures and shader buffers, the CPU copies
+    of shader arguments, and decoded images.
+
+    Every allocation is registered under a category and the name of its owner (e.g. the file a texture was loaded
+    from, or the shader a buffer belongs to), and reports its size whenever that changes. The registry keeps the
+    current and peak usage of each category, and lists the allocations that are still alive, so that anything never
+    released shows up in \ref report_leaks() at shutdown.
+
+    All functions are thread-safe. They take a lock, so they are meant to be called when something is (re)allocated,
+    not for every update of its contents.
+*/
+namespace memory_tracker
+{
+
+enum class Category : uint8_t
+{
+    Textures,      ///< GPU storage of textures that are only read by shaders
+    RenderTargets, ///< GPU storage of textures (and renderbuffers) that are rendered into
+    Buffers,       ///< GPU storage of vertex, index and storage buffers
+    Arguments,     ///< CPU copies of shader arguments (uniforms, and small buffers on Metal)
+    Images,        ///< images decoded on the CPU, until they are uploaded
+    Count
+};
+
+/// Return a human-readable name of a category
+const char *name(Category category);
+
+/// Format a size for display, e.g. "12 bytes", "3.4 KB" or "5.6 MB"
+std::string format_bytes(size_t bytes);
+
+/**
+    Report the size of the allocation identified by \p id.
+
+    If \p id is 0, a new allocation is registered and its id is stored in \p id. If \p bytes is 0, the allocation is
+    released and \p id is reset to 0. Otherwise its size is updated.
+*/
+void track(uint32_t &id, Category category, std::string_view owner, size_t bytes);
+
+/// Release the allocation identified by \p id (if any) and reset \p id to 0
+inline void release(uint32_t &id)
+{
+    track(id, Category::Textures, {}, 0);
+}
+
+/// Change the owner shown for the allocation identified by \p id
+void rename(uint32_t id, std::string_view owner);
+
+struct Usage
+{
+    size_t current = 0; ///< bytes allocated now
+    size_t peak    = 0; ///< the most bytes ever allocated at once
+    size_t count   = 0; ///< number of live allocations
+};
+
+/// Return the usage of one category
+Usage usage(Category category);
+
+/// Return the usage of all categories together (whose peak may be less than the sum of their peaks)
+Usage usage();
+
+struct Allocation
+{
+    Category    category;
+    std::string owner;
+    size_t      bytes;
+};
+
+/// Return the live allocations, largest first
+std::vector<Allocation> allocations();
+
+/**
+    Replace the contents of \p result with the \p max largest live allocations (or all, if there are fewer), largest
+    first.
+
+    \p result keeps its memory, including that of the owners' strings, so calling this every frame with the same
+    vector does not allocate once it has grown large enough.
+*/
+void largest_allocations(std::vector<Allocation> &result, size_t max);
+
+/**
+    Log the allocations that are still alive (with HelloImGui::Log, and on stderr), and return how many there are.
+
+    Call this at shutdown, once everything should have been released.
+*/
+size_t report_leaks();
+
+/**
+    An allocation that is released when this object goes out of scope, for temporary buffers such as decoded
+    images.
+*/
+class Scoped
+{
+public:
+    Scoped(Category category, std::string_view owner, size_t bytes)
+    {
+        track(m_id, category, owner, bytes);
+    }
+    ~Scoped()
+    {
+        release(m_id);
+    }
+    Scoped(const Scoped &)            = delete;
+    Scoped &operator=(const Scoped &) = delete;
+
+protected:
+    uint32_t m_id = 0;
+};
+
+} // namespace memory_tracker
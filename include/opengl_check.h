@@ -5,6 +5,47 @@
 
 bool check_glerror(const char *cmd, const char *file, int line);
 
+/// Is the named extension (e.g. "GL_KHR_parallel_shader_compile") supported by the current context? On WebGL this also
+/// enables the extension.
+bool gl_extension_supported(const char *name);
+
+/// Is the current context at least the given OpenGL (or OpenGL ES) version?
+bool gl_version_at_least(int major, int minor);
+
+/// How OpenGL errors are detected
+enum class GLErrorCheck
+{
+    Off,         ///< Errors are ignored
+    PerFrame,    ///< glGetError() is polled once per frame; cheap enough for release builds, but can't tell which call
+    DebugOutput, ///< The driver reports errors and warnings through a KHR_debug callback, without stalling
+    PerCall      ///< glGetError() after every \ref CHK, which pinpoints the failing call but serializes the driver
+};
+
+/**
+    Choose how OpenGL errors are detected. This can be called before the context exists, and takes effect at the next
+    \ref gl_error_check_new_frame().
+
+    The default is \ref GLErrorCheck::DebugOutput in debug builds and \ref GLErrorCheck::PerFrame in release builds.
+    Debug output requires OpenGL 4.3 or \c GL_KHR_debug (so it is unavailable on OpenGL ES / WebGL) and falls back to
+    \ref GLErrorCheck::PerCall in debug builds and \ref GLErrorCheck::PerFrame otherwise. \ref GLErrorCheck::PerCall
+    is only available in debug builds, since \ref CHK compiles to the bare call in release builds.
+
+    Messages are logged with HelloImGui::Log (high severity as errors, medium as warnings, low as info, and
+    notifications are ignored). Repeats of a message are counted rather than logged, and summarized once per second,
+    and at most a few new messages are logged per second.
+*/
+void set_gl_error_check(GLErrorCheck mode);
+
+/// Return the active way of detecting OpenGL errors
+GLErrorCheck gl_error_check();
+
+/// Apply a pending \ref set_gl_error_check(), poll errors (for \ref GLErrorCheck::PerFrame) and log the messages
+/// collected since the last frame. Call once per frame from the main thread, with the context current.
+void gl_error_check_new_frame();
+
+/// Whether \ref CHK checks for errors after each call (only in \ref GLErrorCheck::PerCall mode)
+extern bool gl_check_every_call;
+
 #if defined(NDEBUG)
 #define CHK(cmd) cmd
 #else
@@ -12,8 +53,9 @@ bool check_glerror(const char *cmd, const char *file, int line);
     do                                                                                                                 \
     {                                                                                                                  \
         cmd;                                                                                                           \
-        while (check_glerror(#cmd, __FILE__, __LINE__))                                                                \
-        {                                                                                                              \
-        }                                                                                                              \
+        if (gl_check_every_call)                                                                                       \
+            while (check_glerror(#cmd, __FILE__, __LINE__))                                                            \
+            {                                                                                                          \
+            }                                                                                                          \
     } while (false)
-#endif
\ No newline at end of file
+#endif
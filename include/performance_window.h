@@ -0,0 +1,59 @@
+/**
+    \file performance_window.h
+*/
+#pragma once
+
+#include "memory_tracker.h"
+#include "profiler.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+    Live performance statistics, drawn into an ImGui window: a rolling graph of frame times, percentiles of the frame,
+    CPU and GPU times, a per-zone breakdown of the latest complete frame, GPU memory totals, upload bandwidth, and
+    (while the \ref alloc_tracker is enabled) the heap allocations per frame, flagging frames over budget.
+
+    Frames are sampled from the \ref profiler once they are complete (i.e. their GPU results have arrived), into
+    fixed-size rings, so that drawing the window allocates nothing per frame once warmed up.
+*/
+class PerformanceWindow
+{
+public:
+    /// The number of frames in the graph and percentiles
+    static constexpr size_t history_size = 512;
+
+    /// Draw the statistics into the current ImGui window. Call once per frame while the window is visible.
+    void draw();
+
+protected:
+    /// The per-frame values that are kept in the history
+    enum Series
+    {
+        FrameTime,
+        CPUTime,
+        GPUTime,
+        UploadBytes,
+        HeapAllocations,
+        NumSeries
+    };
+
+    /// Copy the frames that completed since the last call into the history, and aggregate the newest one
+    void sample();
+
+    /// Compute the 50th, 95th and 99th percentile of a series over the history
+    void percentiles(Series series, float (&result)[3]);
+
+    /// Draw the controls and counts of the \ref alloc_tracker
+    void draw_allocations();
+
+    std::array<std::array<float, history_size>, NumSeries> m_history{}; ///< one ring per series
+    std::array<float, history_size>                        m_sorted{};  ///< scratch space for the percentiles
+    size_t                                                 m_count = 0; ///< number of valid samples in the rings
+    size_t                                                 m_next  = 0; ///< position of the next sample in the rings
+
+    uint64_t                                m_last_sampled = 0; ///< index of the newest frame in the history
+    bool                                    m_paused       = false;
+    std::vector<profiler::Node>             m_nodes;       ///< per-zone breakdown of the newest frame, reused
+    std::vector<memory_tracker::Allocation> m_allocations; ///< the largest live allocations, reused
+};
@@ -0,0 +1,207 @@
+/**
+    \file profiler.h
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+    A process-wide collector of timed zones, grouped by frame.
+
+    CPU and GPU timings are reported to the same place, so that a frame's CPU and GPU costs can be compared directly
+    (e.g. to tell whether a frame is CPU- or GPU-bound). Zones may be submitted from any thread; they become visible in
+    \ref profiler::frame() after the next call to \ref profiler::new_frame(), which must be called once per frame from
+    the main thread. GPU results arrive a few frames late and are attributed to the frame that issued the work.
+
+    CPU zones are timed by \ref profiler::Scope (or \ref PROFILE_SCOPE) with the monotonic \ref profiler::now_ns()
+    clock. Each thread records its zones into its own fixed-size ring buffer, which \ref profiler::new_frame() drains,
+    so recording a zone takes no locks and allocates nothing; zones that don't fit into a full ring are dropped and
+    counted. This is cheap enough to leave enabled in release builds.
+
+    Besides zones, frames collect counters (e.g. the number of bytes uploaded to textures, see \ref profiler::count())
+    and, for rare events such as logged errors, text messages (see \ref profiler::message()).
+
+    The history is a fixed-size ring of frames whose zone arrays are reused, so recording does not allocate once
+    warmed up.
+*/
+namespace profiler
+{
+
+/// Where a zone's time was spent
+enum class Source : uint8_t
+{
+    CPU,
+    GPU
+};
+
+/// A timed region of work
+struct Zone
+{
+    const char *label;       ///< interned with \ref intern()
+    Source      source;      ///< CPU or GPU
+    uint16_t    depth;       ///< nesting depth (0 for top-level zones)
+    uint32_t    thread;      ///< small integer identifying the thread (CPU zones)
+    int64_t     start_ns;    ///< start time on the \ref now_ns() clock (GPU zones are mapped onto it)
+    int64_t     duration_ns; ///< duration in nanoseconds
+};
+
+/// An amount (e.g. of bytes) reported with \ref count()
+struct Counter
+{
+    const char *label;   ///< interned with \ref intern()
+    uint32_t    thread;  ///< small integer identifying the thread
+    int64_t     time_ns; ///< when the amount was reported, on the \ref now_ns() clock
+    int64_t     value;
+};
+
+/// A text event reported with \ref message()
+struct Message
+{
+    uint32_t    thread;
+    int64_t     time_ns;
+    std::string text;
+};
+
+/// All zones recorded for one frame
+struct Frame
+{
+    uint64_t          index       = 0; ///< frame number (see \ref frame_index())
+    int64_t           start_ns    = 0; ///< when \ref new_frame() was called for this frame
+    int64_t           duration_ns = 0; ///< time until the next \ref new_frame() (0 while the frame is in progress)
+    int64_t           cpu_ns      = 0; ///< total duration of the main thread's top-level CPU zones
+    int64_t           gpu_ns      = 0; ///< total duration of the top-level GPU zones
+    std::vector<Zone>    zones;
+    std::vector<Counter> counters;
+    std::vector<Message> messages;
+};
+
+/// A call path through a frame's zones, with the time spent in it summed over all calls (see \ref aggregate())
+struct Node
+{
+    const char *label;
+    Source      source;
+    uint16_t    depth;
+    int         parent;   ///< index of the parent node, or -1 for top-level nodes
+    uint32_t    calls;    ///< number of zones that were merged into this node
+    int64_t     total_ns; ///< total duration of these zones
+    int64_t     self_ns;  ///< total_ns minus the time spent in child zones
+};
+
+/// The number of frames kept in the history
+static constexpr size_t history_size = 256;
+
+/// The number of frames after which a frame is complete, i.e. its GPU results have arrived (or were dropped)
+static constexpr uint64_t complete_after = 8;
+
+/// The number of zones each thread can record between two calls to \ref new_frame()
+static constexpr size_t ring_size = 4096;
+
+/// The current time in nanoseconds, from a monotonic clock
+int64_t now_ns();
+
+/// Return a pointer to a permanent copy of \p label, so that zones can refer to it cheaply. Equal strings give equal
+/// pointers.
+const char *intern(std::string_view label);
+
+/// Start a new frame. Call once per frame from the main thread, before any zones of the frame are recorded.
+void new_frame();
+
+/// Return the index of the current frame
+uint64_t frame_index();
+
+/// Record a zone belonging to the given frame (thread-safe). Zones of frames no longer in the history are dropped.
+void submit(uint64_t frame, const Zone &zone);
+
+/// Report an amount (e.g. a number of bytes) with the given (interned) label on the current frame. Thread-safe and
+/// lock-free, like CPU zones.
+void count(const char *label, int64_t value);
+
+/// Return the sum of the amounts reported with the given label during a frame
+int64_t counter_total(const Frame &frame, const char *label);
+
+/// Attach a text event (e.g. a logged error) to the current frame. Thread-safe, but takes a lock and allocates, so
+/// this is meant for rare events.
+void message(std::string_view text);
+
+/// Return the small integer identifying the calling thread in \ref Zone::thread
+uint32_t thread_index();
+
+/// Return the given frame, or nullptr if it is not (or no longer) in the history. Main thread only.
+const Frame *frame(uint64_t index);
+
+/// Enable or disable recording CPU zones (enabled by default)
+void set_enabled(bool enabled);
+
+/// Is recording CPU zones enabled?
+bool enabled();
+
+/// Return the number of zones dropped so far because a thread's ring buffer was full
+uint64_t dropped_zones();
+
+/**
+    Merge the zones of a frame by call path, e.g. all "Shader::begin" zones within "draw_background" on the same thread
+    become a single node, while those called from elsewhere get their own.
+
+    Nodes are listed in depth-first order, and children follow their parents. \p nodes is overwritten, and can be
+    reused across frames to avoid allocations.
+*/
+void aggregate(const Frame &frame, std::vector<Node> &nodes);
+
+/// The nesting depth up to which \ref current_zone() knows the labels of the open zones
+static constexpr size_t max_depth = 64;
+
+/**
+    Start timing a CPU zone on the calling thread. Returns the start time to pass to \ref end() (0 if disabled).
+
+    \p label (interned with \ref intern()) is only needed for \ref current_zone(); it is passed again to \ref end().
+*/
+int64_t begin(const char *label = nullptr);
+
+/// Stop timing the CPU zone started with \ref begin() and record it
+void end(const char *label, int64_t start_ns);
+
+/// Return the label of the innermost CPU zone that is open on the calling thread, or nullptr if there is none. Cheap
+/// enough to be called for every heap allocation (see \ref alloc_tracker).
+const char *current_zone();
+
+/// Times a CPU zone during its lifetime
+class Scope
+{
+public:
+    explicit Scope(const char *label) : m_label(label), m_start(begin(label))
+    {
+    }
+    ~Scope()
+    {
+        end(m_label, m_start);
+    }
+
+    Scope(const Scope &)            = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *m_label;
+    int64_t     m_start;
+};
+
+} // namespace profiler
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b)      PROFILER_CONCAT_IMPL(a, b)
+
+/// Time the rest of the enclosing block as a CPU zone with the given label (a string literal), interning it only once
+#define PROFILE_SCOPE(label)                                                                                           \
+    static const char *PROFILER_CONCAT(profile_label_, __LINE__) = profiler::intern(label);                            \
+    profiler::Scope    PROFILER_CONCAT(profile_scope_, __LINE__)(PROFILER_CONCAT(profile_label_, __LINE__))
+
+/// Report an amount with the given label (a string literal) on the current frame, interning the label only once
+#define PROFILE_COUNT(label, value)                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static const char *profile_count_label = profiler::intern(label);                                              \
+        profiler::count(profile_count_label, (int64_t)(value));                                                        \
+    } while (false)
@@ -0,0 +1,161 @@
+/**
+    \file render_graph.h
+*/
+#pragma once
+
+#include "renderpass.h"
+#include "texture.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+    A small render graph for multi-stage GPU pipelines (e.g. tonemap -> comparison -> overlay -> reduction).
+
+    Each pass declares the textures it reads and the textures it renders into. \ref compile() then orders the passes
+    so that every texture is written before it is read, culls passes whose results are never used, and assigns the
+    transient (graph-owned) textures from a pool. Transient textures whose lifetimes do not overlap share the same
+    pooled \ref Texture, so the memory used for intermediates follows the peak working set rather than the sum over
+    all stages. The pool, and the offscreen \ref RenderPass for each set of attachments, persist across \ref reset(),
+    so rebuilding the same graph every frame allocates nothing.
+
+    Every resource is written by exactly one pass. Imported textures are owned by the caller; they and any resources
+    passed to \ref mark_output() are the results of the graph.
+
+    \note
+        On Metal, a \ref Shader is tied to the \ref RenderPass it was created with, so this is currently only usable
+        with OpenGL.
+*/
+class RenderGraph
+{
+public:
+    /// Identifies a texture resource of the graph
+    using Resource = int;
+
+    /// Called between \ref RenderPass::begin() and \ref RenderPass::end() to record the draws of a pass
+    using ExecuteCallback = std::function<void(RenderGraph &graph, RenderPass &render_pass)>;
+
+    /// Describes a transient texture. Textures with equal descriptions can share memory.
+    struct TextureDesc
+    {
+        int2                       size;
+        Texture::PixelFormat       pixel_format     = Texture::PixelFormat::RGBA;
+        Texture::ComponentFormat   component_format = Texture::ComponentFormat::Float16;
+        Texture::InterpolationMode interpolation    = Texture::InterpolationMode::Bilinear;
+    };
+
+    RenderGraph() = default;
+
+    RenderGraph(const RenderGraph &)            = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    /// Declare a transient texture, allocated from the pool while it is in use
+    Resource create_texture(const std::string &name, const TextureDesc &desc);
+
+    /**
+        Make a caller-owned texture available to the graph (it must have the RenderTarget flag to be written).
+
+        Between executions of the graph, the caller may resize or free the texture and import another one.
+    */
+    Resource import_texture(const std::string &name, Texture *texture);
+
+    /**
+        Add a pass.
+
+        \param name
+            A name identifying the pass (used in error messages)
+        \param reads
+            The textures sampled by the pass
+        \param writes
+            The textures the pass renders into, in the order of the fragment shader outputs
+        \param execute
+            Records the pass' draws. Use \ref texture() to look up the textures to bind.
+        \param clear
+            Should the targets be cleared (to transparent black) before the pass?
+    */
+    void add_pass(const std::string &name, const std::vector<Resource> &reads, const std::vector<Resource> &writes,
+                  ExecuteCallback execute, bool clear = true);
+
+    /// Keep the given (transient) resource, and the passes producing it, alive until the end of \ref execute()
+    void mark_output(Resource resource);
+
+    /// Order and cull the passes, and assign textures to the transient resources. Throws if the graph has a cycle.
+    void compile();
+
+    /// Run the passes (compiling the graph first if needed)
+    void execute();
+
+    /// Remove all passes and resources, but keep the texture pool and render passes for reuse
+    void reset();
+
+    /// Release pooled textures that the current graph does not use
+    void trim();
+
+    /// Return the texture assigned to a resource (only valid after \ref compile())
+    Texture *texture(Resource resource) const;
+
+    /// Return the names of the passes that will run, in order (only valid after \ref compile())
+    std::vector<std::string> schedule() const;
+
+    /// Return the number of passes that were culled by the last \ref compile()
+    size_t culled_passes() const
+    {
+        return m_culled;
+    }
+
+    /// Return the memory used by the texture pool
+    size_t pool_bytes() const;
+
+    /// Return the memory the transient textures of the compiled graph would need without aliasing
+    size_t unaliased_bytes() const;
+
+protected:
+    struct ResourceInfo
+    {
+        std::string name;
+        TextureDesc desc;
+        Texture    *texture  = nullptr; ///< assigned texture (for imported textures: the caller's)
+        bool        imported = false;
+        bool        output   = false;
+        int         writer   = -1; ///< index of the pass writing this resource
+    };
+
+    struct Pass
+    {
+        std::string           name;
+        std::vector<Resource> reads, writes;
+        ExecuteCallback       execute;
+        bool                  clear;
+    };
+
+    using PoolKey = std::tuple<int, int, Texture::PixelFormat, Texture::ComponentFormat, Texture::InterpolationMode>;
+
+    static PoolKey pool_key(const TextureDesc &desc);
+    static size_t  texture_bytes(const Texture *texture);
+
+    const ResourceInfo &resource(Resource resource) const;
+    RenderPass         *render_pass(const Pass &pass);
+
+    std::vector<ResourceInfo> m_resources;
+    std::vector<Pass>         m_passes;
+    std::vector<int>          m_order; ///< indices of the passes to run, in execution order
+    size_t                    m_culled   = 0;
+    bool                      m_compiled = false;
+
+    /// All textures ever allocated by the pool, by description
+    std::map<PoolKey, std::vector<std::unique_ptr<Texture>>> m_pool;
+
+    /// An offscreen render pass, with the identity and size of each attachment when it was created
+    struct CachedPass
+    {
+        std::unique_ptr<RenderPass>            render_pass;
+        std::vector<std::pair<uint64_t, int2>> targets; ///< \ref Texture::serial() and size of each attachment
+    };
+
+    /// Offscreen render passes, by their color attachments (and whether they clear them). Declared after \ref m_pool
+    /// so that they are destroyed before the textures they refer to.
+    std::map<std::pair<std::vector<Texture *>, bool>, CachedPass> m_render_passes;
+};
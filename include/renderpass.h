@@ -6,10 +6,12 @@
 #include "linalg.h"
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 using namespace linalg::aliases;
 
 class Shader;
+class Texture;
 
 /**
     An abstraction for rendering passes that work with OpenGL, OpenGL ES, and Metal.
@@ -58,6 +60,24 @@ public:
      */
     RenderPass(bool write_depth = true, bool clear = true);
 
+    /**
+     * Create a new render pass for rendering offscreen into textures.
+     *
+     * The textures must have been created with the \ref Texture::TextureFlags::RenderTarget flag and must outlive the
+     * render pass. On OpenGL, a framebuffer object with these attachments is created once and reused by every \ref
+     * begin().
+     *
+     * \param color_targets
+     *     The color attachments. Fragment shader output \c i is written to \c color_targets[i].
+     *
+     * \param depth_target
+     *     An optional depth (or depth + stencil) attachment. Without one, depth testing and writing are disabled.
+     *
+     * \param clear
+     *     Should \ref begin() begin by clearing all buffers?
+     */
+    RenderPass(const std::vector<Texture *> &color_targets, Texture *depth_target = nullptr, bool clear = true);
+
     ~RenderPass();
 
     /**
@@ -120,6 +140,44 @@ public:
     /// Resize all texture targets attached to the render pass
     void resize(const int2 &size);
 
+    /**
+     * Copy a region of the first color target into the framebuffer rendered to by \p dst.
+     *
+     * This is a plain pixel copy (no shading or blending), so compositing a cached offscreen rendering this way is
+     * much cheaper than redrawing it. Must be called outside of \ref begin() / \ref end(). Offsets are in pixels from
+     * the top-left, like \ref set_viewport().
+     */
+    void blit_to(const int2 &src_offset, const int2 &src_size, RenderPass *dst, const int2 &dst_offset);
+
+    /**
+     * Resolve color target \p index into the single-sample texture \p target.
+     *
+     * If the color target is multisampled (MSAA), its samples are averaged into \p target, which must then have the
+     * same size. Otherwise, the color target may be larger than \p target and is downsampled with a bilinear filter,
+     * which is an exact box filter for 2x supersampling. Must be called outside of \ref begin() / \ref end().
+     */
+    void resolve(Texture *target, size_t index = 0);
+
+    /// Return the color attachments (empty when rendering to the screen)
+    const std::vector<Texture *> &color_targets() const
+    {
+        return m_color_targets;
+    }
+
+    /// Return the depth attachment, if any
+    Texture *depth_target() const
+    {
+        return m_depth_target;
+    }
+
+#if defined(HELLOIMGUI_HAS_OPENGL)
+    /// Return the handle of the framebuffer object (0 when rendering to the screen)
+    uint32_t framebuffer_handle() const
+    {
+        return m_framebuffer_handle;
+    }
+#endif
+
 #if defined(HELLOIMGUI_HAS_METAL)
     void *command_encoder() const
     {
@@ -143,13 +201,20 @@ protected:
     CullMode  m_cull_mode;
     bool      m_active = false;
 
+    std::vector<Texture *> m_color_targets;
+    Texture               *m_depth_target = nullptr;
+
 #if defined(HELLOIMGUI_HAS_OPENGL)
-    int4 m_viewport_backup, m_scissor_backup;
-    bool m_depth_test_backup;
-    bool m_depth_write_backup;
-    bool m_scissor_test_backup;
-    bool m_cull_face_backup;
-    bool m_blend_backup;
+    uint32_t m_framebuffer_handle  = 0;
+    uint32_t m_framebuffer_backup  = 0;
+    uint32_t m_resolve_framebuffer = 0; ///< draw framebuffer of \ref resolve(), created on first use
+    int4     m_viewport_backup, m_scissor_backup;
+    bool     m_depth_test_backup;
+    bool     m_depth_write_backup;
+    bool     m_scissor_test_backup;
+    bool     m_cull_face_backup;
+    bool     m_blend_backup;
+    int      m_gpu_zone = -1;
 #elif defined(HELLOIMGUI_HAS_METAL)
     void                   *m_command_buffer;
     void                   *m_command_encoder;
@@ -7,7 +7,9 @@
 #include "traits.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+class DrawList;
 class RenderPass;
 class Texture;
 
@@ -45,12 +47,25 @@ public:
         AlphaBlend // alpha * new_color + (1 - alpha) * old_color
     };
 
+    /// How often the contents of a buffer are expected to change (a hint for choosing the upload strategy)
+    enum class BufferUsage
+    {
+        Static,  ///< Uploaded once (or rarely) and drawn many times
+        Dynamic, ///< Updated now and then; same-size updates are done in place
+        Stream   ///< Replaced (nearly) every frame; updates never wait for the GPU to finish with the old contents
+    };
+
     /**
         Returns a text string with the source (or precompiled binary) of a shader found in the app's assets directory.
 
         We assume Metal shaders use `.metallib` for binary, and `.metal` for source, and GLSL(ES) shader sources use one
        of a handful of common extensions like `.glsl` or `.fs` (see \ref shader.cpp for details).
 
+        Shaders in assets/shaders are embedded into the executable at build time (see \ref shader_assets.h), so this
+        normally involves no file I/O. If an override directory was set with \ref set_asset_override_directory, a
+        shader found there takes precedence, which allows editing shaders without rebuilding. Files not embedded are
+        loaded from the assets directory as a fallback.
+
         \param [in] basename
             The base filename (without extension) relative to the app's assets directory
         \return
@@ -58,6 +73,13 @@ public:
     */
     static std::string from_asset(std::string_view basename);
 
+    /**
+        Load shaders from \p dir (which mirrors the layout of the assets directory) in preference to the embedded copies.
+
+        Pass an empty string to disable the override.
+    */
+    static void set_asset_override_directory(const std::string &dir);
+
     /**
         Prepend the files in \ref include_files to the top of \ref shader_string
 
@@ -86,6 +108,21 @@ public:
     Shader(RenderPass *render_pass, const std::string &name, const std::string &vs_source, const std::string &fs_source,
            BlendMode blend_mode = BlendMode::None);
 
+    /// Tag type selecting the asynchronous constructor
+    struct Async
+    {
+    };
+
+    /**
+        Submit the shader sources for compilation and linking, but return without waiting for the driver to finish.
+
+        The shader cannot be used (or have its buffers and textures set) until \ref poll() returns true. On OpenGL this
+        relies on \c GL_KHR_parallel_shader_compile to find out whether the driver is done, and falls back to blocking
+        in the first call to \ref poll() if the extension is not available. On Metal the shader is ready immediately.
+    */
+    Shader(RenderPass *render_pass, const std::string &name, const std::string &vs_source, const std::string &fs_source,
+           BlendMode blend_mode, Async);
+
     /// Release all resources
     virtual ~Shader();
 
@@ -107,6 +144,34 @@ public:
         return m_blend_mode;
     }
 
+    /// Has compilation and linking finished, so that the shader can be used?
+    bool ready() const
+    {
+        return m_ready;
+    }
+
+    /**
+        A counter that increases whenever a buffer, uniform or texture of this shader changes value.
+
+        Comparing it against a previously seen value tells whether anything drawn with this shader needs redrawing.
+        Changes to the contents of a bound texture are not included; see \ref Texture::revision() for those.
+    */
+    uint64_t revision() const
+    {
+        return m_revision;
+    }
+
+    /**
+        Poll an asynchronously constructed shader for completion without blocking.
+
+        Once the driver reports that linking has finished, this checks for errors (throwing a \c std::runtime_error
+        with the compile/link log if there were any) and reflects the shader's attributes and uniforms.
+
+        \return
+            True if the shader is ready to use.
+    */
+    bool poll();
+
     /**
         Upload a buffer (e.g. vertex positions) that will be associated with a named shader parameter.
 
@@ -192,6 +257,16 @@ public:
     */
     void set_buffer_pointer_offset(const std::string &name, size_t offset);
 
+    /**
+        Set the usage hint for a vertex or index buffer (the default is \ref BufferUsage::Dynamic).
+
+        On OpenGL, updates that keep the size of the buffer unchanged are done in place (using glBufferSubData),
+        \ref BufferUsage::Stream buffers are orphaned before each update, and on OpenGL 4.4+ they are instead placed in
+        a persistently mapped ring of buffers guarded by fences. This takes effect at the next \ref set_buffer() call.
+        The hint is currently ignored on Metal.
+    */
+    void set_buffer_usage(const std::string &name, BufferUsage usage);
+
     /**
         Associate a texture with a named shader parameter
 
@@ -239,6 +314,18 @@ public:
     void draw_array(PrimitiveType primitive_type, size_t offset, size_t count, bool indexed = false,
                     size_t instances = 0u);
 
+    /**
+        Render all draws recorded in a \ref DrawList, using as few draw calls as the backend allows.
+
+        Afterwards, \ref DrawList::calls() and \ref DrawList::merged() report how many draw calls were needed.
+        Draws with a non-zero base instance require OpenGL 4.2 or later.
+    */
+    void draw(DrawList &list);
+
+    /// Return the number of bytes of GPU memory currently allocated for the vertex, index and storage buffers of all
+    /// shaders (including the extra copies of persistently mapped ring buffers)
+    static size_t total_buffer_bytes();
+
 #if defined(HELLOIMGUI_HAS_OPENGL)
     uint32_t shader_handle() const
     {
@@ -259,6 +346,11 @@ public:
 #endif
 
 protected:
+    /// Construct a shader without any program, for subclasses that build their own (see \ref ComputeShader)
+    explicit Shader(const std::string &name) : m_render_pass(nullptr), m_name(name), m_blend_mode(BlendMode::None)
+    {
+    }
+
     enum BufferType
     {
         Unknown = 0,
@@ -270,10 +362,15 @@ protected:
         FragmentSampler,
         UniformBuffer,
         IndexBuffer,
+        ImageTexture,  ///< a texture bound for image load/store
+        StorageBuffer, ///< a shader storage buffer object (SSBO)
     };
 
     struct Buffer
     {
+        /// Number of copies of a persistently mapped Stream buffer, so one can be written while the GPU reads another
+        static constexpr int ring_regions = 3;
+
         void        *buffer = nullptr;
         BufferType   type   = Unknown;
         VariableType dtype  = VariableType::Invalid;
@@ -284,18 +381,83 @@ protected:
         size_t       instance_divisor = 0;
         size_t       pointer_offset   = 0;
         bool         dirty            = false;
+        int          slot             = -1; ///< position in the type-sorted binding array (and dirty bitmask)
+        BufferUsage  usage            = BufferUsage::Dynamic;
+        size_t       capacity         = 0;       ///< size of the allocated GPU storage (per ring region)
+        size_t       ring_offset      = 0;       ///< byte offset of the ring region holding the current contents
+        void        *mapped           = nullptr; ///< persistently mapped ring storage (OpenGL only)
+        void        *fences[ring_regions]{};     ///< fences guarding each ring region (OpenGL only)
+        uint8_t      ring_region      = 0;
+        uint32_t     image_format     = 0; ///< internal format of the texture bound to an ImageTexture (OpenGL only)
+        uint32_t     texture_target   = 0; ///< texture target a texture/image argument expects (OpenGL only)
 
         std::string to_string() const;
     };
 
+    /// Number of argument slots tracked by the \ref m_dirty bitmask; \ref begin() walks any further ones
+    static constexpr int dirty_mask_slots = 64;
+
+    /// Flag an argument as needing to be sent to the GPU during the next \ref begin()
+    void mark_dirty(Buffer &buf)
+    {
+        buf.dirty = true;
+        ++m_revision;
+        if (buf.slot >= 0 && buf.slot < dirty_mask_slots)
+            m_dirty |= uint64_t(1) << buf.slot;
+    }
+
 protected:
     RenderPass                             *m_render_pass;
     std::string                             m_name;
     std::unordered_map<std::string, Buffer> m_buffers;
     BlendMode                               m_blend_mode;
+    bool                                    m_ready = false;
+    uint64_t                                m_dirty    = 0; ///< bitmask of the dirty Buffer slots (the first 64)
+    uint64_t                                m_revision = 0; ///< incremented whenever an argument changes
+
+    /// Report to the \ref memory_tracker that \p delta bytes (which may be negative) of GPU buffer storage were
+    /// allocated or freed
+    void track_buffer_bytes(int64_t delta);
+
+    /// Report to the \ref memory_tracker that \p delta bytes (which may be negative) of CPU storage for arguments (e.g.
+    /// uniforms) were allocated or freed
+    void track_argument_bytes(int64_t delta);
+
+    size_t   m_buffer_bytes        = 0; ///< GPU storage of this shader's buffers
+    size_t   m_argument_bytes      = 0; ///< CPU storage of this shader's arguments
+    uint32_t m_buffer_allocation   = 0; ///< entry of m_buffer_bytes in the \ref memory_tracker
+    uint32_t m_argument_allocation = 0; ///< entry of m_argument_bytes in the \ref memory_tracker
 
 #if defined(HELLOIMGUI_HAS_OPENGL)
-    uint32_t m_shader_handle = 0;
+    /// Check the compile and link status and reflect the shader's arguments
+    void finalize();
+
+    /// Upload the contents of a vertex or index buffer, picking a strategy based on its usage hint
+    void upload_buffer(Buffer &buf, uint32_t target, size_t size, const void *data);
+
+    /// Release the GPU storage (and ring fences) of a vertex or index buffer
+    void release_buffer(Buffer &buf);
+
+    /// Bind the textures, images and storage buffers, and send the arguments that changed since the last call
+    void bind_arguments();
+
+    /// Send a single argument (vertex/index buffer binding or uniform) to the GPU
+    void bind_argument(const std::string &key, Buffer &buf);
+
+    /// The entries of \ref m_buffers sorted by type (and then name), indexed by \ref Buffer::slot
+    std::vector<std::pair<const std::string, Buffer> *> m_bindings;
+    size_t      m_texture_begin = 0, m_texture_end = 0; ///< range of texture arguments within \ref m_bindings
+    size_t      m_image_begin = 0, m_image_end = 0;     ///< range of image arguments within \ref m_bindings
+    size_t      m_storage_begin = 0, m_storage_end = 0; ///< range of storage buffers within \ref m_bindings
+    uint64_t    m_rebind_mask  = 0;                     ///< slots that are re-sent in every \ref begin()
+    bool        m_all_bound    = false;                 ///< have all non-index arguments been given data?
+    Buffer     *m_index_buffer = nullptr;
+    const char *m_gpu_label    = nullptr;               ///< interned label of the GPU timer zone around draw calls
+
+    uint32_t m_shader_handle          = 0;
+    uint32_t m_vertex_shader_handle   = 0;
+    uint32_t m_fragment_shader_handle = 0;
+    uint32_t m_compute_shader_handle  = 0;
 #if defined(HELLOIMGUI_USE_GLAD)
     uint32_t m_vertex_array_handle = 0;
     bool     m_uses_point_size     = false;
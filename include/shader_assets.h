@@ -0,0 +1,73 @@
+/**
+    \file shader_assets.h
+*/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/// A file from assets/shaders that was embedded into the executable at build time (by cmake/EmbedShaders.cmake)
+struct EmbeddedShader
+{
+    uint64_t         hash;     ///< \ref shader_name_hash() of \ref filename
+    std::string_view filename; ///< path relative to the assets directory, e.g. "shaders/colormaps.glsl"
+    std::string_view source;   ///< contents of the file
+};
+
+/// FNV-1a hash of a shader filename. Since this can be evaluated incrementally, pass the hash of a prefix as \p hash.
+constexpr uint64_t shader_name_hash(std::string_view name, uint64_t hash = 14695981039346656037ull)
+{
+    for (char c : name)
+        hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+    return hash;
+}
+
+/// Sort the generated table by hash at compile time, so that lookups can use a binary search. (std::sort only becomes
+/// constexpr in C++20.)
+template <size_t N> constexpr std::array<EmbeddedShader, N> sort_by_hash(std::array<EmbeddedShader, N> shaders)
+{
+    for (size_t i = 1; i < N; ++i)
+        for (size_t j = i; j > 0 && shaders[j].hash < shaders[j - 1].hash; --j)
+        {
+            EmbeddedShader tmp = shaders[j];
+            shaders[j]         = shaders[j - 1];
+            shaders[j - 1]     = tmp;
+        }
+    return shaders;
+}
+
+/// The table of embedded shaders, with hashes computed and sorted at compile time
+extern const EmbeddedShader *const embedded_shaders;
+extern const size_t                num_embedded_shaders;
+
+/**
+    Find an embedded shader by its base filename and extension without any filesystem access or allocations.
+
+    Only the name being looked up is hashed at run time; pass \p basename_hash (= shader_name_hash(basename)) to hash
+    the base filename once when trying several extensions.
+
+    \return
+        The shader's source, or an empty string_view if no such shader was embedded.
+*/
+inline std::string_view find_embedded_shader(std::string_view basename, std::string_view extension,
+                                             uint64_t basename_hash)
+{
+    uint64_t hash  = shader_name_hash(extension, basename_hash);
+    auto     end   = embedded_shaders + num_embedded_shaders;
+    auto     first = std::lower_bound(embedded_shaders, end, hash,
+                                      [](const EmbeddedShader &shader, uint64_t h) { return shader.hash < h; });
+    for (auto shader = first; shader != end && shader->hash == hash; ++shader)
+        if (shader->filename.size() == basename.size() + extension.size() &&
+            shader->filename.substr(0, basename.size()) == basename &&
+            shader->filename.substr(basename.size()) == extension)
+            return shader->source;
+    return {};
+}
+
+inline std::string_view find_embedded_shader(std::string_view basename, std::string_view extension)
+{
+    return find_embedded_shader(basename, extension, shader_name_hash(basename));
+}
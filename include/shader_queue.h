@@ -0,0 +1,76 @@
+/**
+    \file shader_queue.h
+*/
+#pragma once
+
+#include "shader.h"
+#include <functional>
+#include <vector>
+
+/**
+    A queue of shaders that are compiled and linked in parallel by the driver.
+
+    All shader sources are submitted up front (using the asynchronous \ref Shader constructor), and \ref poll() should
+    be called once per frame to finalize the shaders that have finished. Until a shader is ready, \ref select() returns
+    a cheap placeholder shader (if one was provided) so that the UI can keep drawing frames in the meantime.
+*/
+class ShaderQueue
+{
+public:
+    /// Called once the shader is ready to use, e.g. to set up its buffers and textures
+    using ReadyCallback = std::function<void(Shader *)>;
+
+    /**
+        Submit a shader for asynchronous compilation.
+
+        \return
+            The new shader, which is owned by the caller. It cannot be used until \ref Shader::ready() returns true.
+    */
+    Shader *submit(RenderPass *render_pass, const std::string &name, const std::string &vs_source,
+                   const std::string &fs_source, Shader::BlendMode blend_mode = Shader::BlendMode::None,
+                   ReadyCallback on_ready = {});
+
+    /**
+        Finalize all shaders that have finished compiling, and call their ready callbacks.
+
+        If a shader failed to compile or link, it is removed from the queue and the error is rethrown.
+
+        \return
+            The number of shaders still pending.
+    */
+    size_t poll();
+
+    /// Return the number of shaders still pending
+    size_t pending() const
+    {
+        return m_pending.size();
+    }
+
+    /// Set a (cheap, synchronously compiled) shader to use in place of shaders that are not ready yet
+    void set_placeholder(Shader *placeholder)
+    {
+        m_placeholder = placeholder;
+    }
+
+    /// Return the placeholder shader (may be nullptr)
+    Shader *placeholder() const
+    {
+        return m_placeholder;
+    }
+
+    /// Return \p shader if it is ready to use, and otherwise the placeholder shader (which may be nullptr)
+    Shader *select(Shader *shader) const
+    {
+        return shader && shader->ready() ? shader : m_placeholder;
+    }
+
+protected:
+    struct Entry
+    {
+        Shader       *shader;
+        ReadyCallback on_ready;
+    };
+
+    std::vector<Entry> m_pending;
+    Shader            *m_placeholder = nullptr;
+};
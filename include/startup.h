@@ -0,0 +1,63 @@
+/**
+    \file startup.h
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+    Breaks the time to the first presented frame down into phases, with the wall-clock and CPU time of each.
+
+    Startup is serial, so it is modeled as a sequence of phases: \ref phase() ends the current phase and starts the
+    next one, and \ref finish() ends the last one once the first frame is on screen. Phases are measured from the first
+    call to \ref phase(), which should be made first thing in main(). The CPU time is that of the whole process, so
+    a phase whose CPU time exceeds its wall-clock time kept other threads (e.g. the driver's shader compiler) busy.
+
+    Work that finishes asynchronously (e.g. a shader compiled in the background) is recorded as an \ref event() at the
+    time it completes, without interrupting the phases.
+*/
+namespace startup
+{
+
+/// A span of startup
+struct Phase
+{
+    std::string name;
+    double      start_ms = 0.0; ///< wall-clock time since startup began
+    double      wall_ms  = 0.0;
+    double      cpu_ms   = 0.0;
+};
+
+/// Something that completed during startup
+struct Event
+{
+    std::string name;
+    double      time_ms = 0.0; ///< wall-clock time since startup began
+};
+
+/// End the current phase (if any) and start the next one (names may repeat). Does nothing once startup has finished.
+void phase(const std::string &name);
+
+/// Record that \p name completed now. Does nothing once startup has finished.
+void event(const std::string &name);
+
+/// End the last phase, once the first frame has been presented, and log the breakdown
+void finish();
+
+/// Has \ref finish() been called?
+bool finished();
+
+/// Return the finished phases, in order
+const std::vector<Phase> &phases();
+
+/// Return the events, in order
+const std::vector<Event> &events();
+
+/// Return the time from the start of the first phase to the end of the last one, in milliseconds
+double total_ms();
+
+/// Return the breakdown as JSON
+std::string to_json();
+
+} // namespace startup
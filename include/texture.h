@@ -6,7 +6,9 @@
 
 #include "linalg.h"
 #include "traits.h"
+#include <memory>
 #include <string>
+#include <string_view>
 using namespace linalg::aliases;
 
 /**
@@ -69,6 +71,14 @@ public:
         MirrorRepeat, ///< Repeat, but flip the texture after crossing the boundary
     };
 
+    /// The kind of texture
+    enum class TextureType : uint8_t
+    {
+        Texture2D,      ///< A single 2D image (possibly multisampled)
+        Texture2DArray, ///< A stack of 2D images (layers) of the same size and format, sampled as \c sampler2DArray
+        Texture3D       ///< A volume (e.g. a color lookup table), sampled as \c sampler3D
+    };
+
     /// How will the texture be used? (Must specify at least one)
     enum TextureFlags
     {
@@ -91,6 +101,18 @@ public:
             WrapMode wrap_mode = WrapMode::ClampToEdge, uint8_t samples = 1,
             uint8_t flags = (uint8_t)TextureFlags::ShaderRead, bool manual_mipmapping = false);
 
+    /**
+        Allocate memory for a 2D array texture or a 3D texture.
+
+        \p size.z is the number of layers (for \ref TextureType::Texture2DArray) or slices (for \ref
+        TextureType::Texture3D). Such textures can only be read in shaders (not rendered into), and are not
+        multisampled.
+    */
+    Texture(TextureType type, PixelFormat pixel_format, ComponentFormat component_format, const int3 &size,
+            InterpolationMode min_interpolation_mode = InterpolationMode::Bilinear,
+            InterpolationMode mag_interpolation_mode = InterpolationMode::Bilinear,
+            WrapMode wrap_mode = WrapMode::ClampToEdge, bool manual_mipmapping = false);
+
     /// Load an image from the given file using stb-image
     Texture(const std::string &filename, InterpolationMode min_interpolation_mode = InterpolationMode::Bilinear,
             InterpolationMode mag_interpolation_mode = InterpolationMode::Bilinear,
@@ -147,33 +169,130 @@ public:
         return m_flags;
     }
 
-    /// Return the size of this texture
+    /// Return the kind of texture
+    TextureType type() const
+    {
+        return m_type;
+    }
+
+    /// Return the size of this texture (of each layer or slice, for array and 3D textures)
     const int2 &size() const
     {
         return m_size;
     }
 
+    /// Return the number of layers of an array texture or slices of a 3D texture (1 for 2D textures)
+    int depth() const
+    {
+        return m_depth;
+    }
+
+    /**
+        A counter that increases whenever the contents of this texture change through \ref upload(), \ref
+        upload_sub_region(), \ref resize() or \ref generate_mipmap().
+
+        Unlike a change of texture, this does not change the \ref Shader::revision() of the shaders it is bound to, so
+        whatever caches a rendering of a texture needs to compare this too.
+    */
+    uint64_t revision() const
+    {
+        return m_revision;
+    }
+
+    /// Return a number identifying this texture that, unlike its address, is never reused by another texture
+    uint64_t serial() const
+    {
+        return m_serial;
+    }
+
     /// Return the number of bytes consumed per pixel of this texture
     size_t bytes_per_pixel() const;
 
+    /// Return the number of bytes consumed per pixel by the given formats
+    static size_t bytes_per_pixel(PixelFormat pixel_format, ComponentFormat component_format);
+
     /// Return the number of channels of this texture
     size_t channels() const;
 
+    /// Return the number of channels of the given pixel format
+    static size_t channels(PixelFormat pixel_format);
+
     /// Upload packed pixel data from the CPU to the GPU
     void upload(const uint8_t *data);
 
-    /// Upload packed pixel data to a rectangular sub-region of the texture from the CPU to the GPU
+    /// Upload packed pixel data to a rectangular sub-region of the texture (of layer/slice 0 for array and 3D
+    /// textures) from the CPU to the GPU. Does nothing if \p data is null.
     void upload_sub_region(const uint8_t *data, const int2 &origin, const int2 &size);
 
+    /**
+        Upload packed pixel data to a box-shaped sub-region of the texture from the CPU to the GPU.
+
+        For array textures, \p origin.z and \p size.z select a range of layers, and for 3D textures a range of slices,
+        so e.g. a single frame of an image sequence can be replaced without touching the others. For 2D textures,
+        \p origin.z must be 0 and \p size.z must be 1. Does nothing if \p data is null.
+    */
+    void upload_sub_region(const uint8_t *data, const int3 &origin, const int3 &size);
+
     /// Download packed pixel data from the GPU to the CPU
     void download(uint8_t *data);
 
+    /// Flip packed pixel data of the given size upside down, in place (e.g. to turn OpenGL's bottom-up rows around)
+    static void flip_rows(uint8_t *data, const int2 &size, size_t bytes_per_pixel);
+
+    /// Decoded RGBA pixels, owned by the image decoder
+    template <typename T> using DecodedImage = std::unique_ptr<T[], void (*)(void *)>;
+
+    /// Is the image encoded in \p data a high dynamic range one (e.g. a .hdr file)?
+    static bool is_hdr(std::string_view data);
+
+    /**
+        Decode an image file loaded into \p data (in any format stb-image supports) to RGBA, and store its size in
+        \p size. Throws a std::runtime_error naming \p filename if the image cannot be decoded.
+
+        This is the only image decoder in the program: the image constructors use the float version, which loads
+        8-bit images as linear values in [0, 1].
+    */
+    static DecodedImage<float>   decode_float(const std::string &filename, std::string_view data, int2 &size);
+    static DecodedImage<uint8_t> decode_uint8(const std::string &filename, std::string_view data, int2 &size);
+
     /// Resize the texture (discards the current contents)
     void resize(const int2 &size);
 
     /// Generates the mipmap. Done automatically upon upload if manual mipmapping is disabled.
     void generate_mipmap();
 
+    /// Return the number of bytes of GPU memory used by this texture (accounting for all samples and layers, but not
+    /// mipmaps), which is also the amount of data transferred by \ref upload() and \ref download()
+    size_t bytes() const
+    {
+        return bytes_per_pixel() * m_size.x * m_size.y * m_depth * m_samples;
+    }
+
+    /// Return the number of bytes of GPU memory allocated for this texture, including its mipmaps (if it has any)
+    size_t allocated_bytes() const;
+
+    /// Return the number of bytes of GPU memory currently used by all textures (see \ref allocated_bytes())
+    static size_t total_bytes();
+
+    /// Set the name this texture is listed under in the \ref memory_tracker (e.g. the file it was loaded from)
+    void set_name(const std::string &name);
+
+    /// Return the name this texture is listed under in the \ref memory_tracker
+    const std::string &name() const
+    {
+        return m_name;
+    }
+
+    /**
+        Return the largest supported number of samples for multisampled textures of the given format.
+
+        The limit depends on the format (e.g. depth or 32-bit float formats may support fewer samples than RGBA8) and
+        on whether the texture is read in shaders (\ref TextureFlags::ShaderRead), which requires a multisampled
+        texture instead of a renderbuffer.
+    */
+    static int max_samples(PixelFormat pixel_format, ComponentFormat component_format,
+                           uint8_t flags = TextureFlags::RenderTarget);
+
 #if defined(HELLOIMGUI_HAS_OPENGL)
     uint32_t texture_handle() const
     {
@@ -183,6 +302,23 @@ public:
     {
         return m_renderbuffer_handle;
     }
+    /// Return the sized internal format (e.g. GL_RGBA16F), as needed to bind the texture as an image
+    uint32_t internal_format() const
+    {
+        return m_internal_format;
+    }
+
+    /// Return the texture target (e.g. GL_TEXTURE_2D_ARRAY) matching the type and sample count
+    uint32_t target() const;
+
+    /**
+        Map a pixel and component format onto OpenGL's pixel format, type and sized internal format.
+
+        Formats that OpenGL doesn't support directly are replaced in place by the closest supported ones (e.g. BGR
+        by RGB). Throws if there is no matching OpenGL format. This needs no OpenGL context.
+    */
+    static void gl_map_format(PixelFormat &pixel_format, ComponentFormat &component_format, uint32_t &pixel_format_gl,
+                              uint32_t &component_format_gl, uint32_t &internal_format_gl);
 #elif defined(HELLOIMGUI_HAS_METAL)
     void *texture_handle() const
     {
@@ -198,6 +334,10 @@ protected:
     /// Initialize the texture handle
     void init();
 
+    /// Report to the \ref memory_tracker that the storage of this texture was (re)allocated with \p bytes bytes, or
+    /// freed (if \p bytes is 0)
+    void track_bytes(size_t bytes);
+
 protected:
     PixelFormat       m_pixel_format;
     ComponentFormat   m_component_format;
@@ -208,10 +348,20 @@ protected:
     uint8_t           m_flags;
     int2              m_size;
     bool              m_manual_mipmapping;
+    TextureType       m_type          = TextureType::Texture2D;
+    int               m_depth         = 1;
+    std::string       m_name;
+    uint32_t          m_allocation    = 0; ///< this texture's entry in the \ref memory_tracker
+    uint64_t          m_revision      = 0; ///< incremented whenever the contents change
+    uint64_t          m_serial        = next_serial();
+
+    /// Return a new, never used \ref serial()
+    static uint64_t next_serial();
 
 #if defined(HELLOIMGUI_HAS_OPENGL)
     uint32_t m_texture_handle      = 0;
     uint32_t m_renderbuffer_handle = 0;
+    uint32_t m_internal_format     = 0;
 #elif defined(HELLOIMGUI_HAS_METAL)
     void *m_texture_handle       = nullptr;
     void *m_sampler_state_handle = nullptr;
@@ -0,0 +1,154 @@
+/**
+    \file thumbnail_browser.h
+*/
+#pragma once
+
+#include "linalg.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace linalg::aliases;
+
+class RenderPass;
+class Shader;
+class Texture;
+
+/**
+    A grid of thumbnails of all images in a directory.
+
+    Thumbnails are decoded and downscaled by a pool of worker threads, and only for the rows that are visible (or
+    about to be scrolled into view), nearest first. Finished thumbnails are packed into a few large atlas textures, so
+    the grid is drawn with one instanced draw per atlas (into an offscreen target that is only redrawn when something
+    changed) rather than one texture and draw per thumbnail. Thumbnails are also cached on disk, keyed by the image's
+    path, size and modification time, so revisiting a directory only decodes the images that changed.
+
+    \note
+        Requires threads and filesystem access, so this is not available on the web.
+*/
+class ThumbnailBrowser
+{
+public:
+    /// The largest width/height of a thumbnail, in pixels
+    static constexpr int thumbnail_size = 128;
+
+    /// Box-filter 8-bit (sRGB-encoded) RGBA pixels down to a thumbnail of at most \ref thumbnail_size pixels per side
+    static void make_thumbnail(const uint8_t *rgba, const int2 &size, std::vector<uint8_t> &pixels, int2 &thumb_size);
+
+    /// Box-filter linear floating-point RGBA pixels down to an sRGB-encoded 8-bit thumbnail
+    static void make_thumbnail(const float *rgba, const int2 &size, std::vector<uint8_t> &pixels, int2 &thumb_size);
+
+    /// Called with the path of a thumbnail that was double-clicked
+    using OpenCallback = std::function<void(const std::string &)>;
+
+    /// Start the worker threads; no directory is shown until \ref set_directory() is called
+    explicit ThumbnailBrowser(OpenCallback on_open = {});
+
+    /// Stop the worker threads and release all textures
+    ~ThumbnailBrowser();
+
+    /// Show the images in \p directory (not recursively), discarding any thumbnails of the previous directory
+    void set_directory(const std::string &directory);
+
+    /// Return the directory being shown
+    const std::string &directory() const
+    {
+        return m_directory;
+    }
+
+    /// Return the number of images in the directory
+    size_t size() const
+    {
+        return m_items.size();
+    }
+
+    /// Return the directory used to cache thumbnails on disk (empty if caching is disabled)
+    const std::string &cache_directory() const
+    {
+        return m_cache_directory;
+    }
+
+    /// Draw the browser into the current ImGui window. Must be called once per frame while the browser is visible.
+    void draw();
+
+protected:
+    /// The state of a thumbnail, as seen by the worker threads
+    enum class State : uint8_t
+    {
+        Unloaded, ///< not requested (or no longer wanted)
+        Queued,   ///< waiting for a worker
+        Loading,  ///< being decoded (or read from the cache) by a worker
+        Done      ///< finished, successfully or not
+    };
+
+    /// A thumbnail produced by a worker thread
+    struct Decoded
+    {
+        size_t               index      = 0;
+        uint64_t             generation = 0;
+        int2                 size{0};        ///< size of the thumbnail (0 if the image could not be loaded)
+        int2                 source_size{0}; ///< size of the full image
+        std::vector<uint8_t> pixels;         ///< RGBA8, top row first
+    };
+
+    /// An image in the directory, as seen by the main thread
+    struct Item
+    {
+        std::string path;
+        std::string name;
+        int2        source_size{0};
+        int         page = -1; ///< atlas holding the thumbnail, or -1 if it is not (yet) loaded
+        float4      rect{0.f}; ///< position and size of the thumbnail within its grid cell (in points)
+        float4      uv{0.f};   ///< top-left and bottom-right texture coordinates within the atlas
+        bool        failed = false;
+    };
+
+    struct Page;
+
+    void worker();
+    bool load(const std::string &path, Decoded &result);
+    void request(size_t first, size_t last, size_t prefetch);
+    void receive();
+    void add_to_atlas(Item &item, const Decoded &thumbnail);
+    void update_instances(int columns);
+    void render(const int2 &size, float scroll);
+    void release();
+
+    OpenCallback m_on_open;
+    std::string  m_directory;
+    std::string  m_cache_directory;
+
+    std::vector<Item>   m_items;
+    std::vector<Page *> m_pages;
+    int                 m_selected = -1;
+
+    // shared with the worker threads (guarded by m_mutex)
+    std::mutex               m_mutex;
+    std::condition_variable  m_wake;
+    std::vector<std::string> m_paths;
+    std::vector<State>       m_states;
+    std::deque<size_t>       m_queue;
+    std::vector<Decoded>     m_done;
+    uint64_t                 m_generation = 0;
+    bool                     m_quit       = false;
+    std::vector<std::thread> m_workers;
+
+    std::atomic<size_t> m_cache_hits{0}, m_decoded{0};
+    size_t              m_loaded          = 0;
+    size_t              m_first_requested = 0, m_last_requested = 0;
+
+    // grid rendering
+    RenderPass         *m_render_pass = nullptr;
+    Shader             *m_shader      = nullptr;
+    Texture            *m_target      = nullptr; ///< the visible part of the grid, displayed with ImGui::Image()
+    std::vector<size_t> m_page_instances; ///< index of the first instance of each atlas (plus the total at the end)
+    int                 m_columns     = 0;
+    bool                m_dirty       = true; ///< does m_target need to be redrawn?
+    float               m_last_scroll = -1.f;
+};
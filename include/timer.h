@@ -7,10 +7,12 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
-//! Simple timer with millisecond precision
+//! Simple timer reporting fractional milliseconds
 /*!
-    This class is convenient for collecting performance data
+    This class is convenient for collecting performance data. It uses a monotonic clock, so it is unaffected by changes
+    to the system time.
 */
 class Timer
 {
@@ -24,26 +26,30 @@ public:
     //! Reset the timer to the current time
     void reset()
     {
-        start = std::chrono::system_clock::now();
+        start = std::chrono::steady_clock::now();
     }
 
     //! Return the number of milliseconds elapsed since the timer was last reset
     double elapsed() const
     {
-        auto now      = std::chrono::system_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
-        return (double)duration.count();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    //! Return the number of nanoseconds elapsed since the timer was last reset
+    int64_t elapsed_ns() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
     }
 
     //! Return the number of milliseconds elapsed since the timer was last reset and then reset it
     double lap()
     {
-        auto now      = std::chrono::system_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+        auto now      = std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration<double, std::milli>(now - start);
         start         = now;
-        return (double)duration.count();
+        return duration.count();
     }
 
 private:
-    std::chrono::system_clock::time_point start;
+    std::chrono::steady_clock::time_point start;
 };
@@ -0,0 +1,58 @@
+/**
+    \file trace.h
+*/
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+    Records a few seconds of \ref profiler data into a trace file, to see what happened during a stutter without
+    attaching a profiler.
+
+    A recording collects the CPU zones of all threads, the GPU zones, the counters (e.g. texture upload sizes) and the
+    messages of each frame. Frames are copied from the profiler's history a few frames late, so that their GPU results
+    have arrived. Once the recording is complete, the file is written in the Chrome trace-event JSON format (which
+    Perfetto and chrome://tracing can load) on a background thread, so that writing does not cause hitches itself.
+
+    \note
+        Requires threads and filesystem access, so this is not available on the web.
+*/
+namespace trace
+{
+
+/// Start recording the next \p seconds into \p filename. Returns false (and does nothing) if a trace is still being
+/// recorded or written.
+bool start(const std::string &filename, double seconds);
+
+/// Stop the recording early; the frames recorded so far are still written
+void stop();
+
+/// Is a trace being recorded?
+bool recording();
+
+/// Is a finished trace still being written?
+bool writing();
+
+/// Return the fraction of the requested duration recorded so far (0 if not recording)
+float progress();
+
+/// Return a file name for a new JSON file of the given \p kind (e.g. "trace" or "hitches") in the current directory,
+/// based on the current date and time
+std::string default_filename(std::string_view kind = "trace");
+
+/// Copy the frames that are complete into the recording. Call once per frame from the main thread, after
+/// \ref profiler::new_frame() and \ref gpu_timer::new_frame().
+void new_frame();
+
+/// Write out a trace that is still being recorded and wait for all writes to finish. Call before exiting.
+void shutdown();
+
+/// Append \p text to \p out, escaping the characters a JSON string can't contain. Unlike the recording functions
+/// above, this is also available on the web.
+void append_escaped(std::string &out, std::string_view text);
+
+/// Return \p text as a quoted and escaped JSON string
+std::string json_string(std::string_view text);
+
+} // namespace trace
@@ -0,0 +1,343 @@
+#include "alloc_tracker.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/core.h>
+#include <mutex>
+#include <new>
+
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define ALLOC_TRACKER_HAS_STACKS
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+
+#if defined(_MSC_VER)
+#define ALLOC_TRACKER_NOINLINE __declspec(noinline)
+#else
+#define ALLOC_TRACKER_NOINLINE __attribute__((noinline))
+#endif
+
+using namespace alloc_tracker;
+
+static const char *const other_label = "(other)";
+
+static std::atomic<bool>     s_enabled{false};
+static std::atomic<bool>     s_capture_stacks{false};
+static std::atomic<size_t>   s_budget{0};
+static std::atomic<uint64_t> s_over_budget{0};
+
+// everything below is only touched with s_mutex held, which (unlike the counts) is fine since tracking is opt-in
+static std::mutex s_mutex;
+static Frame      s_current;
+static Frame      s_last;
+static Stack      s_stacks[max_stacks];
+static size_t     s_num_stacks = 0;
+
+/// Set while the calling thread is recording an allocation, so that allocations made while recording (e.g. by
+/// backtrace() loading its unwinder) are not recorded in turn
+static thread_local bool t_recording = false;
+
+static void add_to_zone(Frame &f, const char *label, size_t bytes)
+{
+    Zone *zone = nullptr;
+    for (size_t i = 0; i < f.num_zones && !zone; ++i)
+        if (f.zones[i].label == label)
+            zone = &f.zones[i];
+    if (!zone)
+    {
+        // the last slot collects the zones that don't fit
+        if (f.num_zones == max_zones)
+        {
+            zone = &f.zones[max_zones];
+            if (zone->label != other_label)
+                *zone = Zone{other_label, 0, 0};
+        }
+        else
+        {
+            zone        = &f.zones[f.num_zones++];
+            *zone       = Zone{};
+            zone->label = label;
+        }
+    }
+    zone->allocations += 1;
+    zone->bytes += bytes;
+}
+
+static void add_stack(void *const *frames, size_t depth, const char *zone, size_t bytes)
+{
+    // open addressing on a hash of the return addresses
+    size_t hash = depth;
+    for (size_t i = 0; i < depth; ++i)
+        hash = (hash ^ (size_t)(uintptr_t)frames[i]) * 0x100000001b3ull;
+
+    for (size_t probe = 0; probe < max_stacks; ++probe)
+    {
+        Stack &s = s_stacks[(hash + probe) % max_stacks];
+        if (s.depth == 0)
+        {
+            std::copy(frames, frames + depth, s.frames);
+            s.depth = depth;
+            s.zone  = zone;
+            ++s_num_stacks;
+        }
+        else if (s.depth != depth || !std::equal(frames, frames + depth, s.frames))
+            continue;
+        s.allocations += 1;
+        s.bytes += bytes;
+        return;
+    }
+}
+
+/// Record an allocation of \p bytes bytes. Not inlined, so that the call stack always starts the same number of
+/// frames above it.
+static ALLOC_TRACKER_NOINLINE void record(size_t bytes)
+{
+    t_recording = true;
+
+    const char *zone = profiler::current_zone();
+
+#if defined(ALLOC_TRACKER_HAS_STACKS)
+    // skip record(), allocate() and operator new
+    static constexpr int skip = 3;
+    void                *frames[max_stack_depth + skip];
+    int                  depth = 0;
+    if (s_capture_stacks.load(std::memory_order_relaxed))
+        depth = backtrace(frames, int(max_stack_depth + skip));
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_current.allocations += 1;
+        s_current.bytes += bytes;
+        add_to_zone(s_current, zone, bytes);
+#if defined(ALLOC_TRACKER_HAS_STACKS)
+        if (depth > skip && s_num_stacks < max_stacks)
+            add_stack(frames + skip, size_t(depth - skip), zone, bytes);
+#endif
+    }
+
+    t_recording = false;
+}
+
+/// Not inlined either, for the same reason
+static ALLOC_TRACKER_NOINLINE void *allocate(size_t bytes)
+{
+    void *p = std::malloc(bytes ? bytes : 1);
+    if (p && s_enabled.load(std::memory_order_relaxed) && !t_recording)
+        record(bytes);
+    return p;
+}
+
+static void deallocate(void *p)
+{
+    if (p && s_enabled.load(std::memory_order_relaxed) && !t_recording)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_current.frees += 1;
+    }
+    std::free(p);
+}
+
+void *operator new(size_t bytes)
+{
+    if (void *p = allocate(bytes))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t bytes)
+{
+    if (void *p = allocate(bytes))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t bytes, const std::nothrow_t &) noexcept
+{
+    return allocate(bytes);
+}
+
+void *operator new[](size_t bytes, const std::nothrow_t &) noexcept
+{
+    return allocate(bytes);
+}
+
+void operator delete(void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
+
+namespace alloc_tracker
+{
+
+bool stacks_supported()
+{
+#if defined(ALLOC_TRACKER_HAS_STACKS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void set_enabled(bool enabled)
+{
+    if (enabled && !s_enabled.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_current = Frame{};
+        s_over_budget.store(0, std::memory_order_relaxed);
+    }
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool enabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+void set_capture_stacks(bool capture)
+{
+    s_capture_stacks.store(capture && stacks_supported(), std::memory_order_relaxed);
+}
+
+bool capture_stacks()
+{
+    return s_capture_stacks.load(std::memory_order_relaxed);
+}
+
+void set_budget(size_t allocations)
+{
+    s_budget.store(allocations, std::memory_order_relaxed);
+}
+
+size_t budget()
+{
+    return s_budget.load(std::memory_order_relaxed);
+}
+
+void new_frame()
+{
+    if (!s_enabled.load(std::memory_order_relaxed))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_last          = s_current;
+        s_current       = Frame{};
+        s_last.index    = profiler::frame_index();
+        s_current.index = s_last.index + 1;
+    }
+
+    size_t num_zones = s_last.num_zones + (s_last.zones[max_zones].label ? 1 : 0);
+    std::sort(s_last.zones, s_last.zones + num_zones,
+              [](const Zone &a, const Zone &b) { return a.allocations > b.allocations; });
+    s_last.num_zones = num_zones;
+
+    if (s_last.allocations > budget())
+        s_over_budget.fetch_add(1, std::memory_order_relaxed);
+
+    PROFILE_COUNT("Heap allocations", s_last.allocations);
+    PROFILE_COUNT("Heap bytes", s_last.bytes);
+}
+
+const Frame &last_frame()
+{
+    return s_last;
+}
+
+uint64_t frames_over_budget()
+{
+    return s_over_budget.load(std::memory_order_relaxed);
+}
+
+std::vector<Stack> top_stacks(size_t count)
+{
+    // allocating while holding the lock would deadlock, since operator new takes it too
+    std::vector<Stack> result;
+    result.reserve(max_stacks);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (auto &s : s_stacks)
+            if (s.depth)
+                result.push_back(s);
+    }
+    count = std::min(count, result.size());
+    std::partial_sort(result.begin(), result.begin() + count, result.end(),
+                      [](const Stack &a, const Stack &b) { return a.allocations > b.allocations; });
+    result.resize(count);
+    return result;
+}
+
+void clear_stacks()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::fill(std::begin(s_stacks), std::end(s_stacks), Stack{});
+    s_num_stacks = 0;
+}
+
+std::vector<std::string> symbolize(const Stack &stack)
+{
+    std::vector<std::string> result;
+#if defined(ALLOC_TRACKER_HAS_STACKS)
+    for (size_t i = 0; i < stack.depth; ++i)
+    {
+        void   *address = stack.frames[i];
+        Dl_info info;
+        if (!dladdr(address, &info) || !info.dli_fname)
+        {
+            result.push_back(fmt::format("{}", address));
+            continue;
+        }
+
+        const char *module = info.dli_fname;
+        if (const char *slash = std::strrchr(module, '/'))
+            module = slash + 1;
+        if (!info.dli_sname)
+        {
+            result.push_back(fmt::format("{}+0x{:x}", module, (uintptr_t)address - (uintptr_t)info.dli_fbase));
+            continue;
+        }
+
+        int   status    = 0;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        result.push_back(fmt::format("{}: {}+0x{:x}", module, status == 0 ? demangled : info.dli_sname,
+                                     (uintptr_t)address - (uintptr_t)info.dli_saddr));
+        std::free(demangled);
+    }
+#else
+    (void)stack;
+#endif
+    return result;
+}
+
+} // namespace alloc_tracker
@@ -9,11 +9,19 @@
 #include "imgui_ext.h"
 #include "imgui_internal.h"
 
+#include "alloc_tracker.h"
+#include "capture.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "memory_tracker.h"
 #include "opengl_check.h"
+#include "profiler.h"
+#include "startup.h"
 
 #include "texture.h"
 #include "timer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fmt/core.h>
 #include <fstream>
@@ -25,6 +33,7 @@
 using std::string_view;
 #else
 #include "portable-file-dialogs.h"
+#include "trace.h"
 #endif
 
 #ifdef HELLOIMGUI_USE_SDL_OPENGL3
@@ -71,6 +80,32 @@ SampleViewer::SampleViewer()
     consoleWindow.rememberIsVisible = true;
     consoleWindow.GuiFunction       = [] { HelloImGui::LogGui(); };
 
+    HelloImGui::DockableWindow performanceWindow;
+    performanceWindow.label             = "Performance";
+    performanceWindow.dockSpaceName     = "EditorSpace";
+    performanceWindow.isVisible         = false;
+    performanceWindow.rememberIsVisible = true;
+    performanceWindow.GuiFunction       = [this]
+    {
+        m_performance.draw();
+        m_hitches.draw();
+    };
+
+#ifndef __EMSCRIPTEN__
+    HelloImGui::DockableWindow thumbnailsWindow;
+    thumbnailsWindow.label             = "Thumbnails";
+    thumbnailsWindow.dockSpaceName     = "EditorSpace";
+    thumbnailsWindow.isVisible         = false;
+    thumbnailsWindow.rememberIsVisible = true;
+    thumbnailsWindow.GuiFunction       = [this]
+    {
+        if (m_thumbnails)
+            m_thumbnails->draw();
+        else
+            ImGui::TextDisabled("Use File > Browse directory... to show the images in a directory");
+    };
+#endif
+
     // docking layouts
     {
         m_params.dockingParams.layoutName      = "Settings on left";
@@ -101,6 +136,16 @@ SampleViewer::SampleViewer()
 
         m_params.alternativeDockingLayouts = {right_layout, portrait_layout, landscape_layout};
 
+        m_params.dockingParams.dockableWindows.push_back(performanceWindow);
+        for (auto &layout : m_params.alternativeDockingLayouts)
+            layout.dockableWindows.push_back(performanceWindow);
+
+#ifndef __EMSCRIPTEN__
+        m_params.dockingParams.dockableWindows.push_back(thumbnailsWindow);
+        for (auto &layout : m_params.alternativeDockingLayouts)
+            layout.dockableWindows.push_back(thumbnailsWindow);
+#endif
+
 #ifdef __EMSCRIPTEN__
         HelloImGui::Log(HelloImGui::LogLevel::Info, "Screen size: %d, %d\nWindow size: %d, %d", screen_width(),
                         screen_height(), window_width(), window_height());
@@ -122,49 +167,75 @@ SampleViewer::SampleViewer()
     {
         std::string roboto_r = "fonts/Roboto/Roboto-Regular.ttf";
         std::string roboto_b = "fonts/Roboto/Roboto-Bold.ttf";
-        if (!HelloImGui::AssetExists(roboto_r) || !HelloImGui::AssetExists(roboto_b))
-            return;
-
-        for (auto font_size : {14, 10, 16, 18, 30})
-        {
-            m_regular[font_size] = HelloImGui::LoadFontTTF_WithFontAwesomeIcons(roboto_r, (float)font_size);
-            m_bold[font_size]    = HelloImGui::LoadFontTTF_WithFontAwesomeIcons(roboto_b, (float)font_size);
-        }
+        if (HelloImGui::AssetExists(roboto_r) && HelloImGui::AssetExists(roboto_b))
+            for (auto font_size : {14, 10, 16, 18, 30})
+            {
+                startup::phase(fmt::format("Load Roboto-Regular {}px", font_size));
+                m_regular[font_size] = HelloImGui::LoadFontTTF_WithFontAwesomeIcons(roboto_r, (float)font_size);
+                startup::phase(fmt::format("Load Roboto-Bold {}px", font_size));
+                m_bold[font_size] = HelloImGui::LoadFontTTF_WithFontAwesomeIcons(roboto_b, (float)font_size);
+            }
+        startup::phase("HelloImGui init");
     };
 
     m_params.callbacks.SetupImGuiStyle = [this]()
     {
         try
         {
+            startup::phase("Create the render passes");
             m_render_pass = new RenderPass(false, true);
             m_render_pass->set_cull_mode(RenderPass::CullMode::Disabled);
             m_render_pass->set_depth_test(RenderPass::DepthTest::Always, false);
             // m_shader =
             //     new Shader(m_render_pass, "Test shader", Shader::from_asset("shaders/gradient-shader_vert"),
             //                Shader::from_asset("shaders/gradient-shader_frag"), Shader::BlendMode::AlphaBlend);
-            m_shader     = new Shader(m_render_pass, "Test shader", Shader::from_asset("shaders/image-shader_vert"),
-                                      Shader::prepend_includes(Shader::from_asset("shaders/image-shader_frag"),
-                                                               {"shaders/colorspaces", "shaders/colormaps"}),
-                                      Shader::BlendMode::AlphaBlend);
+            startup::phase("Create the null texture");
             m_null_image = new Texture(Texture::PixelFormat::RGBA, Texture::ComponentFormat::Float32, {1, 1},
                                        Texture::InterpolationMode::Nearest, Texture::InterpolationMode::Nearest,
                                        Texture::WrapMode::Repeat);
             static float pixel[] = {0.5f, 0.5f, 0.5f, 1.f};
             m_null_image->upload((const uint8_t *)&pixel);
-            m_shader->set_texture("image", m_null_image);
+            m_null_image->set_name("Null image");
+
+#if defined(HELLOIMGUI_HAS_OPENGL)
+            // the image layer is rendered offscreen and only redrawn when it changes (see draw_background())
+            startup::phase("Create the image layer");
+            m_layer = new Texture(Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8, {1, 1},
+                                  Texture::InterpolationMode::Nearest, Texture::InterpolationMode::Nearest,
+                                  Texture::WrapMode::ClampToEdge, 1,
+                                  Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget);
+            m_layer->set_name("Image layer");
+            m_layer_pass = new RenderPass(vector<Texture *>{m_layer});
+            m_layer_pass->set_cull_mode(RenderPass::CullMode::Disabled);
+#endif
+
+            // the shader is compiled in the background; until it is ready draw_background() only clears the screen
+            startup::phase("Submit the image shader");
+            m_shader = m_shader_queue.submit(
+                m_layer_pass ? m_layer_pass : m_render_pass, "Test shader", Shader::from_asset("shaders/image-shader_vert"),
+                Shader::prepend_includes(Shader::from_asset("shaders/image-shader_frag"),
+                                         {"shaders/colorspaces", "shaders/colormaps"}),
+                Shader::BlendMode::AlphaBlend,
+                [this](Shader *shader)
+                {
+                    shader->set_texture("image", m_null_image);
 
-            const float positions[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, -1.f, 1.f, 1.f, -1.f, 1.f};
-            m_shader->set_buffer("position", VariableType::Float32, {6, 2}, positions);
-            m_shader->set_uniform("primary_pos", float2{0.f});
-            m_shader->set_uniform("primary_scale", float2{1.f});
+                    const float positions[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, -1.f, 1.f, 1.f, -1.f, 1.f};
+                    shader->set_buffer_usage("position", Shader::BufferUsage::Static);
+                    shader->set_buffer("position", VariableType::Float32, {6, 2}, positions);
+                    shader->set_uniform("primary_pos", float2{0.f});
+                    shader->set_uniform("primary_scale", float2{1.f});
 
-            HelloImGui::Log(HelloImGui::LogLevel::Info, "Successfully initialized GL!");
+                    HelloImGui::Log(HelloImGui::LogLevel::Info, "Successfully initialized GL!");
+                    startup::event("Image shader ready");
+                });
         }
         catch (const std::exception &e)
         {
             fmt::print(stderr, "Shader initialization failed!:\n\t{}.", e.what());
             HelloImGui::Log(HelloImGui::LogLevel::Error, "Shader initialization failed!:\n\t%s.", e.what());
         }
+        startup::phase("HelloImGui init");
     };
 
     // m_params.callbacks.PostInit = [this]() {
@@ -174,45 +245,166 @@ SampleViewer::SampleViewer()
     m_params.callbacks.ShowAppMenuItems = [this]()
     {
 #ifndef __EMSCRIPTEN__
-        if (ImGui::MenuItem(ICON_FA_FOLDER_OPEN " Open image..."))
+        if (ImGui::MenuItem(ICON_FA_FOLDER_OPEN " Open image...", nullptr, false, m_shader && m_shader->ready()))
         {
             auto result = pfd::open_file("Open image", "", {"Image files", "*.png *.jpeg *.jpg *.hdr *.bmp"}).result();
             if (!result.empty())
-            {
-                HelloImGui::Log(HelloImGui::LogLevel::Debug, "Loading file '%s'...", result.front().c_str());
-                Texture *tex = new Texture(result.front());
-                m_shader->set_texture("image", tex);
-            }
+                open_image(result.front());
         }
+        if (ImGui::MenuItem(ICON_FA_TH " Browse directory..."))
+        {
+            string start  = m_thumbnails ? m_thumbnails->directory() : "";
+            auto   result = pfd::select_folder("Browse directory", start).result();
+            if (!result.empty())
+                browse_directory(result);
+        }
+        ImGui::Separator();
+        if (trace::recording())
+        {
+            if (ImGui::MenuItem(ICON_FA_STOP " Stop recording trace",
+                                fmt::format("{:.0f}%", 100.f * trace::progress()).c_str()))
+                trace::stop();
+        }
+        else if (ImGui::MenuItem(ICON_FA_CIRCLE " Record trace", "5 s", false, !trace::writing()))
+            trace::start(trace::default_filename(), 5.0);
+        if (capture::recording() &&
+            ImGui::MenuItem(ICON_FA_STOP " Stop capture",
+                            fmt::format("{:.1f} MB", capture::bytes_written() / (1024.0 * 1024.0)).c_str()))
+            capture::stop();
 #else
-        static Texture *tex = nullptr;
-        ;
         auto handle_upload_file =
             [](const string &filename, const string &mime_type, string_view buffer, void *my_data = nullptr)
         {
             auto that{reinterpret_cast<SampleViewer *>(my_data)};
             HelloImGui::Log(HelloImGui::LogLevel::Debug, "Loading file '%s' of mime type '%s' ...", filename.c_str(),
                             mime_type.c_str());
-            delete tex;
-            tex = new Texture(filename, buffer);
-            that->m_shader->set_texture("image", tex);
-            delete tex;
-            tex = nullptr;
+            that->set_image(new Texture(filename, buffer));
         };
-        if (ImGui::MenuItem(ICON_FA_FOLDER_OPEN " Open image..."))
+        if (ImGui::MenuItem(ICON_FA_FOLDER_OPEN " Open image...", nullptr, false, m_shader && m_shader->ready()))
         {
             // open the browser's file selector, and pass the file to the upload handler
             emscripten_browser_file::upload(".png,.hdr,.jpg,.jpeg", handle_upload_file, this);
             HelloImGui::Log(HelloImGui::LogLevel::Debug, "Requesting file from user");
         }
 #endif
+
+#if defined(HELLOIMGUI_HAS_OPENGL)
+        if (m_layer && ImGui::BeginMenu("Anti-aliasing"))
+        {
+            // show the extra memory and the last measured GPU time of a layer redraw (incl. resolve) for each option
+            auto item = [this](Antialiasing aa, int samples, const string &name, size_t extra_bytes)
+            {
+                const char *label = aa_label(aa, samples);
+                for (uint64_t i = profiler::frame_index(); i > 0 && profiler::frame(i); --i)
+                {
+                    auto &zones = profiler::frame(i)->zones;
+                    auto  it    = std::find_if(zones.begin(), zones.end(),
+                                               [label](const profiler::Zone &z)
+                                               { return z.label == label && z.source == profiler::Source::GPU; });
+                    if (it != zones.end())
+                    {
+                        m_aa_gpu_ns[label] = it->duration_ns;
+                        break;
+                    }
+                }
+
+                string cost = fmt::format("+{:.1f} MB", extra_bytes / (1024.0 * 1024.0));
+                if (auto t = m_aa_gpu_ns.find(label); t != m_aa_gpu_ns.end())
+                    cost += fmt::format(", {:.2f} ms", t->second * 1e-6);
+
+                bool selected = m_aa == aa && (aa != Antialiasing::MSAA || m_aa_samples == samples);
+                if (ImGui::MenuItem(name.c_str(), cost.c_str(), selected))
+                {
+                    m_aa           = aa;
+                    m_aa_samples   = samples;
+                    m_layer_shader = nullptr; // force a redraw
+                }
+            };
+
+            size_t layer_bytes = m_layer->bytes();
+            int    max_samples = Texture::max_samples(m_layer->pixel_format(), m_layer->component_format());
+            item(Antialiasing::None, 1, "None", 0);
+            for (int samples : {2, 4, 8, 16})
+                if (samples <= max_samples)
+                    item(Antialiasing::MSAA, samples, fmt::format("MSAA {}x", samples), samples * layer_bytes);
+            item(Antialiasing::Supersample, 4, "Supersampling 2x2", 4 * layer_bytes);
+            ImGui::EndMenu();
+        }
+#endif
+    };
+
+    m_params.callbacks.PreNewFrame = [this]()
+    {
+        // before the profiler moves on, so that the allocation counts are reported on the frame that made them
+        alloc_tracker::new_frame();
+        profiler::new_frame();
+        gpu_timer::new_frame();
+        m_hitches.new_frame();
+
+        // the first frame has been presented once the next one begins
+        if (!startup::finished())
+        {
+            if (m_first_frame_started)
+            {
+                startup::finish();
+                if (m_startup_report)
+                {
+                    fmt::print("{}", startup::to_json());
+                    m_params.appShallExit = true;
+                }
+            }
+            else
+            {
+                startup::phase("First frame");
+                m_first_frame_started = true;
+            }
+        }
+
+#ifndef __EMSCRIPTEN__
+        trace::new_frame();
+#endif
+        capture::new_frame();
+#if defined(HELLOIMGUI_HAS_OPENGL)
+        gl_error_check_new_frame();
+#endif
     };
 
     m_params.callbacks.CustomBackground = [this]() { draw_background(); };
+
+    m_params.callbacks.BeforeExit = [this]()
+    {
+#ifndef __EMSCRIPTEN__
+        // stop the worker threads and release the atlases while the GL context still exists
+        delete m_thumbnails;
+        m_thumbnails = nullptr;
+
+        // finish writing any trace
+        trace::shutdown();
+#endif
+
+        // release the GPU resources while the context still exists, so that anything left over is a leak
+        delete m_shader;
+        delete m_aa_pass;
+        delete m_aa_target;
+        delete m_layer_pass;
+        delete m_layer;
+        delete m_image;
+        delete m_null_image;
+        delete m_render_pass;
+        m_shader = m_layer_shader = nullptr;
+        m_aa_pass = m_layer_pass = m_render_pass = nullptr;
+        m_aa_target = m_layer = m_image = m_null_image = nullptr;
+
+        // after the releases above, so that replaying the capture releases everything too
+        capture::stop();
+        memory_tracker::report_leaks();
+    };
 }
 
 void SampleViewer::run()
 {
+    // creating the window and the graphics context, up to the first of our callbacks
+    startup::phase("HelloImGui init");
     HelloImGui::Run(m_params);
 }
 
@@ -220,12 +412,107 @@ SampleViewer::~SampleViewer()
 {
 }
 
+void SampleViewer::set_image(Texture *image)
+{
+    // the shader must not refer to the old image anymore once it is deleted
+    m_shader->set_texture("image", image ? image : m_null_image);
+    delete m_image;
+    m_image = image;
+}
+
+#ifndef __EMSCRIPTEN__
+void SampleViewer::open_image(const string &filename)
+{
+    if (!m_shader || !m_shader->ready())
+        return;
+
+    HelloImGui::Log(HelloImGui::LogLevel::Debug, "Loading file '%s'...", filename.c_str());
+    set_image(new Texture(filename));
+}
+
+void SampleViewer::browse_directory(const string &directory)
+{
+    try
+    {
+        if (!m_thumbnails)
+            m_thumbnails = new ThumbnailBrowser(
+                [this](const string &filename)
+                {
+                    try
+                    {
+                        open_image(filename);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        HelloImGui::Log(HelloImGui::LogLevel::Error, "Could not open '%s':\n\t%s.", filename.c_str(),
+                                        e.what());
+                        profiler::message(fmt::format("Could not open '{}': {}", filename, e.what()));
+                    }
+                });
+        m_thumbnails->set_directory(directory);
+        HelloImGui::Log(HelloImGui::LogLevel::Info, "Browsing %zu images in '%s' (thumbnail cache: '%s')",
+                        m_thumbnails->size(), directory.c_str(), m_thumbnails->cache_directory().c_str());
+
+        if (auto window = m_params.dockingParams.dockableWindowOfName("Thumbnails"))
+            window->isVisible = true;
+    }
+    catch (const std::exception &e)
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Could not browse '%s':\n\t%s.", directory.c_str(), e.what());
+    }
+}
+#endif
+
+const char *SampleViewer::aa_label(Antialiasing aa, int samples)
+{
+    switch (aa)
+    {
+    case Antialiasing::MSAA: return profiler::intern(fmt::format("Image layer (MSAA {}x)", samples));
+    case Antialiasing::Supersample: return profiler::intern("Image layer (supersampling 2x2)");
+    default: return profiler::intern("Image layer");
+    }
+}
+
+RenderPass *SampleViewer::layer_render_pass()
+{
+    if (m_aa == Antialiasing::None)
+    {
+        delete m_aa_pass;
+        delete m_aa_target;
+        m_aa_pass   = nullptr;
+        m_aa_target = nullptr;
+        return m_layer_pass;
+    }
+
+    int  max_samples = Texture::max_samples(m_layer->pixel_format(), m_layer->component_format());
+    int  samples     = m_aa == Antialiasing::MSAA ? std::min(m_aa_samples, max_samples) : 1;
+    int2 size        = m_aa == Antialiasing::Supersample ? m_layer->size() * 2 : m_layer->size();
+    if (!m_aa_target || m_aa_target->samples() != samples)
+    {
+        delete m_aa_pass;
+        delete m_aa_target;
+        // the target is only ever resolved, never sampled, so a (multisampled) renderbuffer suffices
+        m_aa_target = new Texture(m_layer->pixel_format(), m_layer->component_format(), size,
+                                  Texture::InterpolationMode::Bilinear, Texture::InterpolationMode::Bilinear,
+                                  Texture::WrapMode::ClampToEdge, (uint8_t)samples, Texture::TextureFlags::RenderTarget);
+        m_aa_target->set_name(aa_label(m_aa, samples));
+        m_aa_pass   = new RenderPass(vector<Texture *>{m_aa_target});
+        m_aa_pass->set_cull_mode(RenderPass::CullMode::Disabled);
+    }
+    m_aa_pass->resize(size);
+    m_aa_pass->set_clear_color(m_bg_color);
+    return m_aa_pass;
+}
+
 void SampleViewer::draw_background()
 {
+    PROFILE_SCOPE("draw_background");
     auto &io = ImGui::GetIO();
 
     try
     {
+        m_shader_queue.poll();
+
         //
         // calculate the viewport sizes
         // fbsize is the size of the window in pixels while accounting for dpi factor on retina screens.
@@ -251,6 +538,49 @@ void SampleViewer::draw_background()
 
         m_render_pass->resize(fbsize);
 
+#if defined(HELLOIMGUI_HAS_OPENGL)
+        // HelloImGui resets the viewport to the whole framebuffer before calling us each frame
+        gl_state::assume_viewport(int4{0, 0, fbsize.x, fbsize.y});
+#endif
+
+        auto shader = m_shader_queue.select(m_shader);
+        if (m_layer_pass && shader)
+        {
+            if (fbsize.x <= 0 || fbsize.y <= 0)
+                return;
+
+            // Only re-render the image layer when something that affects it has changed, and otherwise just blit the
+            // cached copy. Together with HelloImGui's FPS idling, a static view then costs next to nothing.
+            const Texture *image = m_image ? m_image : m_null_image;
+
+            // re-uploading the image keeps its texture, so the shader's revision does not see it
+            bool damaged = shader != m_layer_shader || shader->revision() != m_layer_revision ||
+                           image->revision() != m_layer_image_revision || m_layer->size() != fbsize ||
+                           m_layer_pass->clear_color() != m_bg_color;
+            if (damaged)
+            {
+                m_layer_pass->resize(fbsize);
+                m_layer_pass->set_clear_color(m_bg_color);
+
+                auto             pass = layer_render_pass();
+                gpu_timer::Scope timer(aa_label(m_aa, m_aa_samples));
+                pass->begin();
+                shader->begin();
+                shader->draw_array(Shader::PrimitiveType::Triangle, 0, 6, false);
+                shader->end();
+                pass->end();
+                if (pass != m_layer_pass)
+                    pass->resolve(m_layer);
+
+                m_layer_shader   = shader;
+                m_layer_revision       = shader->revision();
+                m_layer_image_revision = image->revision();
+            }
+
+            m_layer_pass->blit_to({0, 0}, fbsize, m_render_pass, {0, 0});
+            return;
+        }
+
         // m_render_pass->set_viewport((viewport_offset)*fbscale, (viewport_size)*fbscale);
         m_render_pass->set_viewport({0, 0}, fbsize);
         // m_render_pass->set_clear_color(float4{fmod(frame++ / 100.f, 1.f), 0.2, 0.1, 1.0});
@@ -261,25 +591,33 @@ void SampleViewer::draw_background()
         // m_shader->begin();
         // m_shader->draw_array(Shader::PrimitiveType::TriangleStrip, 0, 4, false);
         // m_shader->end();
-        m_shader->begin();
-        m_shader->draw_array(Shader::PrimitiveType::Triangle, 0, 6, false);
-        m_shader->end();
+        if (shader)
+        {
+            shader->begin();
+            shader->draw_array(Shader::PrimitiveType::Triangle, 0, 6, false);
+            shader->end();
+        }
 
         m_render_pass->end();
     }
     catch (const std::exception &e)
     {
         fmt::print(stderr, "Drawing failed:\n\t{}.", e.what());
+        profiler::message(fmt::format("Drawing failed: {}", e.what()));
         HelloImGui::Log(HelloImGui::LogLevel::Error, "Drawing failed:\n\t%s.", e.what());
     }
 }
 
 int main(int argc, char **argv)
 {
+    startup::phase("Parse the command line");
+
     vector<string> args;
     bool           help                 = false;
     bool           error                = false;
     bool           launched_from_finder = false;
+    float          hitch_threshold      = 0.f;
+    bool           startup_report       = false;
 
     try
     {
@@ -289,6 +627,74 @@ int main(int argc, char **argv)
                 help = true;
             else if (strncmp("-psn", argv[i], 4) == 0)
                 launched_from_finder = true;
+#if defined(HELLOIMGUI_HAS_OPENGL)
+            else if (strcmp("--check-gl-state", argv[i]) == 0)
+                gl_state::set_validation(true);
+            else if (strcmp("--gl-errors", argv[i]) == 0)
+            {
+                if (++i >= argc)
+                    throw std::runtime_error("--gl-errors requires an argument");
+                if (strcmp("off", argv[i]) == 0)
+                    set_gl_error_check(GLErrorCheck::Off);
+                else if (strcmp("frame", argv[i]) == 0)
+                    set_gl_error_check(GLErrorCheck::PerFrame);
+                else if (strcmp("debug", argv[i]) == 0)
+                    set_gl_error_check(GLErrorCheck::DebugOutput);
+                else if (strcmp("call", argv[i]) == 0)
+                    set_gl_error_check(GLErrorCheck::PerCall);
+                else
+                    throw std::runtime_error(fmt::format("invalid --gl-errors mode \"{}\"", argv[i]));
+            }
+#endif
+            else if (strcmp("--no-gpu-timers", argv[i]) == 0)
+                gpu_timer::set_enabled(false);
+#ifndef __EMSCRIPTEN__
+            else if (strcmp("--record-trace", argv[i]) == 0)
+            {
+                if (++i >= argc)
+                    throw std::runtime_error("--record-trace requires a number of seconds");
+                double seconds = std::strtod(argv[i], nullptr);
+                if (seconds <= 0.0)
+                    throw std::runtime_error(fmt::format("invalid --record-trace duration \"{}\"", argv[i]));
+                trace::start(trace::default_filename(), seconds);
+            }
+            else if (strcmp("--capture", argv[i]) == 0)
+            {
+                if (++i >= argc)
+                    throw std::runtime_error("--capture requires a file name");
+                capture::start(argv[i]);
+            }
+#endif
+            else if (strcmp("--track-allocations", argv[i]) == 0)
+                alloc_tracker::set_enabled(true);
+            else if (strcmp("--allocation-budget", argv[i]) == 0)
+            {
+                if (++i >= argc)
+                    throw std::runtime_error("--allocation-budget requires a number of allocations");
+                char *end    = nullptr;
+                long  budget = std::strtol(argv[i], &end, 10);
+                if (end == argv[i] || *end || budget < 0)
+                    throw std::runtime_error(fmt::format("invalid --allocation-budget \"{}\"", argv[i]));
+                alloc_tracker::set_budget((size_t)budget);
+                alloc_tracker::set_enabled(true);
+            }
+            else if (strcmp("--hitch-threshold", argv[i]) == 0)
+            {
+                if (++i >= argc)
+                    throw std::runtime_error("--hitch-threshold requires a number of milliseconds");
+                hitch_threshold = std::strtof(argv[i], nullptr);
+                if (!(hitch_threshold >= HitchDetector::min_threshold))
+                    throw std::runtime_error(fmt::format("invalid --hitch-threshold \"{}\" (must be at least {} ms)",
+                                                         argv[i], HitchDetector::min_threshold));
+            }
+            else if (strcmp("--startup-report", argv[i]) == 0)
+                startup_report = true;
+            else if (strcmp("--shader-dir", argv[i]) == 0)
+            {
+                if (++i >= argc)
+                    throw std::runtime_error("--shader-dir requires a directory argument");
+                Shader::set_asset_override_directory(argv[i]);
+            }
             else
             {
                 if (strncmp(argv[i], "-", 1) == 0)
@@ -313,13 +719,36 @@ int main(int argc, char **argv)
         fmt::print(error ? stderr : stdout, R"(Syntax: {} [options]
 Options:
    -h, --help                Display this message
+   --check-gl-state          Cross-check our cached OpenGL state against the driver and report any drift
+   --gl-errors MODE          How to detect OpenGL errors: "off", "frame" (poll once per frame; the default
+                             in release builds), "debug" (KHR_debug callback; the default in debug builds),
+                             or "call" (after every call; slow, debug builds only)
+   --no-gpu-timers           Disable the GPU timer queries around render passes, draws and texture transfers
+   --record-trace SECONDS    Record the first SECONDS of profiling data into a Chrome trace-event JSON file
+                             (viewable in Perfetto or chrome://tracing) in the current directory
+   --capture FILE            Record the calls made to the renderer (textures, render passes and shaders)
+                             with their data into FILE, to replay them with HelloGuiExperiments_bench --replay
+   --track-allocations       Count the heap allocations made in each frame and profiler zone (see the
+                             Performance window)
+   --allocation-budget N     Flag frames with more than N heap allocations (0 by default); implies
+                             --track-allocations
+   --hitch-threshold MS      Log frames that take longer than MS milliseconds (50 by default, at least 16)
+                             as hitches
+   --startup-report          Print how long each phase of startup took as JSON, and exit once the first
+                             frame has been presented
+   --shader-dir DIR          Load shaders from DIR (mirroring the assets directory) instead of the
+                             copies embedded in the executable, e.g. to iterate on them without rebuilding
 )",
                    argv[0]);
         return error ? EXIT_FAILURE : EXIT_SUCCESS;
     }
     try
     {
+        startup::phase("Create the app");
         SampleViewer viewer;
+        if (hitch_threshold > 0.f)
+            viewer.set_hitch_threshold(hitch_threshold);
+        viewer.set_startup_report(startup_report);
         viewer.run();
     }
     catch (const std::runtime_error &e)
@@ -0,0 +1,471 @@
+/** \file bench.cpp
+    \brief A windowless benchmark of the hot paths of the viewer.
+
+    Measures shader source assembly, the texture format helpers, image decoding (the way \ref Texture and the
+    \ref ThumbnailBrowser decode) and the pixel conversion kernels, none of which need a window or a GPU context. With
+    --gpu, the renderer itself is benchmarked too, in an OpenGL context without a window (see bench_gpu.cpp), and with
+    --replay, captures of the viewer's rendering are replayed and timed instead (see bench_replay.cpp). Results
+    are printed as a table and can be written as JSON, and compared against a previous JSON report to catch
+    regressions.
+*/
+
+#include "bench.h"
+#include "common.h"
+#include "profiler.h"
+#include "shader.h"
+#include "texture.h"
+#include "thumbnail_browser.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+
+using namespace bench;
+using std::string;
+using std::vector;
+
+/// An image encoded in memory, to benchmark decoding without measuring the disk
+struct EncodedImage
+{
+    string          name;
+    vector<uint8_t> data;
+};
+
+/// Generate a deterministic RGBA8 test image: gradients plus noise, so that it compresses like a photograph
+static vector<uint8_t> make_test_image(const int2 &size)
+{
+    vector<uint8_t> pixels((size_t)size.x * size.y * 4);
+    uint32_t        state = 12345;
+    for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+        {
+            state          = state * 1664525u + 1013904223u;
+            int      noise = int(state >> 27); // 0..31
+            uint8_t *p     = &pixels[((size_t)y * size.x + x) * 4];
+            p[0]           = uint8_t(x * 223 / size.x + noise);
+            p[1]           = uint8_t(y * 223 / size.y + noise);
+            p[2]           = uint8_t((x + y) * 223 / (size.x + size.y) + noise);
+            p[3]           = 255;
+        }
+    return pixels;
+}
+
+static void append_to_vector(void *context, void *data, int size)
+{
+    auto *out = (vector<uint8_t> *)context;
+    out->insert(out->end(), (const uint8_t *)data, (const uint8_t *)data + size);
+}
+
+static vector<EncodedImage> encode_test_images(const vector<uint8_t> &pixels, const vector<float> &hdr_pixels,
+                                               const int2 &size)
+{
+    vector<EncodedImage> images{{"png", {}}, {"jpg", {}}, {"hdr", {}}};
+    if (!stbi_write_png_to_func(append_to_vector, &images[0].data, size.x, size.y, 4, pixels.data(), size.x * 4) ||
+        !stbi_write_jpg_to_func(append_to_vector, &images[1].data, size.x, size.y, 4, pixels.data(), 90) ||
+        !stbi_write_hdr_to_func(append_to_vector, &images[2].data, size.x, size.y, 4, hdr_pixels.data()))
+        throw std::runtime_error("encode_test_images(): could not encode the test image!");
+    return images;
+}
+
+static EncodedImage read_image(const string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("read_image(): cannot read \"{}\"!", filename));
+
+    EncodedImage image{std::filesystem::path(filename).filename().string(), {}};
+    image.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return image;
+}
+
+/// Read the time per iteration of each benchmark from a report written by write_report(). The names are returned as
+/// they appear in the file, i.e. still escaped.
+static vector<std::pair<string, double>> read_baseline(const string &filename)
+{
+    std::ifstream file(filename);
+    if (!file)
+        throw std::runtime_error(fmt::format("read_baseline(): cannot read \"{}\"!", filename));
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    string text = buffer.str();
+
+    // not a general JSON parser: it relies on each benchmark listing its "name" before its "ns_per_iter"
+    vector<std::pair<string, double>> result;
+    const string name_key = "\"name\": \"", time_key = "\"ns_per_iter\": ";
+    for (size_t pos = text.find(name_key); pos != string::npos; pos = text.find(name_key, pos))
+    {
+        size_t begin = pos + name_key.size();
+        size_t end   = begin;
+        while (end < text.size() && text[end] != '"')
+            end += text[end] == '\\' ? 2 : 1; // skip escaped characters, including quotes
+        end = end < text.size() ? end : string::npos;
+        size_t time  = end == string::npos ? string::npos : text.find(time_key, end);
+        if (time == string::npos)
+            break;
+        double ns = std::strtod(text.c_str() + time + time_key.size(), nullptr);
+        result.emplace_back(text.substr(begin, end - begin), ns);
+        pos = time;
+    }
+    if (result.empty())
+        throw std::runtime_error(fmt::format("read_baseline(): no benchmarks found in \"{}\"!", filename));
+    return result;
+}
+
+static double mb_per_s(const Result &r)
+{
+    return r.bytes ? r.bytes / r.ns_per_iter * 1e9 / (1024.0 * 1024.0) : 0.0;
+}
+
+static double change(const Result &r)
+{
+    return r.baseline_ns > 0.0 ? 100.0 * (r.ns_per_iter - r.baseline_ns) / r.baseline_ns : 0.0;
+}
+
+static void write_report(const string &filename, const Options &opt, const vector<Result> &results,
+                         const string &renderer, int regressions)
+{
+    std::ofstream out(filename);
+    if (!out)
+        throw std::runtime_error(fmt::format("write_report(): cannot write to \"{}\"!", filename));
+
+    // the version and renderer identify the data points when tracking results over time
+    out << fmt::format("{{\n  \"version\": {},\n  \"git_hash\": {},\n  \"renderer\": {},\n"
+                       "  \"min_time_s\": {},\n  \"tolerance_pct\": {},\n  \"benchmarks\": [",
+                       trace::json_string(git_describe()), trace::json_string(git_hash()),
+                       trace::json_string(renderer), opt.min_time, opt.tolerance);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &r = results[i];
+        out << fmt::format("{}\n    {{\"name\": {}, \"iterations\": {}, \"ns_per_iter\": {:.3f}, "
+                           "\"mb_per_s\": {:.3f}",
+                           i ? "," : "", trace::json_string(r.name), r.iterations, r.ns_per_iter, mb_per_s(r));
+        if (r.baseline_ns > 0.0)
+            out << fmt::format(", \"baseline_ns_per_iter\": {:.3f}, \"change_pct\": {:.2f}", r.baseline_ns, change(r));
+        out << "}";
+    }
+    out << fmt::format("\n  ],\n  \"regressions\": {}\n}}\n", regressions);
+
+    if (!out)
+        throw std::runtime_error(fmt::format("write_report(): error writing \"{}\"!", filename));
+}
+
+static vector<Result> run_all(const Options &opt)
+{
+    vector<Result> results;
+
+    // shader source assembly, as done when the viewer creates its shaders
+    {
+        string source = Shader::from_asset("shaders/image-shader_frag");
+        run(opt, results, "Shader::from_asset", source.size(),
+            [] { sink = sink + Shader::from_asset("shaders/image-shader_frag").size(); });
+
+        string assembled = Shader::prepend_includes(source, {"shaders/colorspaces", "shaders/colormaps"});
+        run(opt, results, "Shader::prepend_includes", assembled.size(),
+            [&source]
+            {
+                string result = Shader::prepend_includes(source, {"shaders/colorspaces", "shaders/colormaps"});
+                sink          = sink + result.size();
+            });
+    }
+
+    // texture format helpers, over all combinations of pixel and component formats
+    {
+        using PixelFormat     = Texture::PixelFormat;
+        using ComponentFormat = Texture::ComponentFormat;
+
+        const PixelFormat     pixel_formats[] = {PixelFormat::R,    PixelFormat::RA,   PixelFormat::RGB,
+                                                 PixelFormat::RGBA, PixelFormat::BGR,  PixelFormat::BGRA,
+                                                 PixelFormat::Depth, PixelFormat::DepthStencil};
+        const ComponentFormat component_formats[] = {ComponentFormat::UInt8,   ComponentFormat::Int8,
+                                                     ComponentFormat::UInt16,  ComponentFormat::Int16,
+                                                     ComponentFormat::UInt32,  ComponentFormat::Int32,
+                                                     ComponentFormat::Float16, ComponentFormat::Float32};
+
+        run(opt, results, "Texture::bytes_per_pixel+channels (64 formats)", 0,
+            [&]
+            {
+                size_t sum = 0;
+                for (auto p : pixel_formats)
+                    for (auto c : component_formats)
+                        sum += Texture::bytes_per_pixel(p, c) + Texture::channels(p);
+                sink = sink + sum;
+            });
+
+#if defined(HELLOIMGUI_HAS_OPENGL)
+        // only the combinations OpenGL supports; the others throw, which is not what we want to measure
+        vector<std::pair<PixelFormat, ComponentFormat>> supported;
+        for (auto p : pixel_formats)
+            for (auto c : component_formats)
+            {
+                try
+                {
+                    PixelFormat     pf = p;
+                    ComponentFormat cf = c;
+                    uint32_t        pixel_gl, component_gl, internal_gl;
+                    Texture::gl_map_format(pf, cf, pixel_gl, component_gl, internal_gl);
+                    supported.emplace_back(p, c);
+                }
+                catch (const std::exception &)
+                {
+                }
+            }
+
+        run(opt, results, fmt::format("Texture::gl_map_format ({} formats)", supported.size()), 0,
+            [&supported]
+            {
+                uint32_t sum = 0;
+                for (auto [p, c] : supported)
+                {
+                    uint32_t pixel_gl, component_gl, internal_gl;
+                    Texture::gl_map_format(p, c, pixel_gl, component_gl, internal_gl);
+                    sum += pixel_gl + component_gl + internal_gl;
+                }
+                sink = sink + sum;
+            });
+#endif
+    }
+
+    // decoding, from memory so that the disk is not measured
+    const int2      size{1024, 768};
+    vector<uint8_t> pixels = make_test_image(size);
+    vector<float>   hdr_pixels(pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+        hdr_pixels[i] = pixels[i] * (4.f / 255.f); // exceed 1 to exercise the clipping in the HDR kernels
+
+    vector<EncodedImage> images = encode_test_images(pixels, hdr_pixels, size);
+    for (auto &filename : opt.images)
+        images.push_back(read_image(filename));
+
+    // through the same decoder as Texture (which loads everything as linear floats) and the thumbnail browser
+    for (auto &image : images)
+    {
+        std::string_view data((const char *)image.data.data(), image.data.size());
+
+        int2 image_size;
+        Texture::decode_float(image.name, data, image_size); // throws if the image can't be decoded
+        size_t num_pixels = (size_t)image_size.x * image_size.y;
+
+        run(opt, results, fmt::format("decode {} as float (Texture)", image.name), num_pixels * 4 * sizeof(float),
+            [&]
+            {
+                auto result = Texture::decode_float(image.name, data, image_size);
+                sink        = sink + (result != nullptr);
+            });
+
+        // the thumbnail browser decodes LDR images as 8 bit
+        if (!Texture::is_hdr(data))
+            run(opt, results, fmt::format("decode {} as 8 bit (ThumbnailBrowser)", image.name), num_pixels * 4,
+                [&]
+                {
+                    auto result = Texture::decode_uint8(image.name, data, image_size);
+                    sink        = sink + (result != nullptr);
+                });
+    }
+
+    // pixel conversion: turning read-back render targets upright, box-filtering and encoding to sRGB8
+    {
+        vector<uint8_t> copy = pixels;
+        run(opt, results, "Texture::flip_rows", copy.size(),
+            [&]
+            {
+                Texture::flip_rows(copy.data(), size, 4);
+                sink = sink + copy[0];
+            });
+
+        vector<uint8_t> thumbnail;
+        int2            thumb_size;
+        run(opt, results, "ThumbnailBrowser::make_thumbnail 8 bit", pixels.size(),
+            [&]
+            {
+                ThumbnailBrowser::make_thumbnail(pixels.data(), size, thumbnail, thumb_size);
+                sink = sink + thumbnail[0];
+            });
+        run(opt, results, "ThumbnailBrowser::make_thumbnail float", hdr_pixels.size() * sizeof(float),
+            [&]
+            {
+                ThumbnailBrowser::make_thumbnail(hdr_pixels.data(), size, thumbnail, thumb_size);
+                sink = sink + thumbnail[0];
+            });
+    }
+
+    return results;
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    bool    help  = false;
+    bool    error = false;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            // options that take a value
+            auto value = [&](const char *what) -> const char *
+            {
+                if (++i >= argc)
+                    throw std::runtime_error(fmt::format("{} requires {}", argv[i - 1], what));
+                return argv[i];
+            };
+
+            if (strcmp("--help", argv[i]) == 0 || strcmp("-h", argv[i]) == 0)
+                help = true;
+            else if (strcmp("--output", argv[i]) == 0 || strcmp("-o", argv[i]) == 0)
+                opt.output = value("a file name");
+            else if (strcmp("--baseline", argv[i]) == 0)
+                opt.baseline = value("a file name");
+            else if (strcmp("--tolerance", argv[i]) == 0)
+            {
+                opt.tolerance = std::strtod(value("a percentage"), nullptr);
+                if (opt.tolerance <= 0.0)
+                    throw std::runtime_error(fmt::format("invalid --tolerance \"{}\"", argv[i]));
+            }
+            else if (strcmp("--min-time", argv[i]) == 0)
+            {
+                opt.min_time = std::strtod(value("a number of seconds"), nullptr);
+                if (opt.min_time <= 0.0)
+                    throw std::runtime_error(fmt::format("invalid --min-time \"{}\"", argv[i]));
+            }
+            else if (strcmp("--filter", argv[i]) == 0)
+                opt.filter = value("a string");
+            else if (strcmp("--image", argv[i]) == 0)
+                opt.images.push_back(value("a file name"));
+            else if (strcmp("--gpu", argv[i]) == 0)
+            {
+#if defined(BENCH_HAS_EGL)
+                opt.gpu = true;
+#else
+                throw std::runtime_error("--gpu requires a build with EGL");
+#endif
+            }
+            else if (strcmp("--replay", argv[i]) == 0)
+            {
+#if defined(BENCH_HAS_EGL)
+                opt.replays.push_back(value("a file name"));
+#else
+                throw std::runtime_error("--replay requires a build with EGL");
+#endif
+            }
+            else if (strcmp("--draws", argv[i]) == 0)
+            {
+                opt.draws = std::atoi(value("a number"));
+                if (opt.draws <= 0)
+                    throw std::runtime_error(fmt::format("invalid --draws \"{}\"", argv[i]));
+            }
+            else
+            {
+                fmt::print(stderr, "Invalid argument: \"{}\"!\n", argv[i]);
+                help  = true;
+                error = true;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print(stderr, "Error: {}\n", e.what());
+        help  = true;
+        error = true;
+    }
+    if (help)
+    {
+        fmt::print(error ? stderr : stdout, R"(Syntax: {} [options]
+Benchmarks the hot paths of HelloGuiExperiments, without opening a window.
+Options:
+   -h, --help                Display this message
+   -o, --output FILE         Write the results to FILE as JSON
+   --baseline FILE           Compare against the results in FILE (written with --output), and exit with
+                             an error if any benchmark got slower by more than the tolerance
+   --tolerance PCT           Slowdown in percent that counts as a regression (10 by default)
+   --min-time SECONDS        Time spent measuring each benchmark (0.5 by default)
+   --filter TEXT             Only run the benchmarks whose name contains TEXT
+   --image FILE              Also benchmark decoding FILE (may be repeated)
+   --gpu                     Also benchmark rendering, texture uploads and readbacks in an OpenGL context
+                             without a window (using EGL, so this works with Mesa's llvmpipe on machines
+                             without a GPU)
+   --draws N                 Number of draw calls in the draw call overhead benchmark (1000 by default)
+   --replay FILE             Instead of the other benchmarks, replay the capture FILE (recorded with
+                             HelloGuiExperiments --capture) in an OpenGL context without a window, and time
+                             it as a whole and per frame (may be repeated). Compare reports of two builds
+                             with --baseline to bisect a regression.
+)",
+                   argv[0]);
+        return error ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    try
+    {
+        // measure the work itself, not the instrumentation (nothing collects the zones here anyway)
+        profiler::set_enabled(false);
+
+        vector<Result> results;
+        string         renderer = "none";
+#if defined(BENCH_HAS_EGL)
+        if (!opt.replays.empty())
+        {
+            renderer = run_replays(opt, results);
+            fmt::print("Renderer: {}\n", renderer);
+        }
+        else
+#endif
+        {
+            results = run_all(opt);
+#if defined(BENCH_HAS_EGL)
+            if (opt.gpu)
+            {
+                renderer = run_gpu(opt, results);
+                fmt::print("Renderer: {}\n", renderer);
+            }
+#endif
+        }
+
+        if (!opt.baseline.empty())
+            for (auto &[name, ns] : read_baseline(opt.baseline))
+                for (auto &r : results)
+                    if (trace::json_string(r.name) == '"' + name + '"')
+                        r.baseline_ns = ns;
+
+        int regressions = 0;
+        fmt::print("{:<48} {:>12} {:>14} {:>10} {:>9}\n", "Benchmark", "Iterations", "Time/iter", "MB/s", "Change");
+        for (auto &r : results)
+        {
+            bool regressed = r.baseline_ns > 0.0 && change(r) > opt.tolerance;
+            regressions += regressed;
+            fmt::print("{:<48} {:>12} {:>11.1f} ns {:>10} {:>9}{}\n", r.name, r.iterations, r.ns_per_iter,
+                       r.bytes ? fmt::format("{:.1f}", mb_per_s(r)) : string("-"),
+                       r.baseline_ns > 0.0 ? fmt::format("{:+.1f}%", change(r)) : string("-"),
+                       regressed ? "  REGRESSION" : "");
+        }
+
+        if (!opt.output.empty())
+            write_report(opt.output, opt, results, renderer, regressions);
+
+        if (regressions)
+        {
+            fmt::print(stderr, "{} benchmark{} regressed by more than {}%\n", regressions, regressions == 1 ? "" : "s",
+                       opt.tolerance);
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print(stderr, "Caught a fatal error: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+#if defined(BENCH_HAS_EGL)
+
+#include "bench.h"
+#include "gpu_timer.h"
+#include "headless_context.h"
+#include "renderpass.h"
+#include "shader.h"
+#include "texture.h"
+
+#include <fmt/core.h>
+#include <memory>
+
+using std::string;
+using std::vector;
+
+struct Format
+{
+    const char              *name;
+    Texture::PixelFormat     pixel_format;
+    Texture::ComponentFormat component_format;
+    uint32_t                 half_value; ///< the bit pattern of a pixel component of 0.5 in this format
+};
+
+static const Format formats[] = {
+    {"RGBA8", Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8, 0x80},
+    {"RGBA16F", Texture::PixelFormat::RGBA, Texture::ComponentFormat::Float16, 0x3800},
+    {"RGBA32F", Texture::PixelFormat::RGBA, Texture::ComponentFormat::Float32, 0x3f000000}};
+
+static const int2 sizes[] = {{512, 512}, {1920, 1080}, {3840, 2160}};
+
+/// Return mid-gray pixels of the given format and size (the values hardly matter, but NaNs could be slow paths)
+static vector<uint8_t> make_pixels(const Format &format, const int2 &size)
+{
+    size_t          component_bytes = Texture::bytes_per_pixel(format.pixel_format, format.component_format) / 4;
+    vector<uint8_t> pixels((size_t)size.x * size.y * 4 * component_bytes);
+    for (size_t i = 0; i < pixels.size(); i += component_bytes)
+        for (size_t b = 0; b < component_bytes; ++b)
+            pixels[i + b] = uint8_t(format.half_value >> (8 * b)); // little endian
+    return pixels;
+}
+
+static Texture *make_texture(const Format &format, const int2 &size, uint8_t flags)
+{
+    return new Texture(format.pixel_format, format.component_format, size, Texture::InterpolationMode::Nearest,
+                       Texture::InterpolationMode::Nearest, Texture::WrapMode::ClampToEdge, 1, flags, true);
+}
+
+/// Draw a full-screen quad with \p shader into \p pass, \p count times
+static void draw(RenderPass &pass, Shader &shader, int count = 1)
+{
+    pass.begin();
+    shader.begin();
+    for (int i = 0; i < count; ++i)
+        shader.draw_array(Shader::PrimitiveType::Triangle, 0, 6);
+    shader.end();
+    pass.end();
+}
+
+namespace bench
+{
+
+string run_gpu(const Options &opt, vector<Result> &results)
+{
+    HeadlessContext context;
+    string          renderer =
+        fmt::format("{}, {}", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+
+    // every benchmark waits for the GPU to finish, so timer queries would only add overhead
+    gpu_timer::set_enabled(false);
+
+    // texture uploads, each finished before the next so that the driver cannot just queue them
+    for (auto &size : sizes)
+        for (auto &format : formats)
+        {
+            std::unique_ptr<Texture> texture(make_texture(format, size, Texture::TextureFlags::ShaderRead));
+            vector<uint8_t>          pixels = make_pixels(format, size);
+            run(opt, results, fmt::format("upload {}x{} {}", size.x, size.y, format.name), pixels.size(),
+                [&]
+                {
+                    texture->upload(pixels.data());
+                    glFinish();
+                });
+        }
+
+    // the image shader, drawing a texture of each format over a render target of the same size
+    std::unique_ptr<Texture> target(
+        make_texture(formats[0], sizes[0], Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget));
+    RenderPass pass(vector<Texture *>{target.get()});
+    pass.set_cull_mode(RenderPass::CullMode::Disabled);
+
+    Shader shader(&pass, "Image shader", Shader::from_asset("shaders/image-shader_vert"),
+                  Shader::prepend_includes(Shader::from_asset("shaders/image-shader_frag"),
+                                           {"shaders/colorspaces", "shaders/colormaps"}),
+                  Shader::BlendMode::AlphaBlend);
+    const float positions[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, -1.f, 1.f, 1.f, -1.f, 1.f};
+    shader.set_buffer_usage("position", Shader::BufferUsage::Static);
+    shader.set_buffer("position", VariableType::Float32, {6, 2}, positions);
+
+    for (auto &size : sizes)
+    {
+        pass.resize(size);
+        for (auto &format : formats)
+        {
+            std::unique_ptr<Texture> image(make_texture(format, size, Texture::TextureFlags::ShaderRead));
+            image->upload(make_pixels(format, size).data());
+            shader.set_texture("image", image.get());
+            run(opt, results, fmt::format("draw {}x{} {} image", size.x, size.y, format.name),
+                size.x * size.y * image->bytes_per_pixel(),
+                [&]
+                {
+                    draw(pass, shader);
+                    glFinish();
+                });
+        }
+
+        // reading back what was drawn (including turning the rows upright)
+        vector<uint8_t> pixels(target->bytes());
+        run(opt, results, fmt::format("download {}x{} {}", size.x, size.y, formats[0].name), pixels.size(),
+            [&]
+            {
+                target->download(pixels.data());
+                sink = sink + pixels[0];
+            });
+    }
+
+    // readbacks of the floating-point formats, which the driver may have to convert
+    for (auto &format : formats)
+    {
+        if (format.component_format == Texture::ComponentFormat::UInt8)
+            continue;
+        std::unique_ptr<Texture> texture(
+            make_texture(format, sizes[1], Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget));
+        texture->upload(make_pixels(format, sizes[1]).data());
+        vector<uint8_t> pixels(texture->bytes());
+        run(opt, results, fmt::format("download {}x{} {}", sizes[1].x, sizes[1].y, format.name), pixels.size(),
+            [&]
+            {
+                texture->download(pixels.data());
+                sink = sink + pixels[0];
+            });
+    }
+
+    // the CPU and driver overhead per draw call, drawing into a tiny target so that the pixels cost next to nothing
+    {
+        pass.resize(int2{16});
+        std::unique_ptr<Texture> image(make_texture(formats[0], int2{16}, Texture::TextureFlags::ShaderRead));
+        image->upload(make_pixels(formats[0], int2{16}).data());
+        shader.set_texture("image", image.get());
+        run(opt, results, fmt::format("{} draw calls", opt.draws), 0,
+            [&]
+            {
+                draw(pass, shader, opt.draws);
+                glFinish();
+            });
+    }
+
+    return renderer;
+}
+
+} // namespace bench
+
+#endif // defined(BENCH_HAS_EGL)
@@ -0,0 +1,495 @@
+#if defined(BENCH_HAS_EGL)
+
+#include "bench.h"
+#include "capture.h"
+#include "draw_list.h"
+#include "gpu_timer.h"
+#include "headless_context.h"
+#include "renderpass.h"
+#include "shader.h"
+#include "texture.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fmt/core.h>
+#include <memory>
+#include <unordered_map>
+
+using capture::Op;
+using std::string;
+using std::vector;
+
+/// The size of the offscreen targets that stand in for the default framebuffer, until the capture resizes them
+static const int2 default_framebuffer_size{1280, 720};
+
+/**
+    Re-executes the records of a capture (see \ref capture), mapping the ids of the captured objects to objects of its
+    own.
+
+    Render passes into the default framebuffer are replayed into offscreen targets instead, since the headless context
+    has no window. Calls that fail (e.g. because the capture is of a session whose shaders need a newer OpenGL, or
+    because an object was created before the capture started) are skipped and counted.
+*/
+class Replayer
+{
+public:
+    ~Replayer()
+    {
+        release();
+    }
+
+    /// Replay the records up to the end of the next frame (or of the capture). Returns false once the capture is done.
+    bool replay_frame(capture::Reader &in)
+    {
+        while (!in.done())
+        {
+            Op op = in.op();
+            if (op == Op::Frame)
+                return true;
+            replay(in, op);
+        }
+        return false;
+    }
+
+    /// Destroy the objects that are still alive, the way the captured session would have at shutdown
+    void release()
+    {
+        m_shaders.clear();
+        m_passes.clear();
+        m_textures.clear();
+        m_substitutes.clear();
+        m_draw_lists.clear();
+    }
+
+    /// The number of calls that were skipped since they failed
+    size_t skipped() const
+    {
+        return m_skipped;
+    }
+
+    /// The error of the first call that was skipped
+    const string &first_error() const
+    {
+        return m_first_error;
+    }
+
+protected:
+    template <typename T>
+    static T *find(const std::unordered_map<uint32_t, std::unique_ptr<T>> &objects, uint32_t id)
+    {
+        auto it = objects.find(id);
+        return it == objects.end() ? nullptr : it->second.get();
+    }
+
+    /// Run \p f, which makes the call of a record whose arguments have all been read, on \p object (nullptr if the
+    /// capture did not create it). Counts the call as skipped if it fails.
+    template <typename F>
+    void attempt(const void *object, F &&f)
+    {
+        try
+        {
+            if (!object)
+                throw std::runtime_error("the object was not created within the capture");
+            f();
+        }
+        catch (const std::exception &e)
+        {
+            if (m_skipped++ == 0)
+                m_first_error = e.what();
+        }
+    }
+
+    Texture *texture(capture::Reader &in)
+    {
+        return find(m_textures, in.object());
+    }
+
+    RenderPass *pass(capture::Reader &in)
+    {
+        return find(m_passes, in.object());
+    }
+
+    void replay(capture::Reader &in, Op op)
+    {
+        uint32_t id = in.object();
+        switch (op)
+        {
+        case Op::CreateTexture:
+        {
+            auto type             = in.get<Texture::TextureType>();
+            auto pixel_format     = in.get<Texture::PixelFormat>();
+            auto component_format = in.get<Texture::ComponentFormat>();
+            auto size             = in.vec<int, 2>();
+            auto depth            = in.get<int>();
+            auto min              = in.get<Texture::InterpolationMode>();
+            auto mag              = in.get<Texture::InterpolationMode>();
+            auto wrap             = in.get<Texture::WrapMode>();
+            auto samples          = in.get<uint8_t>();
+            auto flags            = in.get<uint8_t>();
+            auto manual           = in.get<bool>();
+            attempt(this,
+                    [&]
+                    {
+                        if (type == Texture::TextureType::Texture2D)
+                            m_textures[id] = std::make_unique<Texture>(pixel_format, component_format, size, min, mag,
+                                                                       wrap, samples, flags, manual);
+                        else
+                            m_textures[id] = std::make_unique<Texture>(type, pixel_format, component_format,
+                                                                       int3{size.x, size.y, depth}, min, mag, wrap,
+                                                                       manual);
+                    });
+            break;
+        }
+        case Op::DestroyTexture: m_textures.erase(id); break;
+        case Op::TextureUpload:
+        {
+            auto pixels = in.blob();
+            auto t      = find(m_textures, id);
+            attempt(t, [&] { t->upload((const uint8_t *)pixels.data()); });
+            break;
+        }
+        case Op::TextureUploadSubRegion:
+        {
+            auto pixels = in.blob();
+            auto origin = in.vec<int, 2>();
+            auto size   = in.vec<int, 2>();
+            auto t      = find(m_textures, id);
+            attempt(t, [&] { t->upload_sub_region((const uint8_t *)pixels.data(), origin, size); });
+            break;
+        }
+        case Op::TextureUploadSubVolume:
+        {
+            auto pixels = in.blob();
+            auto origin = in.vec<int, 3>();
+            auto size   = in.vec<int, 3>();
+            auto t      = find(m_textures, id);
+            attempt(t, [&] { t->upload_sub_region((const uint8_t *)pixels.data(), origin, size); });
+            break;
+        }
+        case Op::TextureDownload:
+        {
+            auto t = find(m_textures, id);
+            attempt(t,
+                    [&]
+                    {
+                        m_scratch.resize(t->bytes());
+                        t->download(m_scratch.data());
+                    });
+            break;
+        }
+        case Op::TextureResize:
+        {
+            auto size = in.vec<int, 2>();
+            auto t    = find(m_textures, id);
+            attempt(t, [&] { t->resize(size); });
+            break;
+        }
+        case Op::TextureGenerateMipmap:
+        {
+            auto t = find(m_textures, id);
+            attempt(t, [&] { t->generate_mipmap(); });
+            break;
+        }
+        case Op::CreateRenderPass:
+        {
+            vector<Texture *> color_targets(in.varint());
+            for (auto &target : color_targets)
+                target = texture(in);
+            auto depth_target = texture(in);
+            auto clear        = in.get<bool>();
+            auto write_depth  = in.get<bool>();
+            attempt(this,
+                    [&]
+                    {
+                        if (std::count(color_targets.begin(), color_targets.end(), nullptr))
+                            throw std::runtime_error("a target was not created within the capture");
+                        if (color_targets.empty() && !depth_target)
+                            color_targets = substitute_default_framebuffer(write_depth, depth_target);
+                        m_passes[id] = std::make_unique<RenderPass>(color_targets, depth_target, clear);
+                    });
+            break;
+        }
+        case Op::DestroyRenderPass: m_passes.erase(id); break;
+        case Op::RenderPassBegin:
+        {
+            auto p = find(m_passes, id);
+            attempt(p, [&] { p->begin(); });
+            break;
+        }
+        case Op::RenderPassEnd:
+        {
+            auto p = find(m_passes, id);
+            attempt(p, [&] { p->end(); });
+            break;
+        }
+        case Op::RenderPassClearColor:
+        {
+            auto color = in.vec<float, 4>();
+            auto p     = find(m_passes, id);
+            attempt(p, [&] { p->set_clear_color(color); });
+            break;
+        }
+        case Op::RenderPassClearDepth:
+        {
+            auto depth = in.get<float>();
+            auto p     = find(m_passes, id);
+            attempt(p, [&] { p->set_clear_depth(depth); });
+            break;
+        }
+        case Op::RenderPassDepthTest:
+        {
+            auto depth_test  = in.get<RenderPass::DepthTest>();
+            auto depth_write = in.get<bool>();
+            auto p           = find(m_passes, id);
+            attempt(p, [&] { p->set_depth_test(depth_test, depth_write); });
+            break;
+        }
+        case Op::RenderPassViewport:
+        {
+            auto offset = in.vec<int, 2>();
+            auto size   = in.vec<int, 2>();
+            auto p      = find(m_passes, id);
+            attempt(p, [&] { p->set_viewport(offset, size); });
+            break;
+        }
+        case Op::RenderPassCullMode:
+        {
+            auto cull_mode = in.get<RenderPass::CullMode>();
+            auto p         = find(m_passes, id);
+            attempt(p, [&] { p->set_cull_mode(cull_mode); });
+            break;
+        }
+        case Op::RenderPassResize:
+        {
+            auto size = in.vec<int, 2>();
+            auto p    = find(m_passes, id);
+            attempt(p, [&] { p->resize(size); });
+            break;
+        }
+        case Op::RenderPassBlitTo:
+        {
+            auto src_offset = in.vec<int, 2>();
+            auto src_size   = in.vec<int, 2>();
+            auto dst        = pass(in);
+            auto dst_offset = in.vec<int, 2>();
+            auto p          = find(m_passes, id);
+            attempt(p, [&] { p->blit_to(src_offset, src_size, dst, dst_offset); });
+            break;
+        }
+        case Op::RenderPassResolve:
+        {
+            auto target = texture(in);
+            auto index  = in.get<size_t>();
+            auto p      = find(m_passes, id);
+            attempt(p, [&] { p->resolve(target, index); });
+            break;
+        }
+        case Op::CreateShader:
+        {
+            auto render_pass = pass(in);
+            auto name        = in.string();
+            auto vs          = in.blob();
+            auto fs          = in.blob();
+            auto blend_mode  = in.get<Shader::BlendMode>();
+            attempt(this,
+                    [&]
+                    {
+                        m_shaders[id] = std::make_unique<Shader>(render_pass, string(name), string(vs), string(fs),
+                                                                 blend_mode);
+                    });
+            break;
+        }
+        case Op::DestroyShader: m_shaders.erase(id); break;
+        case Op::ShaderSetBuffer:
+        {
+            auto   name  = string(in.string());
+            auto   dtype = in.get<VariableType>();
+            size_t ndim  = in.varint();
+            if (ndim > 3)
+                throw std::runtime_error("Replayer::replay(): invalid buffer shape!");
+            size_t shape[3] = {1, 1, 1};
+            for (size_t i = 0; i < ndim; ++i)
+                shape[i] = in.varint();
+            auto data = in.blob();
+            auto s    = find(m_shaders, id);
+            attempt(s, [&] { s->set_buffer(name, dtype, ndim, shape, data.data()); });
+            break;
+        }
+        case Op::ShaderBufferDivisor:
+        {
+            auto name    = string(in.string());
+            auto divisor = in.get<size_t>();
+            auto s       = find(m_shaders, id);
+            attempt(s, [&] { s->set_buffer_divisor(name, divisor); });
+            break;
+        }
+        case Op::ShaderBufferOffset:
+        {
+            auto name   = string(in.string());
+            auto offset = in.get<size_t>();
+            auto s      = find(m_shaders, id);
+            attempt(s, [&] { s->set_buffer_pointer_offset(name, offset); });
+            break;
+        }
+        case Op::ShaderBufferUsage:
+        {
+            auto name  = string(in.string());
+            auto usage = in.get<Shader::BufferUsage>();
+            auto s     = find(m_shaders, id);
+            attempt(s, [&] { s->set_buffer_usage(name, usage); });
+            break;
+        }
+        case Op::ShaderSetTexture:
+        {
+            auto name = string(in.string());
+            auto t    = texture(in);
+            auto s    = find(m_shaders, id);
+            attempt(s, [&] { s->set_texture(name, t); });
+            break;
+        }
+        case Op::ShaderBegin:
+        {
+            auto s = find(m_shaders, id);
+            attempt(s, [&] { s->begin(); });
+            break;
+        }
+        case Op::ShaderEnd:
+        {
+            auto s = find(m_shaders, id);
+            attempt(s, [&] { s->end(); });
+            break;
+        }
+        case Op::ShaderDrawArray:
+        {
+            auto primitive_type = in.get<Shader::PrimitiveType>();
+            auto offset         = in.get<size_t>();
+            auto count          = in.get<size_t>();
+            auto indexed        = in.get<bool>();
+            auto instances      = in.get<size_t>();
+            auto s              = find(m_shaders, id);
+            attempt(s, [&] { s->draw_array(primitive_type, offset, count, indexed, instances); });
+            break;
+        }
+        case Op::ShaderDrawList:
+        {
+            auto primitive_type = in.get<Shader::PrimitiveType>();
+            auto indexed        = in.get<bool>();
+            auto &list          = draw_list(primitive_type, indexed);
+            list.clear();
+            for (uint64_t i = 0, n = in.varint(); i < n; ++i)
+            {
+                auto offset        = in.get<uint32_t>();
+                auto count         = in.get<uint32_t>();
+                auto instances     = in.get<uint32_t>();
+                auto base_instance = in.get<uint32_t>();
+                list.add(offset, count, instances, base_instance);
+            }
+            auto s = find(m_shaders, id);
+            attempt(s, [&] { s->draw(list); });
+            break;
+        }
+        default: throw std::runtime_error(fmt::format("Replayer::replay(): unexpected record type {}!", (int)op));
+        }
+    }
+
+    /// Create the offscreen targets for a pass into the default framebuffer, and return its color targets
+    vector<Texture *> substitute_default_framebuffer(bool write_depth, Texture *&depth_target)
+    {
+        auto make = [&](Texture::PixelFormat pixel_format, Texture::ComponentFormat component_format)
+        {
+            m_substitutes.emplace_back(new Texture(pixel_format, component_format, default_framebuffer_size,
+                                                   Texture::InterpolationMode::Nearest,
+                                                   Texture::InterpolationMode::Nearest, Texture::WrapMode::ClampToEdge,
+                                                   1, Texture::TextureFlags::RenderTarget));
+            return m_substitutes.back().get();
+        };
+        if (write_depth)
+            depth_target = make(Texture::PixelFormat::Depth, Texture::ComponentFormat::Float32);
+        return {make(Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8)};
+    }
+
+    /// Return a draw list (reused across records, since it holds GPU buffers) for the given kind of draws
+    DrawList &draw_list(Shader::PrimitiveType primitive_type, bool indexed)
+    {
+        auto &list = m_draw_lists[int(primitive_type) * 2 + indexed];
+        if (!list)
+            list = std::make_unique<DrawList>(primitive_type, indexed);
+        return *list;
+    }
+
+    std::unordered_map<uint32_t, std::unique_ptr<Texture>>    m_textures;
+    std::unordered_map<uint32_t, std::unique_ptr<RenderPass>> m_passes;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>>     m_shaders;
+    vector<std::unique_ptr<Texture>>                          m_substitutes; ///< targets of default framebuffer passes
+    std::unordered_map<int, std::unique_ptr<DrawList>>        m_draw_lists;
+    vector<uint8_t>                                           m_scratch; ///< destination of texture downloads
+    size_t                                                    m_skipped = 0;
+    string                                                    m_first_error;
+};
+
+namespace bench
+{
+
+string run_replays(const Options &opt, vector<Result> &results)
+{
+    HeadlessContext context;
+    string          renderer =
+        fmt::format("{}, {}", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+
+    // the replays wait for the GPU to finish, so timer queries would only add overhead
+    gpu_timer::set_enabled(false);
+
+    for (auto &filename : opt.replays)
+    {
+        string name = "replay " + std::filesystem::path(filename).filename().string();
+        if (!opt.filter.empty() && name.find(opt.filter) == string::npos)
+            continue;
+
+        capture::Reader in(filename);
+
+        // first, frame by frame, waiting for the GPU at the end of each frame to time it on its own
+        vector<double> frame_ns;
+        size_t         skipped = 0;
+        {
+            Replayer replayer;
+            bool     more = true;
+            while (more)
+            {
+                Timer timer;
+                more = replayer.replay_frame(in);
+                glFinish();
+                frame_ns.push_back((double)timer.elapsed_ns());
+            }
+            replayer.release();
+            skipped = replayer.skipped();
+            if (skipped)
+                fmt::print(stderr, "{}: skipped {} calls that failed, the first with: {}\n", filename, skipped,
+                           replayer.first_error());
+        }
+
+        // then the whole capture, repeatedly, as a single benchmark
+        run(opt, results, name, in.size(),
+            [&]
+            {
+                Replayer replayer;
+                in.rewind();
+                while (replayer.replay_frame(in))
+                    continue;
+                replayer.release();
+                glFinish();
+            });
+
+        std::sort(frame_ns.begin(), frame_ns.end());
+        size_t frames = frame_ns.size();
+        results.push_back({name + " frame median", (int64_t)frames, frame_ns[frames / 2]});
+        results.push_back({name + " frame p95", (int64_t)frames, frame_ns[std::min(frames - 1, frames * 95 / 100)]});
+        fmt::print("{}: {} frames, {:.1f} MB, {} calls skipped\n", filename, frames, in.size() / (1024.0 * 1024.0),
+                   skipped);
+    }
+
+    return renderer;
+}
+
+} // namespace bench
+
+#endif // defined(BENCH_HAS_EGL)
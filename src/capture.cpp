@@ -0,0 +1,364 @@
+#include "capture.h"
+#include "draw_list.h"
+
+#include <atomic>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+using namespace capture;
+
+static const char     magic[4] = {'H', 'G', 'C', 'P'};
+static const uint64_t version  = 1;
+
+/// Payloads smaller than this are stored inline, since a blob reference would save next to nothing
+static constexpr size_t min_blob_size = 64;
+
+/// The file and the tables of a capture in progress
+struct Writer
+{
+    std::ofstream                              file;
+    std::vector<uint8_t>                       record; ///< the record being written, see begin_record()
+    std::unordered_map<const void *, uint32_t> ids;    ///< ids of the live objects
+    std::unordered_map<uint64_t, uint64_t>     blobs;  ///< blob ids by hash of their contents (and size)
+    uint32_t                                   next_id = 1;
+    uint64_t                                   bytes   = 0;
+};
+
+static std::mutex              s_mutex;
+static std::unique_ptr<Writer> s_writer;
+static std::atomic<bool>       s_recording{false};
+
+static thread_local int t_depth = 0;
+
+static void append_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        out.push_back(byte | (value ? 0x80 : 0));
+    } while (value);
+}
+
+static void write(Writer &w, const void *data, size_t size)
+{
+    w.file.write((const char *)data, (std::streamsize)size);
+    w.bytes += size;
+}
+
+/// A 64-bit hash of \p size bytes, to find payloads that were seen before (a collision would replay the wrong
+/// contents, but is vanishingly unlikely together with equal sizes)
+static uint64_t hash(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t       h     = 0x9e3779b97f4a7c15ull ^ size;
+    size_t         i     = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    for (; i < size; ++i)
+        h = (h ^ bytes[i]) * 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+static bool is_create(Op op)
+{
+    return op == Op::CreateTexture || op == Op::CreateRenderPass || op == Op::CreateShader;
+}
+
+static bool is_destroy(Op op)
+{
+    return op == Op::DestroyTexture || op == Op::DestroyRenderPass || op == Op::DestroyShader;
+}
+
+namespace capture
+{
+
+void start(const std::string &filename)
+{
+    auto writer = std::make_unique<Writer>();
+    writer->file.open(filename, std::ios::binary);
+    if (!writer->file)
+        throw std::runtime_error(fmt::format("capture::start(): cannot create \"{}\"!", filename));
+
+    std::vector<uint8_t> header(magic, magic + sizeof(magic));
+    append_varint(header, version);
+    write(*writer, header.data(), header.size());
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_writer = std::move(writer);
+    s_recording.store(true, std::memory_order_relaxed);
+}
+
+void stop()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_recording.store(false, std::memory_order_relaxed);
+    s_writer.reset();
+}
+
+bool recording()
+{
+    return s_recording.load(std::memory_order_relaxed);
+}
+
+uint64_t bytes_written()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_writer ? s_writer->bytes : 0;
+}
+
+void new_frame()
+{
+    if (!recording())
+        return;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_writer)
+        return;
+    uint8_t op = (uint8_t)Op::Frame;
+    write(*s_writer, &op, 1);
+}
+
+bool enter()
+{
+    return t_depth++ == 0;
+}
+
+void leave()
+{
+    --t_depth;
+}
+
+bool begin_record(Op op, const void *object)
+{
+    s_mutex.lock();
+    if (!s_writer)
+    {
+        s_mutex.unlock();
+        return false;
+    }
+
+    Writer  &w = *s_writer;
+    uint32_t id;
+    if (is_create(op))
+        w.ids[object] = id = w.next_id++;
+    else if (auto it = w.ids.find(object); it != w.ids.end())
+        id = it->second;
+    else
+    {
+        // created before the capture started, or by a constructor that isn't recorded
+        s_mutex.unlock();
+        return false;
+    }
+
+    w.record.clear();
+    w.record.push_back((uint8_t)op);
+    append_varint(w.record, id);
+    return true;
+}
+
+void end_record(Op op, const void *object)
+{
+    Writer &w = *s_writer;
+    write(w, w.record.data(), w.record.size());
+    if (is_destroy(op))
+        w.ids.erase(object);
+    s_mutex.unlock();
+}
+
+void put_varint(uint64_t value)
+{
+    append_varint(s_writer->record, value);
+}
+
+void put_bytes(const void *data, size_t size)
+{
+    auto &record = s_writer->record;
+    record.insert(record.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+}
+
+void put_blob(const void *data, size_t size)
+{
+    // 0: null, 1: inline (size, bytes), 2: reference to a blob record (id)
+    Writer &w = *s_writer;
+    if (!data)
+    {
+        put_varint(0);
+        return;
+    }
+    if (size < min_blob_size)
+    {
+        put_varint(1);
+        put_varint(size);
+        put_bytes(data, size);
+        return;
+    }
+
+    // blob records go straight to the file, ahead of the record that refers to them
+    auto [it, inserted] = w.blobs.try_emplace(hash(data, size), w.blobs.size() + 1);
+    if (inserted)
+    {
+        std::vector<uint8_t> header{(uint8_t)Op::Blob};
+        append_varint(header, it->second);
+        append_varint(header, size);
+        write(w, header.data(), header.size());
+        write(w, data, size);
+    }
+    put_varint(2);
+    put_varint(it->second);
+}
+
+void put_object(const void *object)
+{
+    auto &ids = s_writer->ids;
+    auto  it  = object ? ids.find(object) : ids.end();
+    put_varint(it == ids.end() ? 0 : it->second);
+}
+
+void put(const std::vector<Texture *> &targets)
+{
+    put_varint(targets.size());
+    for (auto target : targets)
+        put_object(target);
+}
+
+void put(const DrawList &list)
+{
+    put_varint(list.commands().size());
+    for (auto &cmd : list.commands())
+    {
+        put_varint(cmd.offset);
+        put_varint(cmd.count);
+        put_varint(cmd.instances);
+        put_varint(cmd.base_instance);
+    }
+}
+
+Reader::Reader(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("capture::Reader::Reader(): cannot open \"{}\"!", filename));
+    m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (m_data.size() < sizeof(magic) || memcmp(m_data.data(), magic, sizeof(magic)) != 0)
+        throw std::runtime_error(fmt::format("capture::Reader::Reader(): \"{}\" is not a capture!", filename));
+    m_pos = sizeof(magic);
+    if (uint64_t v = varint(); v != version)
+        throw std::runtime_error(
+            fmt::format("capture::Reader::Reader(): \"{}\" has unsupported version {}!", filename, v));
+    m_start = m_pos;
+}
+
+void Reader::rewind()
+{
+    m_pos = m_start;
+}
+
+void Reader::need(size_t bytes)
+{
+    if (m_data.size() - m_pos < bytes)
+        throw std::runtime_error("capture::Reader: unexpected end of the capture!");
+}
+
+uint8_t Reader::byte()
+{
+    need(1);
+    return (uint8_t)m_data[m_pos++];
+}
+
+void Reader::read_blobs()
+{
+    while (m_pos < m_data.size() && (Op)m_data[m_pos] == Op::Blob)
+    {
+        ++m_pos;
+        uint64_t id   = varint();
+        uint64_t size = varint();
+        need(size);
+        m_blobs[id] = std::string_view(m_data.data() + m_pos, size);
+        m_pos += size;
+    }
+}
+
+bool Reader::done()
+{
+    // a capture may end with blob records that nothing referred to
+    read_blobs();
+    return m_pos >= m_data.size();
+}
+
+Op Reader::op()
+{
+    read_blobs();
+    Op op = (Op)byte();
+    if (op >= Op::Count)
+        throw std::runtime_error(fmt::format("capture::Reader: invalid record type {}!", (int)op));
+    return op;
+}
+
+uint64_t Reader::varint()
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t b = byte();
+        value |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return value;
+    }
+    throw std::runtime_error("capture::Reader: invalid varint!");
+}
+
+int64_t Reader::svarint()
+{
+    uint64_t v = varint();
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+float Reader::f32()
+{
+    need(sizeof(float));
+    float value;
+    memcpy(&value, m_data.data() + m_pos, sizeof(float));
+    m_pos += sizeof(float);
+    return value;
+}
+
+uint32_t Reader::object()
+{
+    return (uint32_t)varint();
+}
+
+std::string_view Reader::string()
+{
+    uint64_t size = varint();
+    need(size);
+    std::string_view result(m_data.data() + m_pos, size);
+    m_pos += size;
+    return result;
+}
+
+std::string_view Reader::blob()
+{
+    switch (varint())
+    {
+    case 0: return {};
+    case 1: return string();
+    case 2:
+        if (auto it = m_blobs.find(varint()); it != m_blobs.end())
+            return it->second;
+        throw std::runtime_error("capture::Reader: reference to an unknown blob!");
+    default: throw std::runtime_error("capture::Reader: invalid payload!");
+    }
+}
+
+} // namespace capture
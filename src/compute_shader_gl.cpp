@@ -0,0 +1,180 @@
+#if defined(HELLOIMGUI_HAS_OPENGL)
+
+#include "compute_shader.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+#include "opengl_check.h"
+#include "profiler.h"
+#include "texture.h"
+
+#include <stdexcept>
+
+// compute shaders are only available on desktop OpenGL (4.3 or ARB_compute_shader)
+#if defined(HELLOIMGUI_USE_GLAD) && defined(GL_COMPUTE_SHADER)
+#define HAS_COMPUTE_SHADERS 1
+#endif
+
+bool ComputeShader::supported()
+{
+#if defined(HAS_COMPUTE_SHADERS)
+    static const bool supported = gl_version_at_least(4, 3) || gl_extension_supported("GL_ARB_compute_shader");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+ComputeShader::ComputeShader(const std::string &name, const std::string &cs_source) :
+    ComputeShader(name, cs_source, Async{})
+{
+    finalize();
+}
+
+ComputeShader::ComputeShader(const std::string &name, const std::string &cs_source, Async) : Shader(name)
+{
+    if (!supported())
+        throw std::runtime_error("ComputeShader::ComputeShader(name=\"" + name +
+                                 "\"): compute shaders require OpenGL 4.3!");
+
+#if defined(HAS_COMPUTE_SHADERS)
+    m_gpu_label = profiler::intern("ComputeShader \"" + name + "\"");
+
+    // like Shader, submit the source but leave checking the result to finalize()
+    const GLchar *files[] = {"#version 430 core\n", cs_source.c_str()};
+    CHK(m_compute_shader_handle = glCreateShader(GL_COMPUTE_SHADER));
+    CHK(glShaderSource(m_compute_shader_handle, 2, files, nullptr));
+    CHK(glCompileShader(m_compute_shader_handle));
+
+    m_shader_handle = glCreateProgram();
+    CHK(glAttachShader(m_shader_handle, m_compute_shader_handle));
+    CHK(glLinkProgram(m_shader_handle));
+    PROFILE_COUNT("Shader compiles", 1);
+#else
+    (void)cs_source;
+#endif
+}
+
+void ComputeShader::set_image(const std::string &name, Texture *texture)
+{
+    auto it = m_buffers.find(name);
+    if (it == m_buffers.end())
+        throw std::runtime_error("ComputeShader::set_image(): could not find argument named \"" + name + "\"");
+    Buffer &buf = it->second;
+    if (buf.type != ImageTexture)
+        throw std::runtime_error("ComputeShader::set_image(): argument named \"" + name + "\" is not an image!");
+    if (!texture->texture_handle() || texture->samples() > 1)
+        throw std::runtime_error("ComputeShader::set_image(): \"" + name +
+                                 "\" requires a single-sample texture with the ShaderRead flag!");
+    if (texture->target() != buf.texture_target)
+        throw std::runtime_error("ComputeShader::set_image(): texture type does not match the image type of \"" +
+                                 name + "\"!");
+
+    void *handle = (void *)((uintptr_t)texture->texture_handle());
+    if (handle != buf.buffer || texture->internal_format() != buf.image_format)
+        ++m_revision;
+
+    bool was_bound   = buf.buffer != nullptr;
+    buf.buffer       = handle;
+    buf.image_format = texture->internal_format();
+    // as for textures, the image unit only needs to be assigned the first time
+    if (!was_bound)
+        mark_dirty(buf);
+}
+
+void ComputeShader::download_buffer(const std::string &name, void *data, size_t size, size_t offset)
+{
+    auto it = m_buffers.find(name);
+    if (it == m_buffers.end())
+        throw std::runtime_error("ComputeShader::download_buffer(): could not find argument named \"" + name + "\"");
+    const Buffer &buf = it->second;
+    if (buf.type != StorageBuffer)
+        throw std::runtime_error("ComputeShader::download_buffer(): argument named \"" + name +
+                                 "\" is not a storage buffer!");
+    if (!buf.buffer || offset + size > buf.size)
+        throw std::runtime_error("ComputeShader::download_buffer(): out of bounds!");
+
+#if defined(HAS_COMPUTE_SHADERS)
+    CHK(glBindBuffer(GL_SHADER_STORAGE_BUFFER, (GLuint)((uintptr_t)buf.buffer)));
+    CHK(glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, buf.ring_offset + offset, size, data));
+#else
+    (void)data;
+#endif
+}
+
+int3 ComputeShader::local_size() const
+{
+    if (!m_ready)
+        throw std::runtime_error("ComputeShader::local_size(): shader \"" + m_name + "\" is not ready!");
+
+#if defined(HAS_COMPUTE_SHADERS)
+    if (m_local_size == int3{0})
+    {
+        GLint size[3] = {1, 1, 1};
+        CHK(glGetProgramiv(m_shader_handle, GL_COMPUTE_WORK_GROUP_SIZE, size));
+        m_local_size = int3{size[0], size[1], size[2]};
+    }
+#endif
+    return m_local_size;
+}
+
+void ComputeShader::dispatch(const int3 &groups)
+{
+    if (!m_ready)
+        throw std::runtime_error("ComputeShader::dispatch(): shader \"" + m_name + "\" is not ready!");
+
+#if defined(HAS_COMPUTE_SHADERS)
+    gpu_timer::Scope timer(m_gpu_label);
+
+    gl_state::use_program(m_shader_handle);
+    bind_arguments();
+    CHK(glDispatchCompute((GLuint)groups.x, (GLuint)groups.y, (GLuint)groups.z));
+#else
+    (void)groups;
+#endif
+}
+
+void ComputeShader::dispatch_threads(const int3 &threads)
+{
+    int3 size = local_size();
+    dispatch(int3{(threads.x + size.x - 1) / size.x, (threads.y + size.y - 1) / size.y,
+                  (threads.z + size.z - 1) / size.z});
+}
+
+void ComputeShader::memory_barrier(uint32_t barriers)
+{
+#if defined(HAS_COMPUTE_SHADERS)
+    GLbitfield bits = 0;
+    if (barriers & ImageAccess)
+        bits |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    if (barriers & TextureFetch)
+        bits |= GL_TEXTURE_FETCH_BARRIER_BIT;
+    if (barriers & StorageAccess)
+        bits |= GL_SHADER_STORAGE_BARRIER_BIT;
+    if (barriers & VertexInput)
+        bits |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT;
+    if (barriers & BufferTransfer)
+        bits |= GL_BUFFER_UPDATE_BARRIER_BIT;
+    if (barriers & TextureTransfer)
+        bits |= GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT;
+    if (barriers & FramebufferAccess)
+        bits |= GL_FRAMEBUFFER_BARRIER_BIT;
+
+    if (bits)
+        CHK(glMemoryBarrier(bits));
+#else
+    (void)barriers;
+#endif
+}
+
+#else
+
+#include "compute_shader.h"
+
+// there is no Metal implementation: only this is defined, so that using anything else fails to link
+bool ComputeShader::supported()
+{
+    return false;
+}
+
+#endif // defined(HELLOIMGUI_HAS_OPENGL)
@@ -0,0 +1,56 @@
+#include "draw_list.h"
+
+#if defined(HELLOIMGUI_HAS_OPENGL)
+#include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+#include "opengl_check.h"
+#endif
+
+DrawList::DrawList(Shader::PrimitiveType primitive_type, bool indexed) :
+    m_primitive_type(primitive_type), m_indexed(indexed)
+{
+}
+
+DrawList::~DrawList()
+{
+#if defined(HELLOIMGUI_HAS_OPENGL)
+    if (m_indirect_buffer)
+        CHK(glDeleteBuffers(1, &m_indirect_buffer));
+#endif
+}
+
+void DrawList::clear()
+{
+    m_commands.clear();
+    m_draws = 0;
+#if defined(HELLOIMGUI_HAS_OPENGL)
+    m_indirect_dirty = true;
+#endif
+}
+
+void DrawList::add(size_t offset, size_t count, size_t instances, size_t base_instance)
+{
+    ++m_draws;
+    // an indirect command with 0 instances draws nothing, while draw_array() treats 0 as a plain draw
+    if (instances == 0)
+        instances = 1;
+#if defined(HELLOIMGUI_HAS_OPENGL)
+    m_indirect_dirty = true;
+#endif
+
+    // strips, loops and fans connect consecutive vertices, so only independent primitives can be concatenated
+    bool mergeable = m_primitive_type == Shader::PrimitiveType::Point ||
+                     m_primitive_type == Shader::PrimitiveType::Line ||
+                     m_primitive_type == Shader::PrimitiveType::Triangle;
+
+    if (mergeable && !m_commands.empty())
+    {
+        Command &last = m_commands.back();
+        if (last.offset + last.count == offset && last.instances == instances && last.base_instance == base_instance)
+        {
+            last.count += (uint32_t)count;
+            return;
+        }
+    }
+
+    m_commands.push_back({(uint32_t)offset, (uint32_t)count, (uint32_t)instances, (uint32_t)base_instance});
+}
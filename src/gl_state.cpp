@@ -0,0 +1,415 @@
+#if defined(HELLOIMGUI_HAS_OPENGL)
+
+#include "gl_state.h"
+#include "hello_imgui/hello_imgui.h"
+#include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+#include "opengl_check.h"
+
+#include <fmt/core.h>
+
+using namespace linalg::aliases;
+
+#if !defined(GL_TEXTURE_2D_MULTISAMPLE)
+#define GL_TEXTURE_2D_MULTISAMPLE 0x9100
+#endif
+#if !defined(GL_PROGRAM_POINT_SIZE)
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+static constexpr uint32_t unknown          = ~0u;
+static constexpr int      max_units        = 16;
+static constexpr int      num_targets      = 4;
+static constexpr GLenum   capabilities[]   = {GL_BLEND, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_CULL_FACE,
+                                              GL_PROGRAM_POINT_SIZE};
+static constexpr int      num_capabilities = sizeof(capabilities) / sizeof(capabilities[0]);
+
+static struct State
+{
+    uint32_t program;
+    uint32_t vertex_array;
+    uint32_t active_unit;
+    uint32_t textures[max_units][num_targets];
+    int8_t   enabled[num_capabilities]; // -1 = unknown
+    uint32_t blend_src, blend_dst;
+    int4     viewport, scissor;
+    bool     viewport_known, scissor_known;
+    int8_t   depth_mask; // -1 = unknown
+    uint32_t depth_func, cull_face;
+    uint32_t read_framebuffer, draw_framebuffer;
+
+    State()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        program = vertex_array = active_unit = unknown;
+        for (auto &unit : textures)
+            for (auto &texture : unit)
+                texture = unknown;
+        for (auto &e : enabled)
+            e = -1;
+        blend_src = blend_dst = unknown;
+        viewport_known = scissor_known = false;
+        depth_mask                     = -1;
+        depth_func = cull_face = unknown;
+        read_framebuffer = draw_framebuffer = unknown;
+    }
+} s_state;
+
+static bool s_validation = false;
+
+static int target_slot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_2D_MULTISAMPLE: return 1;
+    case GL_TEXTURE_2D_ARRAY: return 2;
+    case GL_TEXTURE_3D: return 3;
+    default: return -1;
+    }
+}
+
+static int capability_slot(GLenum capability)
+{
+    for (int i = 0; i < num_capabilities; ++i)
+        if (capabilities[i] == capability)
+            return i;
+    return -1;
+}
+
+namespace gl_state
+{
+
+void invalidate()
+{
+    s_state.reset();
+}
+
+void use_program(uint32_t program)
+{
+    if (s_state.program == program)
+        return;
+    CHK(glUseProgram(program));
+    s_state.program = program;
+}
+
+void bind_vertex_array(uint32_t vertex_array)
+{
+#if defined(HELLOIMGUI_USE_GLAD)
+    if (s_state.vertex_array == vertex_array)
+        return;
+    CHK(glBindVertexArray(vertex_array));
+    s_state.vertex_array = vertex_array;
+#else
+    (void)vertex_array;
+#endif
+}
+
+void active_texture(uint32_t unit)
+{
+    if (s_state.active_unit == unit)
+        return;
+    CHK(glActiveTexture(GL_TEXTURE0 + unit));
+    s_state.active_unit = unit;
+}
+
+void bind_texture_to_unit(uint32_t unit, uint32_t target, uint32_t texture)
+{
+    int slot = target_slot(target);
+    if (unit < max_units && slot >= 0 && s_state.textures[unit][slot] == texture)
+        return;
+
+    active_texture(unit);
+    CHK(glBindTexture(target, texture));
+    if (unit < max_units && slot >= 0)
+        s_state.textures[unit][slot] = texture;
+}
+
+void bind_texture(uint32_t target, uint32_t texture)
+{
+    if (s_state.active_unit == unknown)
+    {
+        // we don't know which unit is active, so we can neither skip the bind nor record it
+        CHK(glBindTexture(target, texture));
+        return;
+    }
+    bind_texture_to_unit(s_state.active_unit, target, texture);
+}
+
+void set_enabled(uint32_t capability, bool enabled)
+{
+    int slot = capability_slot(capability);
+    if (slot >= 0 && s_state.enabled[slot] == (int8_t)enabled)
+        return;
+
+    if (enabled)
+        CHK(glEnable(capability));
+    else
+        CHK(glDisable(capability));
+
+    if (slot >= 0)
+        s_state.enabled[slot] = (int8_t)enabled;
+}
+
+void blend_func(uint32_t src_factor, uint32_t dst_factor)
+{
+    if (s_state.blend_src == src_factor && s_state.blend_dst == dst_factor)
+        return;
+    CHK(glBlendFunc(src_factor, dst_factor));
+    s_state.blend_src = src_factor;
+    s_state.blend_dst = dst_factor;
+}
+
+void viewport(const int4 &rect)
+{
+    if (s_state.viewport_known && s_state.viewport == rect)
+        return;
+    CHK(glViewport(rect.x, rect.y, rect.z, rect.w));
+    assume_viewport(rect);
+}
+
+const int4 &viewport()
+{
+    if (!s_state.viewport_known)
+    {
+        CHK(glGetIntegerv(GL_VIEWPORT, &s_state.viewport[0]));
+        s_state.viewport_known = true;
+    }
+    return s_state.viewport;
+}
+
+void assume_viewport(const int4 &rect)
+{
+    s_state.viewport       = rect;
+    s_state.viewport_known = true;
+}
+
+void scissor(const int4 &rect)
+{
+    if (s_state.scissor_known && s_state.scissor == rect)
+        return;
+    CHK(glScissor(rect.x, rect.y, rect.z, rect.w));
+    s_state.scissor       = rect;
+    s_state.scissor_known = true;
+}
+
+const int4 &scissor()
+{
+    if (!s_state.scissor_known)
+    {
+        CHK(glGetIntegerv(GL_SCISSOR_BOX, &s_state.scissor[0]));
+        s_state.scissor_known = true;
+    }
+    return s_state.scissor;
+}
+
+void depth_mask(bool enabled)
+{
+    if (s_state.depth_mask == (int8_t)enabled)
+        return;
+    CHK(glDepthMask(enabled ? GL_TRUE : GL_FALSE));
+    s_state.depth_mask = (int8_t)enabled;
+}
+
+bool depth_mask()
+{
+    if (s_state.depth_mask < 0)
+    {
+        GLboolean mask;
+        CHK(glGetBooleanv(GL_DEPTH_WRITEMASK, &mask));
+        s_state.depth_mask = mask ? 1 : 0;
+    }
+    return s_state.depth_mask;
+}
+
+void depth_func(uint32_t func)
+{
+    if (s_state.depth_func == func)
+        return;
+    CHK(glDepthFunc(func));
+    s_state.depth_func = func;
+}
+
+void cull_face(uint32_t mode)
+{
+    if (s_state.cull_face == mode)
+        return;
+    CHK(glCullFace(mode));
+    s_state.cull_face = mode;
+}
+
+bool is_enabled(uint32_t capability)
+{
+    int slot = capability_slot(capability);
+    if (slot < 0)
+        return glIsEnabled(capability);
+    if (s_state.enabled[slot] < 0)
+        s_state.enabled[slot] = glIsEnabled(capability) ? 1 : 0;
+    return s_state.enabled[slot];
+}
+
+void bind_framebuffer(uint32_t target, uint32_t framebuffer)
+{
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if ((!read || s_state.read_framebuffer == framebuffer) && (!draw || s_state.draw_framebuffer == framebuffer))
+        return;
+
+    CHK(glBindFramebuffer(target, framebuffer));
+    if (read)
+        s_state.read_framebuffer = framebuffer;
+    if (draw)
+        s_state.draw_framebuffer = framebuffer;
+}
+
+uint32_t framebuffer(uint32_t target)
+{
+    bool      read  = target == GL_READ_FRAMEBUFFER;
+    uint32_t &cache = read ? s_state.read_framebuffer : s_state.draw_framebuffer;
+    if (cache == unknown)
+    {
+        GLint binding = 0;
+        CHK(glGetIntegerv(read ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &binding));
+        cache = (uint32_t)binding;
+    }
+    return cache;
+}
+
+void set_validation(bool enabled)
+{
+    s_validation = enabled;
+}
+
+bool validation()
+{
+    return s_validation;
+}
+
+bool validate(const char *where)
+{
+    if (!s_validation)
+        return false;
+
+    bool drift  = false;
+    auto report = [&drift, where](const char *what, const std::string &shadow, const std::string &actual)
+    {
+        fmt::print(stderr, "GL state drift detected in {}: {} is {}, but the shadow has {}.\n", where, what, actual,
+                   shadow);
+        HelloImGui::Log(HelloImGui::LogLevel::Warning, "GL state drift detected in %s: %s is %s, but the shadow has %s.",
+                        where, what, actual.c_str(), shadow.c_str());
+        drift = true;
+    };
+    auto check_int = [&report](const char *what, GLenum pname, uint32_t &shadow)
+    {
+        if (shadow == unknown)
+            return;
+        GLint actual = 0;
+        glGetIntegerv(pname, &actual);
+        if ((uint32_t)actual != shadow)
+        {
+            report(what, std::to_string(shadow), std::to_string(actual));
+            shadow = (uint32_t)actual;
+        }
+    };
+    auto check_rect = [&report](const char *what, GLenum pname, int4 &shadow, bool known)
+    {
+        if (!known)
+            return;
+        int4 actual;
+        glGetIntegerv(pname, &actual[0]);
+        if (actual != shadow)
+        {
+            auto str = [](const int4 &r) { return fmt::format("({}, {}, {}, {})", r.x, r.y, r.z, r.w); };
+            report(what, str(shadow), str(actual));
+            shadow = actual;
+        }
+    };
+
+    check_int("GL_CURRENT_PROGRAM", GL_CURRENT_PROGRAM, s_state.program);
+#if defined(HELLOIMGUI_USE_GLAD)
+    check_int("GL_VERTEX_ARRAY_BINDING", GL_VERTEX_ARRAY_BINDING, s_state.vertex_array);
+#endif
+    if (s_state.active_unit != unknown)
+    {
+        uint32_t active_texture = GL_TEXTURE0 + s_state.active_unit;
+        check_int("GL_ACTIVE_TEXTURE", GL_ACTIVE_TEXTURE, active_texture);
+        s_state.active_unit = active_texture - GL_TEXTURE0;
+    }
+    check_int("GL_BLEND_SRC_RGB", GL_BLEND_SRC_RGB, s_state.blend_src);
+    check_int("GL_BLEND_DST_RGB", GL_BLEND_DST_RGB, s_state.blend_dst);
+    check_int("GL_DEPTH_FUNC", GL_DEPTH_FUNC, s_state.depth_func);
+    check_int("GL_CULL_FACE_MODE", GL_CULL_FACE_MODE, s_state.cull_face);
+    check_int("GL_READ_FRAMEBUFFER_BINDING", GL_READ_FRAMEBUFFER_BINDING, s_state.read_framebuffer);
+    check_int("GL_DRAW_FRAMEBUFFER_BINDING", GL_DRAW_FRAMEBUFFER_BINDING, s_state.draw_framebuffer);
+    check_rect("GL_VIEWPORT", GL_VIEWPORT, s_state.viewport, s_state.viewport_known);
+    check_rect("GL_SCISSOR_BOX", GL_SCISSOR_BOX, s_state.scissor, s_state.scissor_known);
+
+    if (s_state.depth_mask >= 0)
+    {
+        GLboolean actual;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &actual);
+        if ((bool)actual != (bool)s_state.depth_mask)
+        {
+            report("GL_DEPTH_WRITEMASK", s_state.depth_mask ? "true" : "false", actual ? "true" : "false");
+            s_state.depth_mask = actual ? 1 : 0;
+        }
+    }
+
+    for (int i = 0; i < num_capabilities; ++i)
+    {
+        if (s_state.enabled[i] < 0)
+            continue;
+        bool actual = glIsEnabled(capabilities[i]);
+        if (actual != (bool)s_state.enabled[i])
+        {
+            report(fmt::format("glIsEnabled(0x{:04X})", capabilities[i]).c_str(),
+                   s_state.enabled[i] ? "true" : "false", actual ? "true" : "false");
+            s_state.enabled[i] = actual ? 1 : 0;
+        }
+    }
+
+    // the texture bindings of the active unit (checking the others would require switching units)
+    if (s_state.active_unit != unknown && s_state.active_unit < max_units)
+    {
+        uint32_t &texture_2d = s_state.textures[s_state.active_unit][target_slot(GL_TEXTURE_2D)];
+        check_int("GL_TEXTURE_BINDING_2D", GL_TEXTURE_BINDING_2D, texture_2d);
+    }
+
+    return drift;
+}
+
+void program_deleted(uint32_t program)
+{
+    // a deleted program stays in use until another one is bound, but its name may then be recycled
+    if (s_state.program == program)
+        s_state.program = unknown;
+}
+
+void vertex_array_deleted(uint32_t vertex_array)
+{
+    if (s_state.vertex_array == vertex_array)
+        s_state.vertex_array = 0;
+}
+
+void texture_deleted(uint32_t texture)
+{
+    for (auto &unit : s_state.textures)
+        for (auto &t : unit)
+            if (t == texture)
+                t = 0;
+}
+
+void framebuffer_deleted(uint32_t framebuffer)
+{
+    if (s_state.read_framebuffer == framebuffer)
+        s_state.read_framebuffer = 0;
+    if (s_state.draw_framebuffer == framebuffer)
+        s_state.draw_framebuffer = 0;
+}
+
+} // namespace gl_state
+
+#endif // defined(HELLOIMGUI_HAS_OPENGL)
@@ -0,0 +1,181 @@
+#if defined(HELLOIMGUI_HAS_OPENGL)
+
+#include "gpu_timer.h"
+#include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+#include "opengl_check.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+// timestamp queries are only available on desktop OpenGL (3.3 or ARB_timer_query)
+#if defined(HELLOIMGUI_USE_GLAD) && defined(GL_TIMESTAMP)
+#define HAS_TIMER_QUERIES 1
+#endif
+
+// how many frames the GPU may lag behind before we give up on a frame's results
+static constexpr int frames_in_flight = 4;
+
+struct TimedZone
+{
+    const char *label;
+    uint16_t    depth;
+    GLuint      begin_query, end_query;
+};
+
+struct QuerySlot
+{
+    uint64_t               frame         = 0;
+    int64_t                cpu_minus_gpu = 0; ///< offset mapping GPU timestamps onto profiler::now_ns()
+    std::vector<GLuint>    queries;           ///< query objects, reused every time the slot comes around
+    size_t                 used = 0;
+    std::vector<TimedZone> zones;
+};
+
+static QuerySlot s_slots[frames_in_flight];
+static int       s_current = 0;
+static uint16_t  s_depth   = 0;
+static bool      s_enabled = true;
+static uint64_t  s_dropped = 0;
+
+#if defined(HAS_TIMER_QUERIES)
+static int s_supported = -1; // -1 = not checked yet
+
+static GLuint next_query(QuerySlot &slot)
+{
+    if (slot.used == slot.queries.size())
+    {
+        size_t old_size = slot.queries.size();
+        size_t count    = std::max<size_t>(32, old_size);
+        slot.queries.resize(old_size + count);
+        CHK(glGenQueries((GLsizei)count, &slot.queries[old_size]));
+    }
+    return slot.queries[slot.used++];
+}
+#endif
+
+static void collect(QuerySlot &slot)
+{
+#if defined(HAS_TIMER_QUERIES)
+    if (slot.used == 0)
+        return;
+
+    // queries complete in order, so if the last one is available, all of them are
+    GLuint available = 0;
+    CHK(glGetQueryObjectuiv(slot.queries[slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available));
+    if (!available)
+    {
+        ++s_dropped;
+        return;
+    }
+
+    for (auto &z : slot.zones)
+    {
+        if (!z.end_query)
+            continue;
+
+        GLuint64 begin = 0, end = 0;
+        CHK(glGetQueryObjectui64v(z.begin_query, GL_QUERY_RESULT, &begin));
+        CHK(glGetQueryObjectui64v(z.end_query, GL_QUERY_RESULT, &end));
+        profiler::submit(slot.frame, {z.label, profiler::Source::GPU, z.depth, 0,
+                                      (int64_t)begin + slot.cpu_minus_gpu, (int64_t)(end - begin)});
+    }
+#else
+    (void)slot;
+#endif
+}
+
+namespace gpu_timer
+{
+
+bool supported()
+{
+#if defined(HAS_TIMER_QUERIES)
+    if (s_supported < 0)
+        s_supported = gl_version_at_least(3, 3) || gl_extension_supported("GL_ARB_timer_query");
+    return s_supported;
+#else
+    return false;
+#endif
+}
+
+void set_enabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+bool enabled()
+{
+    return s_enabled && supported();
+}
+
+void new_frame()
+{
+    s_current  = (s_current + 1) % frames_in_flight;
+    auto &slot = s_slots[s_current];
+
+    collect(slot);
+
+    slot.zones.clear();
+    slot.used  = 0;
+    slot.frame = profiler::frame_index();
+    s_depth    = 0;
+
+#if defined(HAS_TIMER_QUERIES)
+    if (enabled())
+    {
+        // unlike reading a query result, this doesn't wait for the GPU to catch up
+        GLint64 gpu_now = 0;
+        CHK(glGetInteger64v(GL_TIMESTAMP, &gpu_now));
+        slot.cpu_minus_gpu = profiler::now_ns() - gpu_now;
+    }
+#endif
+}
+
+uint64_t dropped_frames()
+{
+    return s_dropped;
+}
+
+int begin(const char *label)
+{
+#if defined(HAS_TIMER_QUERIES)
+    if (!enabled())
+        return -1;
+
+    auto  &slot  = s_slots[s_current];
+    GLuint query = next_query(slot);
+    CHK(glQueryCounter(query, GL_TIMESTAMP));
+    slot.zones.push_back({label, s_depth++, query, 0});
+    return (s_current << 24) | (int)(slot.zones.size() - 1);
+#else
+    (void)label;
+    return -1;
+#endif
+}
+
+void end(int zone)
+{
+#if defined(HAS_TIMER_QUERIES)
+    if (zone < 0)
+        return;
+
+    // if a new frame started in the meantime, the zone's slot may already have been recycled
+    auto &slot  = s_slots[zone >> 24];
+    int   index = zone & 0xffffff;
+    if (index >= (int)slot.zones.size())
+        return;
+
+    auto &z     = slot.zones[index];
+    z.end_query = next_query(slot);
+    CHK(glQueryCounter(z.end_query, GL_TIMESTAMP));
+    if (s_depth > 0)
+        --s_depth;
+#else
+    (void)zone;
+#endif
+}
+
+} // namespace gpu_timer
+
+#endif // defined(HELLOIMGUI_HAS_OPENGL)
@@ -0,0 +1,50 @@
+#if defined(HELLOIMGUI_HAS_METAL)
+
+#include "gpu_timer.h"
+
+// Metal has no equivalent of timestamp queries that can bracket arbitrary commands, so individual zones are not
+// timed. Instead, RenderPass::end() reports the GPU start and end times of each command buffer.
+
+static bool s_enabled = true;
+
+namespace gpu_timer
+{
+
+bool supported()
+{
+    return true;
+}
+
+void set_enabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+bool enabled()
+{
+    return s_enabled;
+}
+
+void new_frame()
+{
+}
+
+uint64_t dropped_frames()
+{
+    return 0;
+}
+
+int begin(const char *label)
+{
+    (void)label;
+    return -1;
+}
+
+void end(int zone)
+{
+    (void)zone;
+}
+
+} // namespace gpu_timer
+
+#endif // defined(HELLOIMGUI_HAS_METAL)
@@ -0,0 +1,163 @@
+#include "hitch_detector.h"
+
+#include "hello_imgui/hello_imgui.h"
+#include "imgui.h"
+#include "memory_tracker.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <fstream>
+#include <stdexcept>
+
+HitchDetector::HitchDetector() : m_origin_ns(profiler::now_ns())
+{
+}
+
+void HitchDetector::new_frame()
+{
+    uint64_t current = profiler::frame_index();
+    if (current <= profiler::complete_after)
+        return;
+
+    uint64_t last  = current - profiler::complete_after;
+    uint64_t first = std::max(m_last_checked + 1, last > profiler::history_size ? last - profiler::history_size : 1);
+    for (uint64_t i = first; i <= last; ++i)
+        if (auto f = profiler::frame(i); f && f->duration_ns > int64_t(m_threshold * 1e6f))
+            check(*f);
+    m_last_checked = last;
+}
+
+void HitchDetector::check(const profiler::Frame &frame)
+{
+    static const char *upload_label  = profiler::intern("Texture upload bytes");
+    static const char *compile_label = profiler::intern("Shader compiles");
+    static const char *read_label    = profiler::intern("File bytes read");
+    static const char *written_label = profiler::intern("File bytes written");
+
+    Hitch &h          = m_history[m_next];
+    h                 = Hitch{};
+    h.frame           = frame.index;
+    h.time            = (frame.start_ns - m_origin_ns) * 1e-9;
+    h.frame_ms        = frame.duration_ns * 1e-6f;
+    h.cpu_ms          = frame.cpu_ns * 1e-6f;
+    h.gpu_ms          = frame.gpu_ns * 1e-6f;
+    h.upload_bytes    = profiler::counter_total(frame, upload_label);
+    h.shader_compiles = profiler::counter_total(frame, compile_label);
+    h.read_bytes      = profiler::counter_total(frame, read_label);
+    h.written_bytes   = profiler::counter_total(frame, written_label);
+
+    // keep the zones with the longest self time, which points at the work itself rather than at its callers
+    profiler::aggregate(frame, m_nodes);
+    for (auto &n : m_nodes)
+    {
+        float self_ms = n.self_ns * 1e-6f;
+        if (h.num_zones == max_zones && self_ms <= h.zones[max_zones - 1].self_ms)
+            continue;
+
+        size_t i = std::min(h.num_zones, max_zones - 1);
+        for (; i > 0 && h.zones[i - 1].self_ms < self_ms; --i)
+            h.zones[i] = h.zones[i - 1];
+        h.zones[i]  = {n.label, n.source, n.calls, self_ms};
+        h.num_zones = std::min(h.num_zones + 1, max_zones);
+    }
+
+    m_next  = (m_next + 1) % history_size;
+    m_count = std::min(m_count + 1, history_size);
+    ++m_total;
+
+    log(h, frame);
+}
+
+void HitchDetector::log(const Hitch &h, const profiler::Frame &frame) const
+{
+    std::string zones;
+    for (size_t i = 0; i < h.num_zones; ++i)
+        zones += fmt::format("\n\t{:.1f} ms in {}{} ({} call{})", h.zones[i].self_ms, h.zones[i].label,
+                             h.zones[i].source == profiler::Source::GPU ? " (GPU)" : "", h.zones[i].calls,
+                             h.zones[i].calls == 1 ? "" : "s");
+
+    using memory_tracker::format_bytes;
+    std::string context = fmt::format("{} uploaded to textures, {} shader compile{}, {} read from and {} written to "
+                                      "files",
+                                      format_bytes(size_t(h.upload_bytes)), h.shader_compiles,
+                                      h.shader_compiles == 1 ? "" : "s", format_bytes(size_t(h.read_bytes)),
+                                      format_bytes(size_t(h.written_bytes)));
+    for (auto &m : frame.messages)
+        context += "\n\t" + m.text;
+
+    HelloImGui::Log(HelloImGui::LogLevel::Warning,
+                    "Hitch: frame %llu took %.1f ms (CPU %.1f ms, GPU %.1f ms; threshold %.0f ms). Longest zones:%s\n"
+                    "\t%s",
+                    (unsigned long long)h.frame, h.frame_ms, h.cpu_ms, h.gpu_ms, m_threshold, zones.c_str(),
+                    context.c_str());
+}
+
+void HitchDetector::export_history(const std::string &filename) const
+{
+    std::ofstream out(filename);
+    if (!out)
+        throw std::runtime_error(fmt::format("HitchDetector::export_history(): cannot write to \"{}\"!", filename));
+
+    out << fmt::format("{{\n  \"threshold_ms\": {},\n  \"total\": {},\n  \"hitches\": [", m_threshold, m_total);
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const Hitch &h = hitch(i);
+        out << fmt::format("{}\n    {{\"frame\": {}, \"time_s\": {:.3f}, \"frame_ms\": {:.3f}, \"cpu_ms\": {:.3f}, "
+                           "\"gpu_ms\": {:.3f}, \"upload_bytes\": {}, \"shader_compiles\": {}, \"read_bytes\": {}, "
+                           "\"written_bytes\": {}, \"zones\": [",
+                           i ? "," : "", h.frame, h.time, h.frame_ms, h.cpu_ms, h.gpu_ms, h.upload_bytes,
+                           h.shader_compiles, h.read_bytes, h.written_bytes);
+        for (size_t z = 0; z < h.num_zones; ++z)
+            out << fmt::format("{}{{\"label\": {}, \"source\": \"{}\", \"calls\": {}, \"self_ms\": {:.3f}}}",
+                               z ? ", " : "", trace::json_string(h.zones[z].label),
+                               h.zones[z].source == profiler::Source::GPU ? "gpu" : "cpu", h.zones[z].calls,
+                               h.zones[z].self_ms);
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+
+    if (!out)
+        throw std::runtime_error(fmt::format("HitchDetector::export_history(): error writing \"{}\"!", filename));
+}
+
+void HitchDetector::draw()
+{
+    if (!ImGui::CollapsingHeader("Hitches", ImGuiTreeNodeFlags_DefaultOpen))
+        return;
+
+    ImGui::SliderFloat("Threshold", &m_threshold, min_threshold, 1000.f, "%.0f ms");
+    m_threshold = std::max(m_threshold, min_threshold); // ctrl+click allows typing in any value
+    ImGui::Text("%llu hitches detected", (unsigned long long)m_total);
+#if !defined(__EMSCRIPTEN__)
+    ImGui::SameLine();
+    if (ImGui::Button("Export"))
+    {
+        std::string filename = trace::default_filename("hitches");
+        try
+        {
+            export_history(filename);
+            HelloImGui::Log(HelloImGui::LogLevel::Info, "Exported %zu hitches to '%s'", m_count, filename.c_str());
+        }
+        catch (const std::exception &e)
+        {
+            HelloImGui::Log(HelloImGui::LogLevel::Error, "%s", e.what());
+        }
+    }
+#endif
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+        clear();
+
+    // most recent first
+    for (size_t i = m_count; i-- > 0;)
+    {
+        const Hitch &h = hitch(i);
+        ImGui::Text("%8.1f s  frame %llu: %.1f ms", h.time, (unsigned long long)h.frame, h.frame_ms);
+        if (h.num_zones)
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s %.1f ms", h.zones[0].label, h.zones[0].self_ms);
+        }
+    }
+}
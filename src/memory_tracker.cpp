@@ -0,0 +1,201 @@
+#include "memory_tracker.h"
+
+#include "hello_imgui/hello_imgui.h"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <mutex>
+
+using namespace memory_tracker;
+
+struct Entry
+{
+    Category    category = Category::Textures;
+    size_t      bytes    = 0; ///< 0 if the entry is unused
+    std::string owner;
+};
+
+struct Registry
+{
+    std::mutex            mutex;
+    std::vector<Entry>    entries; ///< indexed by id - 1
+    std::vector<uint32_t> unused;  ///< ids of released entries, to reuse
+    Usage                 usage[(size_t)Category::Count];
+    Usage                 total;
+};
+
+/// The registry is never destroyed, since textures (or their owners) may be released during static destruction
+static Registry &registry()
+{
+    static Registry *r = new Registry;
+    return *r;
+}
+
+static void add(Usage &u, int64_t delta, int count)
+{
+    u.current = size_t(int64_t(u.current) + delta);
+    u.count   = size_t(int64_t(u.count) + count);
+    u.peak    = std::max(u.peak, u.current);
+}
+
+namespace memory_tracker
+{
+
+std::string format_bytes(size_t bytes)
+{
+    if (bytes >= 1024 * 1024)
+        return fmt::format("{:.1f} MB", bytes / (1024.0 * 1024.0));
+    if (bytes >= 1024)
+        return fmt::format("{:.1f} KB", bytes / 1024.0);
+    return fmt::format("{} bytes", bytes);
+}
+
+const char *name(Category category)
+{
+    switch (category)
+    {
+    case Category::Textures: return "Textures";
+    case Category::RenderTargets: return "Render targets";
+    case Category::Buffers: return "Buffers";
+    case Category::Arguments: return "Shader arguments";
+    case Category::Images: return "Decoded images";
+    default: return "Unknown";
+    }
+}
+
+void track(uint32_t &id, Category category, std::string_view owner, size_t bytes)
+{
+    if (!id && !bytes)
+        return;
+
+    Registry                   &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    if (!id)
+    {
+        if (r.unused.empty())
+        {
+            r.entries.emplace_back();
+            id = (uint32_t)r.entries.size();
+        }
+        else
+        {
+            id = r.unused.back();
+            r.unused.pop_back();
+        }
+        Entry &e   = r.entries[id - 1];
+        e.category = category;
+        e.owner    = owner;
+        e.bytes    = bytes;
+        add(r.usage[(size_t)category], int64_t(bytes), 1);
+        add(r.total, int64_t(bytes), 1);
+        return;
+    }
+
+    Entry  &e     = r.entries[id - 1];
+    int64_t delta = int64_t(bytes) - int64_t(e.bytes);
+    int     count = bytes ? 0 : -1;
+    add(r.usage[(size_t)e.category], delta, count);
+    add(r.total, delta, count);
+    e.bytes = bytes;
+
+    if (!bytes)
+    {
+        e.owner.clear();
+        r.unused.push_back(id);
+        id = 0;
+    }
+}
+
+void rename(uint32_t id, std::string_view owner)
+{
+    if (!id)
+        return;
+    Registry                   &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.entries[id - 1].owner = owner;
+}
+
+Usage usage(Category category)
+{
+    Registry                   &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.usage[(size_t)category];
+}
+
+Usage usage()
+{
+    Registry                   &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.total;
+}
+
+std::vector<Allocation> allocations()
+{
+    std::vector<Allocation> result;
+    {
+        Registry                   &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        result.reserve(r.total.count);
+        for (auto &e : r.entries)
+            if (e.bytes)
+                result.push_back({e.category, e.owner, e.bytes});
+    }
+    std::stable_sort(result.begin(), result.end(), [](auto &a, auto &b) { return a.bytes > b.bytes; });
+    return result;
+}
+
+void largest_allocations(std::vector<Allocation> &result, size_t max)
+{
+    Registry                   &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // insert each live entry into the sorted list of the largest so far; ties keep their order, as in allocations()
+    size_t count = 0;
+    for (auto &e : r.entries)
+    {
+        if (!e.bytes)
+            continue;
+        size_t i = count;
+        while (i > 0 && e.bytes > result[i - 1].bytes)
+            --i;
+        if (i >= max)
+            continue;
+        if (count < max)
+        {
+            if (count == result.size())
+                result.emplace_back();
+            ++count;
+        }
+        // move the last (dropped or unused) element into place, so that assigning the owner reuses its string
+        std::rotate(result.begin() + i, result.begin() + count - 1, result.begin() + count);
+        auto &a    = result[i];
+        a.category = e.category;
+        a.owner    = e.owner;
+        a.bytes    = e.bytes;
+    }
+    result.resize(count);
+}
+
+size_t report_leaks()
+{
+    auto leaks = allocations();
+    if (leaks.empty())
+        return 0;
+
+    size_t total = 0;
+    for (auto &a : leaks)
+        total += a.bytes;
+
+    std::string list;
+    for (auto &a : leaks)
+        list += fmt::format("\n\t{} ({}): {}", a.owner, name(a.category), format_bytes(a.bytes));
+
+    // also on stderr, since the log window is about to disappear
+    HelloImGui::Log(HelloImGui::LogLevel::Warning, "%zu allocations (%s) were never released:%s", leaks.size(),
+                    format_bytes(total).c_str(), list.c_str());
+    fmt::print(stderr, "{} allocations ({}) were never released:{}\n", leaks.size(), format_bytes(total), list);
+    return leaks.size();
+}
+
+} // namespace memory_tracker
@@ -1,32 +1,304 @@
 #if defined(HELLOIMGUI_HAS_OPENGL)
 
+#include "opengl_check.h"
 #include "hello_imgui/hello_imgui.h"
 #include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+#include "profiler.h"
+#include <cstring>
 #include <fmt/core.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-bool check_glerror(const char *cmd, const char *file, int line)
+#if defined(__EMSCRIPTEN__)
+#include <emscripten/html5.h>
+#endif
+
+// debug output is only available on desktop OpenGL (4.3 or KHR_debug)
+#if defined(HELLOIMGUI_USE_GLAD) && defined(GL_DEBUG_OUTPUT)
+#define HAS_DEBUG_OUTPUT 1
+#endif
+
+#if defined(NDEBUG)
+bool                gl_check_every_call = false;
+static GLErrorCheck s_requested         = GLErrorCheck::PerFrame;
+#else
+// until the requested mode is applied in the first frame, check every call so that errors during startup are caught
+bool                gl_check_every_call = true;
+static GLErrorCheck s_requested         = GLErrorCheck::DebugOutput;
+#endif
+static GLErrorCheck s_mode    = gl_check_every_call ? GLErrorCheck::PerCall : GLErrorCheck::Off;
+static bool         s_pending = true;
+
+// the first message with each ID is always logged; after that, at most this many new messages are logged per second,
+// and the rest are counted and summarized
+static constexpr int max_messages_per_second = 10;
+// at most this many message IDs and distinct messages are remembered, so that a driver that puts e.g. object names
+// or addresses into its messages cannot grow the tables without limit
+static constexpr size_t max_seen_messages = 1024;
+
+struct SeenMessage
 {
-    GLenum      err = glGetError();
-    const char *msg = nullptr;
+    HelloImGui::LogLevel level;
+    std::string          text;
+    uint64_t             count    = 0; ///< how often it was reported in total
+    uint64_t             reported = 0; ///< how many of those were logged (or summarized)
+};
+
+// the debug callback may be called from a driver thread, so all of this is guarded by s_mutex
+static std::mutex                                s_mutex;
+static std::unordered_map<uint64_t, SeenMessage> s_seen;
+static std::unordered_set<uint64_t>              s_ids;           ///< IDs of the messages logged so far
+static std::vector<SeenMessage>                  s_new;           ///< messages seen for the first time, to be logged
+static uint64_t                                  s_dropped   = 0; ///< new messages over the rate limit
+static int64_t                                   s_second    = 0; ///< start of the current rate limiting interval
+static int                                       s_in_second = 0; ///< new messages logged in the current interval
 
+static const char *error_name(GLenum err)
+{
     switch (err)
     {
-    case GL_NO_ERROR: return false;
-    case GL_INVALID_ENUM: msg = "invalid enumeration"; break;
-    case GL_INVALID_VALUE: msg = "invalid value"; break;
-    case GL_INVALID_OPERATION: msg = "invalid operation"; break;
-    case GL_INVALID_FRAMEBUFFER_OPERATION: msg = "invalid framebuffer operation"; break;
-    case GL_OUT_OF_MEMORY: msg = "out of memory"; break;
+    case GL_INVALID_ENUM: return "invalid enumeration";
+    case GL_INVALID_VALUE: return "invalid value";
+    case GL_INVALID_OPERATION: return "invalid operation";
+    case GL_INVALID_FRAMEBUFFER_OPERATION: return "invalid framebuffer operation";
+    case GL_OUT_OF_MEMORY: return "out of memory";
 #ifndef __EMSCRIPTEN__
-    case GL_STACK_UNDERFLOW: msg = "stack underflow"; break;
-    case GL_STACK_OVERFLOW: msg = "stack overflow"; break;
+    case GL_STACK_UNDERFLOW: return "stack underflow";
+    case GL_STACK_OVERFLOW: return "stack overflow";
 #endif
-    default: msg = "unknown error"; break;
+    default: return "unknown error";
     }
+}
 
+static uint64_t hash_message(uint64_t hash, std::string_view text)
+{
+    for (char c : text)
+        hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+    return hash;
+}
+
+/// Count a message, queueing it for logging if it is new and its ID is new or the rate limit allows. Thread-safe.
+static void report(HelloImGui::LogLevel level, uint64_t id, std::string_view text)
+{
+    uint64_t                    key = hash_message(14695981039346656037ull ^ id, text);
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto it = s_seen.find(key);
+    if (it != s_seen.end())
+    {
+        ++it->second.count; // a repeat, summarized by flush()
+        return;
+    }
+
+    int64_t now = profiler::now_ns();
+    if (now - s_second > 1000000000)
+    {
+        s_second    = now;
+        s_in_second = 0;
+    }
+    bool new_id = s_ids.size() < max_seen_messages && s_ids.insert(id).second;
+    if (!new_id && s_in_second >= max_messages_per_second)
+    {
+        ++s_dropped; // not remembered, so it is logged if it comes up again once the rate allows
+        return;
+    }
+    ++s_in_second;
+    s_new.push_back({level, std::string(text), 1, 1});
+    if (s_seen.size() < max_seen_messages)
+        s_seen.emplace(key, s_new.back());
+}
+
+/// Log the new messages, and (at most once per second) how often the known ones repeated. Main thread only.
+static void flush()
+{
+    static int64_t last_summary = 0;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (const auto &seen : s_new)
+    {
+        profiler::message("OpenGL: " + seen.text);
+        HelloImGui::Log(seen.level, "OpenGL: %s", seen.text.c_str());
+    }
+    s_new.clear();
+
+    int64_t now = profiler::now_ns();
+    if (now - last_summary < 1000000000)
+        return;
+    last_summary = now;
+
+    for (auto &[key, seen] : s_seen)
+    {
+        if (seen.count == seen.reported)
+            continue;
+        HelloImGui::Log(seen.level, "OpenGL: \"%s\" (repeated %llu more times)", seen.text.c_str(),
+                        (unsigned long long)(seen.count - seen.reported));
+        seen.reported = seen.count;
+    }
+    if (s_dropped)
+        HelloImGui::Log(HelloImGui::LogLevel::Warning, "OpenGL: %llu messages over the rate limit were not logged",
+                        (unsigned long long)s_dropped);
+    s_dropped = 0;
+}
+
+#if defined(HAS_DEBUG_OUTPUT)
+static void APIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                    const GLchar *message, const void *user)
+{
+    (void)source;
+    (void)user;
+
+    HelloImGui::LogLevel level = HelloImGui::LogLevel::Debug;
+    switch (severity)
+    {
+    case GL_DEBUG_SEVERITY_HIGH: level = HelloImGui::LogLevel::Error; break;
+    case GL_DEBUG_SEVERITY_MEDIUM: level = HelloImGui::LogLevel::Warning; break;
+    case GL_DEBUG_SEVERITY_LOW: level = HelloImGui::LogLevel::Info; break;
+    default: break;
+    }
+    if (type == GL_DEBUG_TYPE_ERROR)
+        level = HelloImGui::LogLevel::Error;
+
+    report(level, id, length < 0 ? std::string_view(message) : std::string_view(message, (size_t)length));
+}
+
+static bool debug_output_supported()
+{
+    static const bool supported = gl_version_at_least(4, 3) || gl_extension_supported("GL_KHR_debug");
+    return supported;
+}
+#endif
+
+static void apply(GLErrorCheck mode)
+{
+#if defined(HAS_DEBUG_OUTPUT)
+    if (mode == GLErrorCheck::DebugOutput && !debug_output_supported())
+#else
+    if (mode == GLErrorCheck::DebugOutput)
+#endif
+    {
+#if defined(NDEBUG)
+        mode = GLErrorCheck::PerFrame;
+#else
+        mode = GLErrorCheck::PerCall;
+#endif
+        HelloImGui::Log(HelloImGui::LogLevel::Warning, "OpenGL debug output is not supported, using %s error checks.",
+                        mode == GLErrorCheck::PerCall ? "per-call" : "per-frame");
+    }
+#if defined(NDEBUG)
+    if (mode == GLErrorCheck::PerCall)
+    {
+        mode = GLErrorCheck::PerFrame;
+        HelloImGui::Log(HelloImGui::LogLevel::Warning, "Per-call OpenGL error checks require a debug build, "
+                                                       "using per-frame error checks.");
+    }
+#endif
+
+#if defined(HAS_DEBUG_OUTPUT)
+    if (debug_output_supported())
+    {
+        if (mode == GLErrorCheck::DebugOutput)
+        {
+            glEnable(GL_DEBUG_OUTPUT);
+            glDebugMessageCallback(debug_callback, nullptr);
+            // notifications (e.g. where buffers live) are only noise here
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+        }
+        else if (s_mode == GLErrorCheck::DebugOutput)
+        {
+            glDisable(GL_DEBUG_OUTPUT);
+            glDebugMessageCallback(nullptr, nullptr);
+        }
+    }
+#endif
+
+    // don't blame the errors raised before the switch on the first frame
+    if (mode != GLErrorCheck::PerCall)
+        while (glGetError() != GL_NO_ERROR)
+        {
+        }
+
+    s_mode              = mode;
+    gl_check_every_call = mode == GLErrorCheck::PerCall;
+}
+
+void set_gl_error_check(GLErrorCheck mode)
+{
+    s_requested = mode;
+    s_pending   = true;
+}
+
+GLErrorCheck gl_error_check()
+{
+    return s_mode;
+}
+
+void gl_error_check_new_frame()
+{
+    if (s_pending)
+    {
+        s_pending = false;
+        apply(s_requested);
+    }
+
+    if (s_mode == GLErrorCheck::PerFrame)
+    {
+        // a lost context keeps reporting errors, so don't loop forever
+        for (int i = 0; i < 8; ++i)
+        {
+            GLenum err = glGetError();
+            if (err == GL_NO_ERROR)
+                break;
+            report(HelloImGui::LogLevel::Error, err,
+                   fmt::format("error ({}) during the last frame; run a debug build with --gl-errors call to find the "
+                               "failing call",
+                               error_name(err)));
+        }
+    }
+
+    flush();
+}
+
+bool check_glerror(const char *cmd, const char *file, int line)
+{
+    GLenum err = glGetError();
+    if (err == GL_NO_ERROR)
+        return false;
+
+    const char *msg = error_name(err);
     fmt::print(stderr, "OpenGL error {}:{} ({}) during operation \"{}\"!\n", file, line, msg, cmd);
     HelloImGui::Log(HelloImGui::LogLevel::Error, "OpenGL error (%s) during operation \"%s\"!\n", msg, cmd);
     return true;
 }
 
+bool gl_extension_supported(const char *name)
+{
+#if defined(__EMSCRIPTEN__)
+    // WebGL extension names don't have the "GL_" prefix, and need to be enabled before use
+    if (strncmp(name, "GL_", 3) == 0)
+        name += 3;
+    return emscripten_webgl_enable_extension(emscripten_webgl_get_current_context(), name);
+#else
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+#endif
+}
+
+bool gl_version_at_least(int major, int minor)
+{
+    GLint context_major = 0, context_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    return context_major > major || (context_major == major && context_minor >= minor);
+}
+
 #endif // defined(HELLOIMGUI_HAS_OPENGL)
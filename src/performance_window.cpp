@@ -0,0 +1,285 @@
+#include "performance_window.h"
+
+#include "alloc_tracker.h"
+#include "gpu_timer.h"
+#include "imgui.h"
+#include "memory_tracker.h"
+#include "shader.h"
+#include "texture.h"
+
+#include <algorithm>
+
+static constexpr float mega = 1.f / (1024.f * 1024.f);
+
+/// Number of the largest live allocations listed in the "Memory" section
+static constexpr size_t max_allocations = 20;
+
+/// Number of the call stacks with the most heap allocations listed in the "Heap allocations" section
+static constexpr size_t max_stacks = 10;
+
+static const ImVec4 over_budget_color{1.f, 0.35f, 0.3f, 1.f};
+
+void PerformanceWindow::sample()
+{
+    static const char *upload_label = profiler::intern("Texture upload bytes");
+    static const char *heap_label   = profiler::intern("Heap allocations");
+
+    uint64_t current = profiler::frame_index();
+    if (current <= profiler::complete_after)
+        return;
+
+    // frames that fell out of the profiler's history while we weren't drawn are skipped
+    uint64_t last  = current - profiler::complete_after;
+    uint64_t first = std::max(m_last_sampled + 1, last > profiler::history_size ? last - profiler::history_size : 1);
+    for (uint64_t i = first; i <= last; ++i)
+    {
+        auto f = profiler::frame(i);
+        if (!f)
+            continue;
+
+        m_history[FrameTime][m_next]       = f->duration_ns * 1e-6f;
+        m_history[CPUTime][m_next]         = f->cpu_ns * 1e-6f;
+        m_history[GPUTime][m_next]         = f->gpu_ns * 1e-6f;
+        m_history[UploadBytes][m_next]     = (float)profiler::counter_total(*f, upload_label);
+        m_history[HeapAllocations][m_next] = (float)profiler::counter_total(*f, heap_label);
+
+        m_next  = (m_next + 1) % history_size;
+        m_count = std::min(m_count + 1, history_size);
+    }
+
+    if (last != m_last_sampled)
+        if (auto f = profiler::frame(last))
+            profiler::aggregate(*f, m_nodes);
+    m_last_sampled = last;
+}
+
+void PerformanceWindow::percentiles(Series series, float (&result)[3])
+{
+    static constexpr float quantiles[3] = {0.5f, 0.95f, 0.99f};
+
+    // the rings hold the samples in order only once they are full, but the order doesn't matter here
+    auto begin = m_sorted.begin(), end = m_sorted.begin() + m_count;
+    std::copy(m_history[series].begin(), m_history[series].begin() + m_count, begin);
+    std::sort(begin, end);
+    for (int i = 0; i < 3; ++i)
+        result[i] = m_count ? *(begin + size_t(quantiles[i] * (m_count - 1) + 0.5f)) : 0.f;
+}
+
+void PerformanceWindow::draw()
+{
+    if (!m_paused)
+        sample();
+
+    if (m_count == 0)
+    {
+        ImGui::TextDisabled("Collecting frames...");
+        return;
+    }
+
+    size_t newest   = (m_next + history_size - 1) % history_size;
+    float  frame_ms = m_history[FrameTime][newest];
+    ImGui::Text("Frame %.2f ms (%.0f fps)", frame_ms, frame_ms > 0.f ? 1000.f / frame_ms : 0.f);
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &m_paused);
+
+    // scale the graph to the slowest typical frames, so that a single hitch doesn't flatten it
+    float frame_p[3];
+    percentiles(FrameTime, frame_p);
+    float scale = std::max(1.5f * frame_p[2], 1.f);
+    ImGui::PlotLines("##frame times", m_history[FrameTime].data(), (int)m_count,
+                     m_count < history_size ? 0 : (int)m_next, "frame time (ms)", 0.f, scale,
+                     ImVec2(ImGui::GetContentRegionAvail().x, 80.f));
+
+    if (ImGui::BeginTable("percentiles", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableHeadersRow();
+
+        auto row = [this](const char *name, Series series, bool available)
+        {
+            float p[3];
+            percentiles(series, p);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name);
+            for (float v : p)
+            {
+                ImGui::TableNextColumn();
+                if (available)
+                    ImGui::Text("%.2f", v);
+                else
+                    ImGui::TextDisabled("n/a");
+            }
+        };
+        row("Frame", FrameTime, true);
+        row("CPU", CPUTime, true);
+        row("GPU", GPUTime, gpu_timer::enabled());
+        ImGui::EndTable();
+    }
+
+    float upload_p[3];
+    percentiles(UploadBytes, upload_p);
+    ImGui::Text("GPU memory: %.1f MB in textures, %.1f MB in buffers", Texture::total_bytes() * mega,
+                Shader::total_buffer_bytes() * mega);
+    ImGui::Text("Uploads: %.2f MB last frame, %.2f MB p95, %.2f MB p99", m_history[UploadBytes][newest] * mega,
+                upload_p[1] * mega, upload_p[2] * mega);
+    if (alloc_tracker::enabled())
+    {
+        auto  &heap = alloc_tracker::last_frame();
+        size_t over = (size_t)std::count_if(m_history[HeapAllocations].begin(),
+                                            m_history[HeapAllocations].begin() + m_count,
+                                            [](float n) { return n > alloc_tracker::budget(); });
+        ImGui::TextColored(heap.allocations > alloc_tracker::budget() ? over_budget_color
+                                                                      : ImGui::GetStyleColorVec4(ImGuiCol_Text),
+                           "Heap: %zu allocations (%.1f KB) last frame, %zu of %zu frames over budget",
+                           heap.allocations, heap.bytes / 1024.f, over, m_count);
+    }
+    if (uint64_t dropped = profiler::dropped_zones())
+        ImGui::TextDisabled("%llu zones dropped (ring buffer full)", (unsigned long long)dropped);
+
+    const ImGuiTableFlags zone_flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+    if (ImGui::CollapsingHeader("Zones", ImGuiTreeNodeFlags_DefaultOpen) && ImGui::BeginTable("zones", 4, zone_flags))
+    {
+        ImGui::TableSetupColumn("Zone");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Total ms");
+        ImGui::TableSetupColumn("Self ms");
+        ImGui::TableHeadersRow();
+        for (auto &n : m_nodes)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s%s", 2 * n.depth, "", n.label,
+                        n.source == profiler::Source::GPU && n.depth == 0 ? " (GPU)" : "");
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", n.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", n.total_ns * 1e-6);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", n.self_ns * 1e-6);
+        }
+        ImGui::EndTable();
+    }
+
+    draw_allocations();
+
+    if (ImGui::CollapsingHeader("Memory") && ImGui::BeginTable("memory", 4, zone_flags))
+    {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("Current MB");
+        ImGui::TableSetupColumn("Peak MB");
+        ImGui::TableHeadersRow();
+
+        auto row = [](const char *name, const memory_tracker::Usage &u)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", u.count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", u.current * mega);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", u.peak * mega);
+        };
+        for (int c = 0; c < (int)memory_tracker::Category::Count; ++c)
+            row(memory_tracker::name((memory_tracker::Category)c), memory_tracker::usage((memory_tracker::Category)c));
+        row("Total", memory_tracker::usage());
+        ImGui::EndTable();
+
+        // the largest allocations, which are the first suspects when memory grows
+        memory_tracker::largest_allocations(m_allocations, max_allocations);
+        if (!m_allocations.empty() && ImGui::BeginTable("allocations", 3, zone_flags))
+        {
+            ImGui::TableSetupColumn("Owner");
+            ImGui::TableSetupColumn("Category");
+            ImGui::TableSetupColumn("MB");
+            ImGui::TableHeadersRow();
+            for (auto &a : m_allocations)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(a.owner.c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(memory_tracker::name(a.category));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", a.bytes * mega);
+            }
+            ImGui::EndTable();
+        }
+    }
+}
+
+void PerformanceWindow::draw_allocations()
+{
+    if (!ImGui::CollapsingHeader("Heap allocations"))
+        return;
+
+    bool enabled = alloc_tracker::enabled();
+    if (ImGui::Checkbox("Track", &enabled))
+        alloc_tracker::set_enabled(enabled);
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!alloc_tracker::stacks_supported());
+    bool stacks = alloc_tracker::capture_stacks();
+    if (ImGui::Checkbox("Capture call stacks (slow)", &stacks))
+        alloc_tracker::set_capture_stacks(stacks);
+    ImGui::EndDisabled();
+
+    int budget = (int)alloc_tracker::budget();
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8.f);
+    if (ImGui::InputInt("Budget (allocations per frame)", &budget))
+        alloc_tracker::set_budget((size_t)std::max(budget, 0));
+
+    if (!enabled)
+    {
+        ImGui::TextDisabled("Counts the allocations made through operator new in each frame and zone");
+        return;
+    }
+
+    ImGui::Text("%llu frames over budget since tracking started",
+                (unsigned long long)alloc_tracker::frames_over_budget());
+
+    auto &heap = alloc_tracker::last_frame();
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+    if (heap.num_zones && ImGui::BeginTable("heap zones", 3, flags))
+    {
+        ImGui::TableSetupColumn("Zone");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableSetupColumn("KB");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < heap.num_zones; ++i)
+        {
+            auto &z = heap.zones[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(z.label ? z.label : "(no zone)");
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", z.allocations);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", z.bytes / 1024.f);
+        }
+        ImGui::EndTable();
+    }
+
+    if (!stacks)
+        return;
+
+    // symbolizing allocates, so only do it while the stacks are shown
+    if (ImGui::Button("Clear call stacks"))
+        alloc_tracker::clear_stacks();
+    auto top = alloc_tracker::top_stacks(max_stacks);
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+        auto &s = top[i];
+        if (!ImGui::TreeNode((void *)(intptr_t)i, "%zu allocations (%.1f KB) in %s", s.allocations, s.bytes / 1024.f,
+                             s.zone ? s.zone : "(no zone)"))
+            continue;
+        for (auto &symbol : alloc_tracker::symbolize(s))
+            ImGui::TextUnformatted(symbol.c_str());
+        ImGui::TreePop();
+    }
+}
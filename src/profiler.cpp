@@ -0,0 +1,324 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+/// A zone or counter waiting in a thread's ring. Counters are stored in the zone's fields: the time in start_ns and
+/// the value in duration_ns.
+struct PendingZone
+{
+    uint64_t       frame;
+    bool           counter;
+    profiler::Zone zone;
+};
+
+/// The zones recorded by one thread. Only the owning thread writes \c head and only new_frame() writes \c tail, so
+/// neither side needs a lock.
+struct ThreadRing
+{
+    std::array<PendingZone, profiler::ring_size> zones;
+    std::atomic<size_t>                          head{0};
+    std::atomic<size_t>                          tail{0};
+    uint32_t                                     thread = 0;
+};
+
+static std::array<profiler::Frame, profiler::history_size> s_frames;
+static std::atomic<uint64_t>                               s_frame_index{0};
+
+static std::atomic<bool>     s_enabled{true};
+static std::atomic<uint64_t> s_dropped{0};
+
+static std::mutex                                          s_messages_mutex;
+static std::vector<std::pair<uint64_t, profiler::Message>> s_messages;
+
+// rings are registered once per thread and never freed, since zones may still be pending when a thread exits
+static std::mutex                               s_rings_mutex;
+static std::vector<std::unique_ptr<ThreadRing>> s_rings;
+
+static thread_local ThreadRing *t_ring  = nullptr;
+static thread_local uint16_t    t_depth = 0;
+
+static thread_local const char *t_labels[profiler::max_depth]; ///< labels of the open zones, by depth
+
+static ThreadRing &thread_ring()
+{
+    if (!t_ring)
+    {
+        std::lock_guard<std::mutex> lock(s_rings_mutex);
+        s_rings.push_back(std::make_unique<ThreadRing>());
+        t_ring         = s_rings.back().get();
+        t_ring->thread = uint32_t(s_rings.size() - 1);
+    }
+    return *t_ring;
+}
+
+static void push(ThreadRing &ring, uint64_t frame, const profiler::Zone &zone, bool counter = false)
+{
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= profiler::ring_size)
+    {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.zones[head % profiler::ring_size] = {frame, counter, zone};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+namespace profiler
+{
+
+int64_t now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+const char *intern(std::string_view label)
+{
+    // node-based, so the strings never move
+    static std::mutex                      mutex;
+    static std::unordered_set<std::string> labels;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return labels.emplace(label).first->c_str();
+}
+
+static void add_zone(Frame &f, const Zone &zone, bool counter, uint32_t main_thread)
+{
+    if (counter)
+    {
+        f.counters.push_back({zone.label, zone.thread, zone.start_ns, zone.duration_ns});
+        return;
+    }
+
+    f.zones.push_back(zone);
+    if (zone.depth != 0)
+        return;
+    // other threads (e.g. the thumbnail workers) run alongside the frame, so they don't add to its CPU time
+    if (zone.source != Source::CPU)
+        f.gpu_ns += zone.duration_ns;
+    else if (zone.thread == main_thread)
+        f.cpu_ns += zone.duration_ns;
+}
+
+void new_frame()
+{
+    int64_t  now         = now_ns();
+    uint64_t index       = s_frame_index.load(std::memory_order_relaxed);
+    uint32_t main_thread = thread_index(); // new_frame() is only called on the main thread
+
+    auto &previous = s_frames[index % history_size];
+    if (previous.start_ns)
+        previous.duration_ns = now - previous.start_ns;
+
+    // move the zones recorded since the last frame into the history, before a new frame overwrites the oldest one
+    {
+        std::lock_guard<std::mutex> lock(s_rings_mutex);
+        for (auto &ring : s_rings)
+        {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail)
+            {
+                auto &p = ring->zones[tail % ring_size];
+                if (auto f = const_cast<Frame *>(frame(p.frame)))
+                    add_zone(*f, p.zone, p.counter, main_thread);
+            }
+            ring->tail.store(tail, std::memory_order_release);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_messages_mutex);
+        for (auto &[index, m] : s_messages)
+            if (auto f = const_cast<Frame *>(frame(index)))
+                f->messages.push_back(std::move(m));
+        s_messages.clear();
+    }
+
+    ++index;
+    auto &current       = s_frames[index % history_size];
+    current.index       = index;
+    current.start_ns    = now;
+    current.duration_ns = current.cpu_ns = current.gpu_ns = 0;
+    current.zones.clear();
+    current.counters.clear();
+    current.messages.clear();
+    s_frame_index.store(index, std::memory_order_relaxed);
+}
+
+uint64_t frame_index()
+{
+    return s_frame_index.load(std::memory_order_relaxed);
+}
+
+void submit(uint64_t frame, const Zone &zone)
+{
+    push(thread_ring(), frame, zone);
+}
+
+void count(const char *label, int64_t value)
+{
+    auto &ring = thread_ring();
+    push(ring, frame_index(), {label, Source::CPU, 0, ring.thread, now_ns(), value}, true);
+}
+
+int64_t counter_total(const Frame &frame, const char *label)
+{
+    int64_t total = 0;
+    for (auto &c : frame.counters)
+        if (c.label == label)
+            total += c.value;
+    return total;
+}
+
+void message(std::string_view text)
+{
+    Message m{thread_ring().thread, now_ns(), std::string(text)};
+
+    std::lock_guard<std::mutex> lock(s_messages_mutex);
+    s_messages.emplace_back(frame_index(), std::move(m));
+}
+
+uint32_t thread_index()
+{
+    return thread_ring().thread;
+}
+
+const Frame *frame(uint64_t index)
+{
+    auto &f = s_frames[index % history_size];
+    return f.index == index && index != 0 ? &f : nullptr;
+}
+
+void set_enabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool enabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t dropped_zones()
+{
+    return s_dropped.load(std::memory_order_relaxed);
+}
+
+int64_t begin(const char *label)
+{
+    if (!s_enabled.load(std::memory_order_relaxed))
+        return 0;
+    if (t_depth < max_depth)
+        t_labels[t_depth] = label;
+    ++t_depth;
+    return now_ns();
+}
+
+void end(const char *label, int64_t start_ns)
+{
+    if (!start_ns)
+        return;
+    int64_t now  = now_ns();
+    auto   &ring = thread_ring();
+    push(ring, frame_index(), {label, Source::CPU, --t_depth, ring.thread, start_ns, now - start_ns});
+}
+
+const char *current_zone()
+{
+    return t_depth == 0 ? nullptr : t_labels[std::min<size_t>(t_depth, max_depth) - 1];
+}
+
+void aggregate(const Frame &frame, std::vector<Node> &nodes)
+{
+    // main thread only, so the scratch buffers can be kept around
+    struct Open
+    {
+        int      node;
+        int64_t  end_ns;
+        uint16_t depth;
+    };
+    static std::vector<uint32_t> order;
+    static std::vector<Open>     open;
+    static std::vector<Node>     merged;
+
+    // visit the zones of each thread (and the GPU) in the order they started, so that each zone's parent is the
+    // innermost zone that is still open
+    const auto &zones = frame.zones;
+    order.resize(zones.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(),
+              [&zones](uint32_t a, uint32_t b)
+              {
+                  const Zone &za = zones[a], &zb = zones[b];
+                  if (za.source != zb.source)
+                      return za.source < zb.source;
+                  if (za.thread != zb.thread)
+                      return za.thread < zb.thread;
+                  if (za.start_ns != zb.start_ns)
+                      return za.start_ns < zb.start_ns;
+                  return za.depth < zb.depth;
+              });
+
+    merged.clear();
+    open.clear();
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const Zone &z = zones[order[i]];
+        if (i > 0 && (zones[order[i - 1]].source != z.source || zones[order[i - 1]].thread != z.thread))
+            open.clear();
+
+        int64_t end_ns = z.start_ns + z.duration_ns;
+        while (!open.empty() && (open.back().depth >= z.depth || open.back().end_ns < end_ns))
+            open.pop_back();
+        int parent = open.empty() ? -1 : open.back().node;
+
+        // merge with a sibling that has the same label
+        int node = -1;
+        for (int n = parent + 1; n < (int)merged.size(); ++n)
+            if (merged[n].parent == parent && merged[n].label == z.label && merged[n].source == z.source)
+            {
+                node = n;
+                break;
+            }
+        if (node < 0)
+        {
+            node = (int)merged.size();
+            merged.push_back({z.label, z.source, uint16_t(parent < 0 ? 0 : merged[parent].depth + 1), parent, 0, 0, 0});
+        }
+        merged[node].calls += 1;
+        merged[node].total_ns += z.duration_ns;
+        open.push_back({node, end_ns, z.depth});
+    }
+
+    for (auto &n : merged)
+        n.self_ns += n.total_ns;
+    for (auto &n : merged)
+        if (n.parent >= 0)
+            merged[n.parent].self_ns -= n.total_ns;
+
+    // nodes were created in the order they were first seen, so a later child of an earlier node can end up after
+    // unrelated subtrees; list them depth-first instead
+    nodes.clear();
+    auto visit = [&nodes](auto &&self, int old_parent, int new_parent) -> void
+    {
+        for (int n = old_parent + 1; n < (int)merged.size(); ++n)
+            if (merged[n].parent == old_parent)
+            {
+                nodes.push_back(merged[n]);
+                nodes.back().parent = new_parent;
+                self(self, n, (int)nodes.size() - 1);
+            }
+    };
+    visit(visit, -1, -1);
+}
+
+} // namespace profiler
@@ -0,0 +1,358 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <set>
+#include <stdexcept>
+
+RenderGraph::Resource RenderGraph::create_texture(const std::string &name, const TextureDesc &desc)
+{
+    if (desc.size.x <= 0 || desc.size.y <= 0)
+        throw std::runtime_error(fmt::format("RenderGraph::create_texture(\"{}\"): invalid size!", name));
+
+    ResourceInfo info;
+    info.name = name;
+    info.desc = desc;
+    m_resources.push_back(info);
+    m_compiled = false;
+    return (Resource)m_resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::import_texture(const std::string &name, Texture *texture)
+{
+    if (!texture)
+        throw std::runtime_error(fmt::format("RenderGraph::import_texture(\"{}\"): texture must not be null!", name));
+
+    ResourceInfo info;
+    info.name     = name;
+    info.desc     = {texture->size(), texture->pixel_format(), texture->component_format(),
+                     texture->min_interpolation_mode()};
+    info.texture  = texture;
+    info.imported = true;
+    m_resources.push_back(info);
+    m_compiled = false;
+    return (Resource)m_resources.size() - 1;
+}
+
+void RenderGraph::add_pass(const std::string &name, const std::vector<Resource> &reads,
+                           const std::vector<Resource> &writes, ExecuteCallback execute, bool clear)
+{
+    if (writes.empty())
+        throw std::runtime_error(fmt::format("RenderGraph::add_pass(\"{}\"): a pass must write something!", name));
+
+    for (auto r : reads)
+        resource(r);
+    for (auto w : writes)
+    {
+        auto &info = resource(w);
+        if (info.writer >= 0)
+            throw std::runtime_error(fmt::format("RenderGraph::add_pass(\"{}\"): \"{}\" is already written by \"{}\"!",
+                                                 name, info.name, m_passes[info.writer].name));
+        if (info.imported && !(info.texture->flags() & (uint8_t)Texture::TextureFlags::RenderTarget))
+            throw std::runtime_error(fmt::format(
+                "RenderGraph::add_pass(\"{}\"): imported texture \"{}\" is not a render target!", name, info.name));
+    }
+
+    for (auto w : writes)
+        m_resources[w].writer = (int)m_passes.size();
+
+    m_passes.push_back({name, reads, writes, std::move(execute), clear});
+    m_compiled = false;
+}
+
+void RenderGraph::mark_output(Resource r)
+{
+    resource(r);
+    m_resources[r].output = true;
+    m_compiled            = false;
+}
+
+void RenderGraph::compile()
+{
+    int num_passes = (int)m_passes.size();
+
+    //
+    // order the passes so that each texture is written before it is read (Kahn's algorithm, preferring the order in
+    // which the passes were added)
+    //
+    std::vector<std::vector<int>> dependents(num_passes);
+    std::vector<int>              num_dependencies(num_passes, 0);
+    for (int p = 0; p < num_passes; ++p)
+    {
+        for (auto r : m_passes[p].reads)
+        {
+            const auto &info = m_resources[r];
+            if (info.writer < 0)
+            {
+                if (info.imported)
+                    continue;
+                throw std::runtime_error(fmt::format("RenderGraph::compile(): pass \"{}\" reads \"{}\", which is never "
+                                                     "written!",
+                                                     m_passes[p].name, info.name));
+            }
+            if (info.writer == p)
+                throw std::runtime_error(fmt::format("RenderGraph::compile(): pass \"{}\" reads and writes \"{}\"!",
+                                                     m_passes[p].name, info.name));
+            dependents[info.writer].push_back(p);
+            ++num_dependencies[p];
+        }
+    }
+
+    std::vector<int> order;
+    std::set<int>    ready;
+    for (int p = 0; p < num_passes; ++p)
+        if (num_dependencies[p] == 0)
+            ready.insert(p);
+    while (!ready.empty())
+    {
+        int p = *ready.begin();
+        ready.erase(ready.begin());
+        order.push_back(p);
+        for (int d : dependents[p])
+            if (--num_dependencies[d] == 0)
+                ready.insert(d);
+    }
+    if ((int)order.size() != num_passes)
+        throw std::runtime_error("RenderGraph::compile(): the passes have a cyclic dependency!");
+
+    //
+    // cull the passes that don't contribute to an output, walking backwards from the outputs
+    //
+    std::vector<bool> needed(m_resources.size(), false);
+    for (size_t r = 0; r < m_resources.size(); ++r)
+        needed[r] = m_resources[r].output || (m_resources[r].imported && m_resources[r].writer >= 0);
+
+    std::vector<bool> alive(num_passes, false);
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        const auto &pass = m_passes[*it];
+        alive[*it] = std::any_of(pass.writes.begin(), pass.writes.end(), [&needed](Resource w) { return needed[w]; });
+        if (alive[*it])
+            for (auto r : pass.reads)
+                needed[r] = true;
+    }
+
+    m_order.clear();
+    for (int p : order)
+        if (alive[p])
+            m_order.push_back(p);
+    m_culled = num_passes - m_order.size();
+
+    //
+    // compute when each transient texture is last used (as a position in m_order); it is first used by its writer
+    //
+    int              end = (int)m_order.size();
+    std::vector<int> last(m_resources.size(), -1);
+    for (int i = 0; i < end; ++i)
+    {
+        const auto &pass = m_passes[m_order[i]];
+        for (auto w : pass.writes)
+            last[w] = std::max(last[w], m_resources[w].output ? end : i);
+        for (auto r : pass.reads)
+            last[r] = std::max(last[r], i);
+    }
+
+    //
+    // forget the render passes of imported textures that this graph no longer uses (the caller may free them)
+    //
+    std::set<const Texture *> known;
+    for (auto &[key, textures] : m_pool)
+        for (auto &texture : textures)
+            known.insert(texture.get());
+    for (auto &info : m_resources)
+        if (info.imported)
+            known.insert(info.texture);
+    for (auto it = m_render_passes.begin(); it != m_render_passes.end();)
+    {
+        auto &targets = it->first.first;
+        if (std::all_of(targets.begin(), targets.end(), [&known](Texture *t) { return known.count(t) > 0; }))
+            ++it;
+        else
+            it = m_render_passes.erase(it);
+    }
+
+    //
+    // assign pooled textures, returning each to the pool right after the last pass that uses it
+    //
+    std::map<PoolKey, std::vector<Texture *>> available;
+    for (auto &[key, textures] : m_pool)
+        for (auto &texture : textures)
+            available[key].push_back(texture.get());
+
+    for (auto &info : m_resources)
+        if (!info.imported)
+            info.texture = nullptr;
+
+    for (int i = 0; i < end; ++i)
+    {
+        const auto &pass = m_passes[m_order[i]];
+        for (auto w : pass.writes)
+        {
+            auto &info = m_resources[w];
+            if (info.imported)
+                continue;
+
+            auto  key  = pool_key(info.desc);
+            auto &free = available[key];
+            if (free.empty())
+            {
+                auto texture = std::make_unique<Texture>(
+                    info.desc.pixel_format, info.desc.component_format, info.desc.size, info.desc.interpolation,
+                    info.desc.interpolation, Texture::WrapMode::ClampToEdge, 1,
+                    Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget);
+                info.texture = texture.get();
+                m_pool[key].push_back(std::move(texture));
+            }
+            else
+            {
+                info.texture = free.back();
+                free.pop_back();
+            }
+        }
+
+        for (size_t r = 0; r < m_resources.size(); ++r)
+            if (last[r] == i && !m_resources[r].imported && m_resources[r].texture)
+                available[pool_key(m_resources[r].desc)].push_back(m_resources[r].texture);
+    }
+
+    m_compiled = true;
+}
+
+void RenderGraph::execute()
+{
+    if (!m_compiled)
+        compile();
+
+    for (int p : m_order)
+    {
+        auto &pass = m_passes[p];
+        auto  rp   = render_pass(pass);
+        rp->begin();
+        try
+        {
+            pass.execute(*this, *rp);
+        }
+        catch (...)
+        {
+            rp->end();
+            throw;
+        }
+        rp->end();
+    }
+}
+
+void RenderGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+    m_culled   = 0;
+    m_compiled = false;
+}
+
+void RenderGraph::trim()
+{
+    std::set<const Texture *> in_use;
+    for (auto &info : m_resources)
+        if (!info.imported && info.texture)
+            in_use.insert(info.texture);
+
+    std::set<const Texture *> released;
+    for (auto &[key, textures] : m_pool)
+    {
+        for (auto &texture : textures)
+            if (!in_use.count(texture.get()))
+                released.insert(texture.get());
+    }
+
+    // forget the render passes referring to the textures we are about to release
+    for (auto it = m_render_passes.begin(); it != m_render_passes.end();)
+    {
+        auto &targets = it->first.first;
+        if (std::any_of(targets.begin(), targets.end(), [&released](Texture *t) { return released.count(t) > 0; }))
+            it = m_render_passes.erase(it);
+        else
+            ++it;
+    }
+
+    for (auto &[key, textures] : m_pool)
+        textures.erase(std::remove_if(textures.begin(), textures.end(),
+                                      [&released](const std::unique_ptr<Texture> &t) { return released.count(t.get()); }),
+                       textures.end());
+}
+
+Texture *RenderGraph::texture(Resource r) const
+{
+    auto &info = resource(r);
+    if (!info.texture)
+        throw std::runtime_error(fmt::format("RenderGraph::texture(\"{}\"): no texture assigned (was the pass culled, "
+                                             "or the graph not compiled?)",
+                                             info.name));
+    return info.texture;
+}
+
+std::vector<std::string> RenderGraph::schedule() const
+{
+    std::vector<std::string> names;
+    for (int p : m_order)
+        names.push_back(m_passes[p].name);
+    return names;
+}
+
+size_t RenderGraph::pool_bytes() const
+{
+    size_t bytes = 0;
+    for (auto &[key, textures] : m_pool)
+        for (auto &texture : textures)
+            bytes += texture_bytes(texture.get());
+    return bytes;
+}
+
+size_t RenderGraph::unaliased_bytes() const
+{
+    size_t bytes = 0;
+    for (auto &info : m_resources)
+        if (!info.imported && info.texture)
+            bytes += texture_bytes(info.texture);
+    return bytes;
+}
+
+RenderGraph::PoolKey RenderGraph::pool_key(const TextureDesc &desc)
+{
+    return {desc.size.x, desc.size.y, desc.pixel_format, desc.component_format, desc.interpolation};
+}
+
+size_t RenderGraph::texture_bytes(const Texture *texture)
+{
+    return texture->bytes();
+}
+
+const RenderGraph::ResourceInfo &RenderGraph::resource(Resource r) const
+{
+    if (r < 0 || r >= (Resource)m_resources.size())
+        throw std::runtime_error(fmt::format("RenderGraph: invalid resource {}!", r));
+    return m_resources[r];
+}
+
+RenderPass *RenderGraph::render_pass(const Pass &pass)
+{
+    std::vector<Texture *> targets;
+    for (auto w : pass.writes)
+        targets.push_back(m_resources[w].texture);
+
+    // an imported texture may have been resized, or freed and another one created at the same address, since the
+    // pass was created, so its framebuffer is only reused if the attachments are still the same
+    std::vector<std::pair<uint64_t, int2>> identity;
+    for (auto t : targets)
+        identity.push_back({t->serial(), t->size()});
+
+    auto &cached = m_render_passes[{targets, pass.clear}];
+    if (!cached.render_pass || cached.targets != identity)
+    {
+        cached.render_pass.reset(); // before creating the new one, which may have the same targets
+        cached.render_pass = std::make_unique<RenderPass>(targets, nullptr, pass.clear);
+        cached.render_pass->set_cull_mode(RenderPass::CullMode::Disabled);
+        cached.targets = std::move(identity);
+    }
+    return cached.render_pass.get();
+}
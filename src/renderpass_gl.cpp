@@ -1,54 +1,171 @@
 #if defined(HELLOIMGUI_HAS_OPENGL)
 
+#include "capture.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
 #include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
 #include "opengl_check.h"
+#include "profiler.h"
 #include "renderpass.h"
+#include "texture.h"
 
 #include <fmt/core.h>
 #include <stdexcept>
 
+/// Attach a texture (or its renderbuffer) to the framebuffer bound to \p target
+static void attach_texture(GLenum target, GLenum attachment, const Texture *texture)
+{
+    if (texture->texture_handle())
+    {
+        CHK(glFramebufferTexture2D(target, attachment, texture->target(), texture->texture_handle(), 0));
+    }
+    else
+        CHK(glFramebufferRenderbuffer(target, attachment, GL_RENDERBUFFER, texture->renderbuffer_handle()));
+}
+
 RenderPass::RenderPass(bool write_depth, bool clear) :
     m_clear(clear), m_depth_test(write_depth ? DepthTest::Less : DepthTest::Always), m_depth_write(write_depth),
     m_cull_mode(CullMode::Back)
 {
+    capture::Call call(capture::Op::CreateRenderPass, this, m_color_targets, m_depth_target, m_clear, m_depth_write);
+}
+
+RenderPass::RenderPass(const std::vector<Texture *> &color_targets, Texture *depth_target, bool clear) :
+    m_clear(clear), m_depth_test(depth_target ? DepthTest::Less : DepthTest::Always), m_depth_write(depth_target),
+    m_cull_mode(CullMode::Back), m_color_targets(color_targets), m_depth_target(depth_target)
+{
+    if (color_targets.empty() && !depth_target)
+        throw std::runtime_error("RenderPass::RenderPass(): at least one target is required!");
+
+    auto targets = color_targets;
+    if (depth_target)
+        targets.push_back(depth_target);
+    for (auto target : targets)
+    {
+        if (!target)
+            throw std::runtime_error("RenderPass::RenderPass(): render targets must not be null!");
+        if (!(target->flags() & (uint8_t)Texture::TextureFlags::RenderTarget))
+            throw std::runtime_error("RenderPass::RenderPass(): texture was not created with the RenderTarget flag!");
+    }
+
+    CHK(glGenFramebuffers(1, &m_framebuffer_handle));
+
+    uint32_t read_backup = gl_state::framebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t draw_backup = gl_state::framebuffer(GL_DRAW_FRAMEBUFFER);
+    gl_state::bind_framebuffer(GL_FRAMEBUFFER, m_framebuffer_handle);
+
+    auto attach = [this](Texture *texture, GLenum attachment)
+    {
+        attach_texture(GL_FRAMEBUFFER, attachment, texture);
+        m_framebuffer_size = max(m_framebuffer_size, texture->size());
+    };
+
+    std::vector<GLenum> draw_buffers;
+    for (size_t i = 0; i < color_targets.size(); ++i)
+    {
+        attach(color_targets[i], GL_COLOR_ATTACHMENT0 + (GLenum)i);
+        draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+    }
+    if (depth_target)
+        attach(depth_target, GL_DEPTH_ATTACHMENT);
+
+    if (draw_buffers.empty())
+    {
+        GLenum none = GL_NONE;
+        CHK(glDrawBuffers(1, &none));
+        CHK(glReadBuffer(GL_NONE));
+    }
+    else
+        CHK(glDrawBuffers((GLsizei)draw_buffers.size(), draw_buffers.data()));
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, read_backup);
+    gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, draw_backup);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        const char *reason = "unknown";
+        switch (status)
+        {
+        case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: reason = "incomplete attachment"; break;
+        case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: reason = "missing attachment"; break;
+        case GL_FRAMEBUFFER_UNSUPPORTED: reason = "unsupported combination of formats"; break;
+        case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: reason = "inconsistent sample counts"; break;
+        default: break;
+        }
+        CHK(glDeleteFramebuffers(1, &m_framebuffer_handle));
+        gl_state::framebuffer_deleted(m_framebuffer_handle);
+        throw std::runtime_error(fmt::format("RenderPass::RenderPass(): framebuffer is incomplete ({})!", reason));
+    }
+
+    m_viewport_size = m_framebuffer_size;
+
+    // recorded only once the targets have been validated, so that a pass that failed to construct leaves no id behind
+    capture::Call call(capture::Op::CreateRenderPass, this, m_color_targets, m_depth_target, m_clear, m_depth_write);
 }
 
 RenderPass::~RenderPass()
 {
+    capture::Call call(capture::Op::DestroyRenderPass, this);
+    for (auto handle : {m_framebuffer_handle, m_resolve_framebuffer})
+    {
+        if (!handle)
+            continue;
+        CHK(glDeleteFramebuffers(1, &handle));
+        gl_state::framebuffer_deleted(handle);
+    }
 }
 
 void RenderPass::begin()
 {
+    capture::Call call(capture::Op::RenderPassBegin, this);
 #if !defined(NDEBUG)
     if (m_active)
         throw std::runtime_error("RenderPass::begin(): render pass is already active!");
 #endif
     m_active = true;
 
-    CHK(glGetIntegerv(GL_VIEWPORT, &m_viewport_backup[0]));
-    CHK(glGetIntegerv(GL_SCISSOR_BOX, &m_scissor_backup[0]));
-    GLboolean depth_write;
-    CHK(glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_write));
-    m_depth_write_backup = depth_write;
+    static const char *screen_label    = profiler::intern("RenderPass (screen)");
+    static const char *offscreen_label = profiler::intern("RenderPass (offscreen)");
+    m_gpu_zone                         = gpu_timer::begin(m_framebuffer_handle ? offscreen_label : screen_label);
 
-    m_depth_test_backup   = glIsEnabled(GL_DEPTH_TEST);
-    m_scissor_test_backup = glIsEnabled(GL_SCISSOR_TEST);
-    m_cull_face_backup    = glIsEnabled(GL_CULL_FACE);
-    m_blend_backup        = glIsEnabled(GL_BLEND);
+    gl_state::validate("RenderPass::begin()");
+
+    // save the state we are about to change from the shadow, which avoids stalling the pipeline with glGet* queries
+    if (m_framebuffer_handle)
+    {
+        m_framebuffer_backup = gl_state::framebuffer(GL_DRAW_FRAMEBUFFER);
+        gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer_handle);
+    }
+
+    m_viewport_backup     = gl_state::viewport();
+    m_scissor_backup      = gl_state::scissor();
+    m_depth_write_backup  = gl_state::depth_mask();
+    m_depth_test_backup   = gl_state::is_enabled(GL_DEPTH_TEST);
+    m_scissor_test_backup = gl_state::is_enabled(GL_SCISSOR_TEST);
+    m_cull_face_backup    = gl_state::is_enabled(GL_CULL_FACE);
+    m_blend_backup        = gl_state::is_enabled(GL_BLEND);
 
     set_viewport(m_viewport_offset, m_viewport_size);
 
     if (m_clear)
     {
         GLenum what = 0;
-        if (m_depth_write)
+        if (m_depth_write || (m_framebuffer_handle && m_depth_target))
         {
             CHK(glClearDepthf(m_clear_depth));
             what |= GL_DEPTH_BUFFER_BIT;
         }
 
-        CHK(glClearColor(m_clear_color.x, m_clear_color.y, m_clear_color.z, m_clear_color.w));
-        what |= GL_COLOR_BUFFER_BIT;
+        if (!m_framebuffer_handle || !m_color_targets.empty())
+        {
+            CHK(glClearColor(m_clear_color.x, m_clear_color.y, m_clear_color.z, m_clear_color.w));
+            what |= GL_COLOR_BUFFER_BIT;
+        }
+
+        // glClear respects the depth write mask
+        if (what & GL_DEPTH_BUFFER_BIT)
+            gl_state::depth_mask(true);
 
         CHK(glClear(what));
     }
@@ -56,84 +173,167 @@ void RenderPass::begin()
     set_depth_test(m_depth_test, m_depth_write);
     set_cull_mode(m_cull_mode);
 
-    if (m_blend_backup)
-        CHK(glDisable(GL_BLEND));
+    gl_state::set_enabled(GL_BLEND, false);
 }
 
 void RenderPass::end()
 {
+    capture::Call call(capture::Op::RenderPassEnd, this);
 #if !defined(NDEBUG)
     if (!m_active)
         throw std::runtime_error("RenderPass::end(): render pass is not active!");
 #endif
 
-    CHK(glViewport(m_viewport_backup[0], m_viewport_backup[1], m_viewport_backup[2], m_viewport_backup[3]));
-    CHK(glScissor(m_scissor_backup[0], m_scissor_backup[1], m_scissor_backup[2], m_scissor_backup[3]));
+    gl_state::viewport(m_viewport_backup);
+    gl_state::scissor(m_scissor_backup);
 
-    if (m_depth_test_backup)
-        CHK(glEnable(GL_DEPTH_TEST));
-    else
-        CHK(glDisable(GL_DEPTH_TEST));
+    gl_state::set_enabled(GL_DEPTH_TEST, m_depth_test_backup);
 
-    CHK(glDepthMask(m_depth_write_backup));
+    gl_state::depth_mask(m_depth_write_backup);
 
-    if (m_scissor_test_backup)
-        CHK(glEnable(GL_SCISSOR_TEST));
-    else
-        CHK(glDisable(GL_SCISSOR_TEST));
+    gl_state::set_enabled(GL_SCISSOR_TEST, m_scissor_test_backup);
 
-    if (m_cull_face_backup)
-        CHK(glEnable(GL_CULL_FACE));
-    else
-        CHK(glDisable(GL_CULL_FACE));
+    gl_state::set_enabled(GL_CULL_FACE, m_cull_face_backup);
 
-    if (m_blend_backup)
-        CHK(glEnable(GL_BLEND));
-    else
-        CHK(glDisable(GL_BLEND));
+    gl_state::set_enabled(GL_BLEND, m_blend_backup);
+
+    if (m_framebuffer_handle)
+        gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer_backup);
+
+    gl_state::validate("RenderPass::end()");
+
+    gpu_timer::end(m_gpu_zone);
+    m_gpu_zone = -1;
 
     m_active = false;
 }
 
 void RenderPass::resize(const int2 &size)
 {
+    capture::Call call(capture::Op::RenderPassResize, this, size);
+    // the framebuffer object refers to the textures by handle, so it stays valid while they are reallocated
+    for (auto target : m_color_targets)
+        target->resize(size);
+    if (m_depth_target)
+        m_depth_target->resize(size);
+
     m_framebuffer_size = size;
     m_viewport_offset  = int2(0, 0);
     m_viewport_size    = size;
 }
 
+void RenderPass::blit_to(const int2 &src_offset, const int2 &src_size, RenderPass *dst, const int2 &dst_offset)
+{
+    capture::Call call(capture::Op::RenderPassBlitTo, this, src_offset, src_size, dst, dst_offset);
+    if (!m_framebuffer_handle || m_color_targets.empty())
+        throw std::runtime_error("RenderPass::blit_to(): source render pass has no color targets!");
+    if (m_active || dst->m_active)
+        throw std::runtime_error("RenderPass::blit_to(): cannot blit while a render pass is active!");
+
+    uint32_t read_backup = gl_state::framebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t draw_backup = gl_state::framebuffer(GL_DRAW_FRAMEBUFFER);
+
+    gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, m_framebuffer_handle);
+    CHK(glReadBuffer(GL_COLOR_ATTACHMENT0));
+    // a screen render pass draws into whatever framebuffer is currently bound
+    if (dst->m_framebuffer_handle)
+        gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, dst->m_framebuffer_handle);
+
+    // the blit is clipped by the scissor test
+    bool scissor_test = gl_state::is_enabled(GL_SCISSOR_TEST);
+    gl_state::set_enabled(GL_SCISSOR_TEST, false);
+
+    int src_y = m_framebuffer_size.y - src_size.y - src_offset.y;
+    int dst_y = dst->m_framebuffer_size.y - src_size.y - dst_offset.y;
+    CHK(glBlitFramebuffer(src_offset.x, src_y, src_offset.x + src_size.x, src_y + src_size.y, dst_offset.x, dst_y,
+                          dst_offset.x + src_size.x, dst_y + src_size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST));
+
+    gl_state::set_enabled(GL_SCISSOR_TEST, scissor_test);
+    gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, read_backup);
+    gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, draw_backup);
+}
+
+void RenderPass::resolve(Texture *target, size_t index)
+{
+    capture::Call call(capture::Op::RenderPassResolve, this, target, index);
+    if (!m_framebuffer_handle || index >= m_color_targets.size())
+        throw std::runtime_error("RenderPass::resolve(): render pass has no such color target!");
+    if (m_active)
+        throw std::runtime_error("RenderPass::resolve(): cannot resolve while the render pass is active!");
+    if (!target || target->samples() > 1)
+        throw std::runtime_error("RenderPass::resolve(): target must be a single-sample texture!");
+
+    Texture *source = m_color_targets[index];
+    if (source->pixel_format() != target->pixel_format() || source->component_format() != target->component_format())
+        throw std::runtime_error("RenderPass::resolve(): source and target formats must match!");
+
+    const int2 &src = source->size(), &dst = target->size();
+    bool        multisampled = source->samples() > 1;
+    if (multisampled ? src != dst : src.x < dst.x || src.y < dst.y)
+        throw std::runtime_error(fmt::format("RenderPass::resolve(): cannot resolve a {}x{} target into a {}x{} one!",
+                                             src.x, src.y, dst.x, dst.y));
+
+    static const char *label = profiler::intern("RenderPass::resolve");
+    gpu_timer::Scope    timer(label);
+
+    uint32_t read_backup = gl_state::framebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t draw_backup = gl_state::framebuffer(GL_DRAW_FRAMEBUFFER);
+
+    if (!m_resolve_framebuffer)
+        CHK(glGenFramebuffers(1, &m_resolve_framebuffer));
+    gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, m_resolve_framebuffer);
+    attach_texture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target);
+
+    gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, m_framebuffer_handle);
+    CHK(glReadBuffer(GL_COLOR_ATTACHMENT0 + (GLenum)index));
+
+    // the blit is clipped by the scissor test
+    bool scissor_test = gl_state::is_enabled(GL_SCISSOR_TEST);
+    gl_state::set_enabled(GL_SCISSOR_TEST, false);
+
+    // a multisampled blit must not scale, and resolves the samples regardless of the filter
+    CHK(glBlitFramebuffer(0, 0, src.x, src.y, 0, 0, dst.x, dst.y, GL_COLOR_BUFFER_BIT,
+                          multisampled || src == dst ? GL_NEAREST : GL_LINEAR));
+
+    gl_state::set_enabled(GL_SCISSOR_TEST, scissor_test);
+    gl_state::bind_framebuffer(GL_READ_FRAMEBUFFER, read_backup);
+    gl_state::bind_framebuffer(GL_DRAW_FRAMEBUFFER, draw_backup);
+}
+
 void RenderPass::set_clear_color(const float4 &color)
 {
+    capture::Call call(capture::Op::RenderPassClearColor, this, color);
     m_clear_color = color;
 }
 
 void RenderPass::set_clear_depth(float depth)
 {
+    capture::Call call(capture::Op::RenderPassClearDepth, this, depth);
     m_clear_depth = depth;
 }
 
 void RenderPass::set_viewport(const int2 &offset, const int2 &size)
 {
+    capture::Call call(capture::Op::RenderPassViewport, this, offset, size);
     m_viewport_offset = offset;
     m_viewport_size   = size;
 
     if (m_active)
     {
         int ypos = m_framebuffer_size.y - m_viewport_size.y - m_viewport_offset.y;
-        CHK(glViewport(m_viewport_offset.x, ypos, m_viewport_size.x, m_viewport_size.y));
+        gl_state::viewport(int4{m_viewport_offset.x, ypos, m_viewport_size.x, m_viewport_size.y});
         // fmt::print("RenderPass::viewport({}, {}, {}, {})\n", m_viewport_offset.x, ypos, m_viewport_size.x,
         // m_viewport_size.y);
-        CHK(glScissor(m_viewport_offset.x, ypos, m_viewport_size.x, m_viewport_size.y));
+        gl_state::scissor(int4{m_viewport_offset.x, ypos, m_viewport_size.x, m_viewport_size.y});
 
-        if (m_viewport_offset == int2(0, 0) && m_viewport_size == m_framebuffer_size)
-            CHK(glDisable(GL_SCISSOR_TEST));
-        else
-            CHK(glEnable(GL_SCISSOR_TEST));
+        gl_state::set_enabled(GL_SCISSOR_TEST,
+                              !(m_viewport_offset == int2(0, 0) && m_viewport_size == m_framebuffer_size));
     }
 }
 
 void RenderPass::set_depth_test(DepthTest depth_test, bool depth_write)
 {
+    capture::Call call(capture::Op::RenderPassDepthTest, this, depth_test, depth_write);
     m_depth_test  = depth_test;
     m_depth_write = depth_write;
 
@@ -153,35 +353,36 @@ void RenderPass::set_depth_test(DepthTest depth_test, bool depth_write)
             case DepthTest::GreaterEqual: func = GL_GEQUAL; break;
             default: throw std::runtime_error("Shader::set_depth_test(): invalid depth test mode!");
             }
-            CHK(glEnable(GL_DEPTH_TEST));
-            CHK(glDepthFunc(func));
+            gl_state::set_enabled(GL_DEPTH_TEST, true);
+            gl_state::depth_func(func);
         }
         else
         {
-            CHK(glDisable(GL_DEPTH_TEST));
+            gl_state::set_enabled(GL_DEPTH_TEST, false);
         }
-        CHK(glDepthMask(depth_write ? GL_TRUE : GL_FALSE));
+        gl_state::depth_mask(depth_write);
         // fmt::print("RenderPass::set_depth_test({}, {})\n", (int)depth_test, depth_write);
     }
 }
 
 void RenderPass::set_cull_mode(CullMode cull_mode)
 {
+    capture::Call call(capture::Op::RenderPassCullMode, this, cull_mode);
     m_cull_mode = cull_mode;
 
     if (m_active)
     {
         if (cull_mode == CullMode::Disabled)
         {
-            CHK(glDisable(GL_CULL_FACE));
+            gl_state::set_enabled(GL_CULL_FACE, false);
         }
         else
         {
-            CHK(glEnable(GL_CULL_FACE));
+            gl_state::set_enabled(GL_CULL_FACE, true);
             if (cull_mode == CullMode::Front)
-                CHK(glCullFace(GL_FRONT));
+                gl_state::cull_face(GL_FRONT);
             else if (cull_mode == CullMode::Back)
-                CHK(glCullFace(GL_BACK));
+                gl_state::cull_face(GL_BACK);
             else
                 throw std::runtime_error("Shader::set_cull_mode(): invalid cull mode!");
         }
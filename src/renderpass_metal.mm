@@ -4,9 +4,13 @@
 #import <Metal/Metal.h>
 #import <QuartzCore/CAMetalLayer.h>
 
+#include "capture.h"
+#include "gpu_timer.h"
 #include "hello_imgui/internal/backend_impls/rendering_metal.h"
+#include "profiler.h"
 #include "renderpass.h"
 #include "shader.h"
+#include "texture.h"
 
 #include <fmt/core.h>
 
@@ -15,17 +19,47 @@ RenderPass::RenderPass(bool write_depth, bool clear) :
     m_cull_mode(CullMode::Back),
     m_pass_descriptor((__bridge_retained void *)[MTLRenderPassDescriptor renderPassDescriptor])
 {
+    capture::Call call(capture::Op::CreateRenderPass, this, m_color_targets, m_depth_target, m_clear, m_depth_write);
+    set_clear_color(m_clear_color);
+    set_clear_depth(m_clear_depth);
+}
+
+RenderPass::RenderPass(const std::vector<Texture *> &color_targets, Texture *depth_target, bool clear) :
+    m_clear(clear), m_depth_test(depth_target ? DepthTest::Less : DepthTest::Always), m_depth_write(depth_target),
+    m_cull_mode(CullMode::Back), m_color_targets(color_targets), m_depth_target(depth_target),
+    m_pass_descriptor((__bridge_retained void *)[MTLRenderPassDescriptor renderPassDescriptor])
+{
+    if (color_targets.empty() && !depth_target)
+        throw std::runtime_error("RenderPass::RenderPass(): at least one target is required!");
+
+    auto targets = color_targets;
+    if (depth_target)
+        targets.push_back(depth_target);
+    for (auto target : targets)
+    {
+        if (!target)
+            throw std::runtime_error("RenderPass::RenderPass(): render targets must not be null!");
+        if (!(target->flags() & (uint8_t)Texture::TextureFlags::RenderTarget))
+            throw std::runtime_error("RenderPass::RenderPass(): texture was not created with the RenderTarget flag!");
+        m_framebuffer_size = max(m_framebuffer_size, target->size());
+    }
+    m_viewport_size = m_framebuffer_size;
+
+    // recorded only once the targets have been validated, so that a pass that failed to construct leaves no id behind
+    capture::Call call(capture::Op::CreateRenderPass, this, m_color_targets, m_depth_target, m_clear, m_depth_write);
     set_clear_color(m_clear_color);
     set_clear_depth(m_clear_depth);
 }
 
 RenderPass::~RenderPass()
 {
+    capture::Call call(capture::Op::DestroyRenderPass, this);
     (void)(__bridge_transfer MTLRenderPassDescriptor *)m_pass_descriptor;
 }
 
 void RenderPass::begin()
 {
+    capture::Call call(capture::Op::RenderPassBegin, this);
 #if !defined(NDEBUG)
     if (m_active)
         throw std::runtime_error("RenderPass::begin(): render pass is already active!");
@@ -42,11 +76,36 @@ void RenderPass::begin()
     bool clear_manual = false; // m_clear && (m_viewport_offset != int2(0, 0) || m_viewport_size !=
                                // m_framebuffer_size);
 
-    MTLRenderPassAttachmentDescriptor *att = pass_descriptor.colorAttachments[0];
+    MTLLoadAction load_action = m_clear && !clear_manual ? MTLLoadActionClear : MTLLoadActionLoad;
+
+    if (m_color_targets.empty() && !m_depth_target)
+    {
+        MTLRenderPassAttachmentDescriptor *att = pass_descriptor.colorAttachments[0];
+
+        att.texture     = gMetalGlobals.caMetalDrawable.texture;
+        att.loadAction  = load_action;
+        att.storeAction = MTLStoreActionStore;
+    }
+    else
+    {
+        // textures may have been reallocated by resize(), so refresh the attachments on every pass
+        for (size_t i = 0; i < m_color_targets.size(); ++i)
+        {
+            MTLRenderPassAttachmentDescriptor *att = pass_descriptor.colorAttachments[i];
+
+            att.texture     = (__bridge id<MTLTexture>)m_color_targets[i]->texture_handle();
+            att.loadAction  = load_action;
+            att.storeAction = MTLStoreActionStore;
+        }
+        if (m_depth_target)
+        {
+            MTLRenderPassAttachmentDescriptor *att = pass_descriptor.depthAttachment;
 
-    att.texture     = gMetalGlobals.caMetalDrawable.texture;
-    att.loadAction  = m_clear && !clear_manual ? MTLLoadActionClear : MTLLoadActionLoad;
-    att.storeAction = MTLStoreActionStore;
+            att.texture     = (__bridge id<MTLTexture>)m_depth_target->texture_handle();
+            att.loadAction  = load_action;
+            att.storeAction = MTLStoreActionStore;
+        }
+    }
 
     id<MTLRenderCommandEncoder> command_encoder = [command_buffer renderCommandEncoderWithDescriptor:pass_descriptor];
 
@@ -89,6 +148,7 @@ void RenderPass::begin()
 
 void RenderPass::end()
 {
+    capture::Call call(capture::Op::RenderPassEnd, this);
 #if !defined(NDEBUG)
     if (!m_active)
         throw std::runtime_error("RenderPass::end(): render pass is not active!");
@@ -100,6 +160,23 @@ void RenderPass::end()
     id<MTLCommandBuffer>        command_buffer  = (__bridge_transfer id<MTLCommandBuffer>)m_command_buffer;
     id<MTLRenderCommandEncoder> command_encoder = (__bridge_transfer id<MTLRenderCommandEncoder>)m_command_encoder;
     [command_encoder endEncoding];
+
+    if (gpu_timer::enabled())
+    {
+        static const char *screen_label    = profiler::intern("RenderPass (screen)");
+        static const char *offscreen_label = profiler::intern("RenderPass (offscreen)");
+
+        const char *label = m_color_targets.empty() && !m_depth_target ? screen_label : offscreen_label;
+        uint64_t    frame = profiler::frame_index();
+        [command_buffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+          // GPU times are in seconds on the CACurrentMediaTime() clock
+          int64_t cpu_minus_gpu = profiler::now_ns() - (int64_t)(CACurrentMediaTime() * 1e9);
+          profiler::submit(frame, {label, profiler::Source::GPU, 0, 0,
+                                   (int64_t)(buffer.GPUStartTime * 1e9) + cpu_minus_gpu,
+                                   (int64_t)((buffer.GPUEndTime - buffer.GPUStartTime) * 1e9)});
+        }];
+    }
+
     [command_buffer commit];
     m_command_encoder = nullptr;
     m_command_buffer  = nullptr;
@@ -108,13 +185,35 @@ void RenderPass::end()
 
 void RenderPass::resize(const int2 &size)
 {
+    capture::Call call(capture::Op::RenderPassResize, this, size);
+    for (auto target : m_color_targets)
+        target->resize(size);
+    if (m_depth_target)
+        m_depth_target->resize(size);
+
     m_framebuffer_size = size;
     m_viewport_offset  = int2(0, 0);
     m_viewport_size    = size;
 }
 
+void RenderPass::blit_to(const int2 &src_offset, const int2 &src_size, RenderPass *dst, const int2 &dst_offset)
+{
+    capture::Call call(capture::Op::RenderPassBlitTo, this, src_offset, src_size, dst, dst_offset);
+    // the drawable of the CAMetalLayer is framebuffer-only, so this would need to be a textured quad instead
+    throw std::runtime_error("RenderPass::blit_to(): not yet implemented for Metal!");
+}
+
+void RenderPass::resolve(Texture *target, size_t index)
+{
+    capture::Call call(capture::Op::RenderPassResolve, this, target, index);
+    // Metal resolves multisampled attachments at the end of a pass (MTLStoreActionMultisampleResolve), which would
+    // require knowing the resolve target when the pass descriptor is set up
+    throw std::runtime_error("RenderPass::resolve(): not yet implemented for Metal!");
+}
+
 void RenderPass::set_clear_color(const float4 &color)
 {
+    capture::Call call(capture::Op::RenderPassClearColor, this, color);
     m_clear_color = color;
 
 #if !defined(NDEBUG)
@@ -123,11 +222,13 @@ void RenderPass::set_clear_color(const float4 &color)
 #endif
     MTLRenderPassDescriptor *pass_descriptor = (__bridge MTLRenderPassDescriptor *)m_pass_descriptor;
 
-    pass_descriptor.colorAttachments[0].clearColor = MTLClearColorMake(color.x, color.y, color.z, color.w);
+    for (size_t i = 0; i < std::max<size_t>(m_color_targets.size(), 1); ++i)
+        pass_descriptor.colorAttachments[i].clearColor = MTLClearColorMake(color.x, color.y, color.z, color.w);
 }
 
 void RenderPass::set_clear_depth(float depth)
 {
+    capture::Call call(capture::Op::RenderPassClearDepth, this, depth);
     m_clear_depth = depth;
 
 #if !defined(NDEBUG)
@@ -140,6 +241,7 @@ void RenderPass::set_clear_depth(float depth)
 
 void RenderPass::set_viewport(const int2 &offset, const int2 &size)
 {
+    capture::Call call(capture::Op::RenderPassViewport, this, offset, size);
     m_viewport_offset = offset;
     m_viewport_size   = size;
     if (m_active)
@@ -156,6 +258,7 @@ void RenderPass::set_viewport(const int2 &offset, const int2 &size)
 
 void RenderPass::set_depth_test(DepthTest depth_test, bool depth_write)
 {
+    capture::Call call(capture::Op::RenderPassDepthTest, this, depth_test, depth_write);
     m_depth_test  = depth_test;
     m_depth_write = depth_write;
     if (m_active)
@@ -195,6 +298,7 @@ void RenderPass::set_depth_test(DepthTest depth_test, bool depth_write)
 
 void RenderPass::set_cull_mode(CullMode cull_mode)
 {
+    capture::Call call(capture::Op::RenderPassCullMode, this, cull_mode);
     m_cull_mode = cull_mode;
     if (m_active)
     {
@@ -1,9 +1,14 @@
 #include "shader.h"
 
 #include <fmt/core.h>
+#include <fstream>
 #include <sstream>
 
+#include "capture.h"
 #include "hello_imgui/hello_imgui.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+#include "shader_assets.h"
 
 using std::string;
 using std::string_view;
@@ -17,11 +22,60 @@ static const string shader_extensions[] = {".glsl",    ".vs",      ".fs",      "
 #endif
 static const size_t num_extensions = sizeof(shader_extensions) / sizeof(shader_extensions[0]);
 
-string Shader::from_asset(string_view basename)
+static string s_override_dir;
+
+size_t Shader::total_buffer_bytes()
+{
+    return memory_tracker::usage(memory_tracker::Category::Buffers).current;
+}
+
+void Shader::track_buffer_bytes(int64_t delta)
+{
+    m_buffer_bytes = size_t(int64_t(m_buffer_bytes) + delta);
+    memory_tracker::track(m_buffer_allocation, memory_tracker::Category::Buffers, m_name, m_buffer_bytes);
+}
+
+void Shader::track_argument_bytes(int64_t delta)
 {
+    m_argument_bytes = size_t(int64_t(m_argument_bytes) + delta);
+    memory_tracker::track(m_argument_allocation, memory_tracker::Category::Arguments, m_name, m_argument_bytes);
+}
+
+void Shader::set_asset_override_directory(const string &dir)
+{
+    s_override_dir = dir;
+}
+
+// Look up the shader \p basename in the override directory, the embedded table, and finally the assets directory.
+// Embedded shaders are returned without copying; \p storage holds the contents of shaders that had to be read from disk.
+static string_view find_shader(string_view basename, string &storage)
+{
+    if (!s_override_dir.empty())
+    {
+        for (size_t i = 0; i < num_extensions; ++i)
+        {
+            string        filename = s_override_dir + "/" + string(basename) + shader_extensions[i];
+            std::ifstream file(filename, std::ios::binary);
+            if (!file)
+                continue;
+
+            fmt::print("Loading shader from \"{}\"...\n", filename);
+            std::ostringstream oss;
+            oss << file.rdbuf();
+            storage = oss.str();
+            PROFILE_COUNT("File bytes read", storage.size());
+            return storage;
+        }
+    }
+
+    uint64_t basename_hash = shader_name_hash(basename);
+    for (size_t i = 0; i < num_extensions; ++i)
+        if (auto source = find_embedded_shader(basename, shader_extensions[i], basename_hash); !source.empty())
+            return source;
+
     for (size_t i = 0; i < num_extensions; ++i)
     {
-        string filename = basename.data() + shader_extensions[i];
+        string filename = string(basename) + shader_extensions[i];
 
         if (!HelloImGui::AssetExists(filename))
             continue;
@@ -32,14 +86,22 @@ string Shader::from_asset(string_view basename)
         if (shader_txt.data == nullptr)
             throw std::runtime_error(fmt::format("Cannot load shader from file \"{}\"", filename));
 
-        auto source = string((char *)shader_txt.data, shader_txt.dataSize);
+        storage = string((char *)shader_txt.data, shader_txt.dataSize);
+        PROFILE_COUNT("File bytes read", storage.size());
         HelloImGui::FreeAssetFileData(&shader_txt);
-        return source;
+        return storage;
     }
     throw std::runtime_error(fmt::format(
         "Could not find a shader with base filename \"{}\" with any known shader file extensions.", basename));
 }
 
+string Shader::from_asset(string_view basename)
+{
+    PROFILE_SCOPE("Shader::from_asset");
+    string storage;
+    return string(find_shader(basename, storage));
+}
+
 string Shader::prepend_includes(string_view shader_string, const std::vector<string_view> &include_files)
 {
     // if the shader_string is actually a precompiled binary, we can't prepend
@@ -51,8 +113,12 @@ string Shader::prepend_includes(string_view shader_string, const std::vector<str
 
     std::string includes;
 
+    string storage;
     for (auto &i : include_files)
-        includes += from_asset(i) + "\n";
+    {
+        includes += find_shader(i, storage);
+        includes += "\n";
+    }
 
     if (includes.empty())
         return string(shader_string);
@@ -81,24 +147,40 @@ string Shader::prepend_includes(string_view shader_string, const std::vector<str
 
 void Shader::set_buffer_divisor(const string &name, size_t divisor)
 {
+    capture::Call call(capture::Op::ShaderBufferDivisor, this, name, divisor);
     auto it = m_buffers.find(name);
     if (it == m_buffers.end())
         throw std::runtime_error("Shader::set_buffer_divisor(): could not find argument named \"" + name + "\"");
 
-    Buffer &buf          = m_buffers[name];
+    Buffer &buf          = it->second;
     buf.instance_divisor = divisor;
-    buf.dirty            = true;
+    mark_dirty(buf);
 }
 
 void Shader::set_buffer_pointer_offset(const string &name, size_t offset)
 {
+    capture::Call call(capture::Op::ShaderBufferOffset, this, name, offset);
     auto it = m_buffers.find(name);
     if (it == m_buffers.end())
         throw std::runtime_error("Shader::set_buffer_pointer_offset(): could not find argument named \"" + name + "\"");
 
-    Buffer &buf        = m_buffers[name];
+    Buffer &buf        = it->second;
     buf.pointer_offset = offset;
-    buf.dirty          = true;
+    mark_dirty(buf);
+}
+
+void Shader::set_buffer_usage(const string &name, BufferUsage usage)
+{
+    capture::Call call(capture::Op::ShaderBufferUsage, this, name, usage);
+    auto it = m_buffers.find(name);
+    if (it == m_buffers.end())
+        throw std::runtime_error("Shader::set_buffer_usage(): could not find argument named \"" + name + "\"");
+
+    Buffer &buf = it->second;
+    if (buf.type != VertexBuffer && buf.type != IndexBuffer)
+        throw std::runtime_error("Shader::set_buffer_usage(): argument named \"" + name + "\" is not a vertex buffer!");
+
+    buf.usage = usage;
 }
 
 string Shader::Buffer::to_string() const
@@ -2,19 +2,77 @@
 
 #include "hello_imgui/hello_imgui.h"
 #include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
+#include "capture.h"
+#include "draw_list.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
 #include "opengl_check.h"
+#include "profiler.h"
 #include "shader.h"
 #include "texture.h"
 
 #if !defined(GL_HALF_FLOAT)
 #define GL_HALF_FLOAT 0x140B
 #endif
+#if !defined(GL_COMPLETION_STATUS_KHR)
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
+#include <algorithm>
+#include <cstring>
 #include <fmt/core.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 using std::string;
 
-static GLuint compile_gl_shader(GLenum type, const std::string &name, const std::string &shader_string)
+// Index of the lowest set bit in a (non-zero) bitmask
+static inline int lowest_bit(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// Can we ask the driver whether a program has finished compiling/linking without blocking?
+static bool parallel_compile_supported()
+{
+    static const bool supported = gl_extension_supported("GL_KHR_parallel_shader_compile") ||
+                                  gl_extension_supported("GL_ARB_parallel_shader_compile");
+    return supported;
+}
+
+// Can we use persistently mapped buffers (OpenGL 4.4 or ARB_buffer_storage)?
+static bool buffer_storage_supported()
+{
+#if defined(GL_MAP_PERSISTENT_BIT)
+    static const bool supported = gl_version_at_least(4, 4) || gl_extension_supported("GL_ARB_buffer_storage");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Can we reflect shader storage blocks (OpenGL 4.3 or ARB_program_interface_query)?
+static bool program_interface_query_supported()
+{
+#if defined(GL_SHADER_STORAGE_BLOCK)
+    static const bool supported =
+        gl_version_at_least(4, 3) || gl_extension_supported("GL_ARB_program_interface_query");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Hand the source to the driver, but don't query the compile status (which would force the compile to finish)
+static GLuint submit_gl_shader(GLenum type, const std::string &shader_string)
 {
     if (shader_string.empty())
         return (GLuint)0;
@@ -31,6 +89,14 @@ static GLuint compile_gl_shader(GLenum type, const std::string &name, const std:
     CHK(glShaderSource(id, 2, files, nullptr));
     CHK(glCompileShader(id));
 
+    return id;
+}
+
+static void check_gl_shader(GLuint id, GLenum type, const std::string &name)
+{
+    if (id == 0)
+        return;
+
     GLint status;
     CHK(glGetShaderiv(id, GL_COMPILE_STATUS, &status));
 
@@ -44,6 +110,10 @@ static GLuint compile_gl_shader(GLenum type, const std::string &name, const std:
 #ifndef __EMSCRIPTEN__
         else if (type == GL_GEOMETRY_SHADER)
             type_str = "geometry shader";
+#endif
+#if defined(GL_COMPUTE_SHADER)
+        else if (type == GL_COMPUTE_SHADER)
+            type_str = "compute shader";
 #endif
         else
             type_str = "unknown shader type";
@@ -55,36 +125,81 @@ static GLuint compile_gl_shader(GLenum type, const std::string &name, const std:
             std::string("compile_gl_shader(): unable to compile ") + type_str + " \"" + name + "\":\n\n" + error_shader;
         throw std::runtime_error(msg);
     }
-
-    return id;
 }
 
 Shader::Shader(RenderPass *render_pass, const std::string &name, const std::string &vs_source,
                const std::string &fs_source, BlendMode blend_mode) :
+    Shader(render_pass, name, vs_source, fs_source, blend_mode, Async{})
+{
+    finalize();
+}
+
+Shader::Shader(RenderPass *render_pass, const std::string &name, const std::string &vs_source,
+               const std::string &fs_source, BlendMode blend_mode, Async) :
     m_render_pass(render_pass),
     m_name(name), m_blend_mode(blend_mode), m_shader_handle(0)
 {
-    GLuint vertex_shader_handle   = compile_gl_shader(GL_VERTEX_SHADER, name, vs_source),
-           fragment_shader_handle = compile_gl_shader(GL_FRAGMENT_SHADER, name, fs_source);
+    capture::Call call(capture::Op::CreateShader, this, m_render_pass, m_name,
+                       capture::Blob{vs_source.data(), vs_source.size()},
+                       capture::Blob{fs_source.data(), fs_source.size()}, m_blend_mode);
+    m_gpu_label = profiler::intern("Shader \"" + name + "\"");
+
+    m_vertex_shader_handle   = submit_gl_shader(GL_VERTEX_SHADER, vs_source);
+    m_fragment_shader_handle = submit_gl_shader(GL_FRAGMENT_SHADER, fs_source);
 
     m_shader_handle = glCreateProgram();
 
-    GLint status;
-    CHK(glAttachShader(m_shader_handle, vertex_shader_handle));
-    CHK(glAttachShader(m_shader_handle, fragment_shader_handle));
+    CHK(glAttachShader(m_shader_handle, m_vertex_shader_handle));
+    CHK(glAttachShader(m_shader_handle, m_fragment_shader_handle));
     CHK(glLinkProgram(m_shader_handle));
-    CHK(glDeleteShader(vertex_shader_handle));
-    CHK(glDeleteShader(fragment_shader_handle));
+    PROFILE_COUNT("Shader compiles", 1);
+
+#if defined(HELLOIMGUI_USE_GLAD)
+    m_uses_point_size = vs_source.find("gl_PointSize") != std::string::npos;
+#endif
+}
+
+bool Shader::poll()
+{
+    if (m_ready)
+        return true;
+
+    if (parallel_compile_supported())
+    {
+        GLint done = GL_FALSE;
+        CHK(glGetProgramiv(m_shader_handle, GL_COMPLETION_STATUS_KHR, &done));
+        if (done != GL_TRUE)
+            return false;
+    }
+
+    finalize();
+    return true;
+}
+
+void Shader::finalize()
+{
+    GLint status;
     CHK(glGetProgramiv(m_shader_handle, GL_LINK_STATUS, &status));
 
     if (status != GL_TRUE)
     {
+        // a failed link is most often due to a failed compile, which has the more useful log
+        check_gl_shader(m_vertex_shader_handle, GL_VERTEX_SHADER, m_name);
+        check_gl_shader(m_fragment_shader_handle, GL_FRAGMENT_SHADER, m_name);
+#if defined(GL_COMPUTE_SHADER)
+        check_gl_shader(m_compute_shader_handle, GL_COMPUTE_SHADER, m_name);
+#endif
+
         char error_shader[4096];
         CHK(glGetProgramInfoLog(m_shader_handle, sizeof(error_shader), nullptr, error_shader));
-        m_shader_handle = 0;
-        throw std::runtime_error("Shader::Shader(name=\"" + name + "\"): unable to link shader!\n\n" + error_shader);
+        throw std::runtime_error("Shader::Shader(name=\"" + m_name + "\"): unable to link shader!\n\n" + error_shader);
     }
 
+    CHK(glDeleteShader(m_vertex_shader_handle));
+    CHK(glDeleteShader(m_fragment_shader_handle));
+    CHK(glDeleteShader(m_compute_shader_handle));
+    m_vertex_shader_handle = m_fragment_shader_handle = m_compute_shader_handle = 0;
+
     GLint attribute_count, uniform_count;
     CHK(glGetProgramiv(m_shader_handle, GL_ACTIVE_ATTRIBUTES, &attribute_count));
     CHK(glGetProgramiv(m_shader_handle, GL_ACTIVE_UNIFORMS, &uniform_count));
@@ -206,10 +321,54 @@ Shader::Shader(RenderPass *render_pass, const std::string &name, const std::stri
             break;
 
         case GL_SAMPLER_2D:
-            buf.dtype = VariableType::Invalid;
-            buf.ndim  = 0;
-            buf.type  = FragmentTexture;
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_3D:
+            buf.dtype          = VariableType::Invalid;
+            buf.ndim           = 0;
+            buf.type           = FragmentTexture;
+            buf.texture_target = gl_type == GL_SAMPLER_3D         ? GL_TEXTURE_3D
+                                 : gl_type == GL_SAMPLER_2D_ARRAY ? GL_TEXTURE_2D_ARRAY
+                                                                  : GL_TEXTURE_2D;
+            break;
+
+#if defined(GL_IMAGE_2D)
+        case GL_IMAGE_2D:
+        case GL_INT_IMAGE_2D:
+        case GL_UNSIGNED_INT_IMAGE_2D:
+            buf.dtype          = VariableType::Invalid;
+            buf.ndim           = 0;
+            buf.type           = ImageTexture;
+            buf.texture_target = GL_TEXTURE_2D;
+            break;
+
+        case GL_IMAGE_2D_ARRAY:
+        case GL_INT_IMAGE_2D_ARRAY:
+        case GL_UNSIGNED_INT_IMAGE_2D_ARRAY:
+            buf.dtype          = VariableType::Invalid;
+            buf.ndim           = 0;
+            buf.type           = ImageTexture;
+            buf.texture_target = GL_TEXTURE_2D_ARRAY;
+            break;
+
+        case GL_IMAGE_3D:
+        case GL_INT_IMAGE_3D:
+        case GL_UNSIGNED_INT_IMAGE_3D:
+            buf.dtype          = VariableType::Invalid;
+            buf.ndim           = 0;
+            buf.type           = ImageTexture;
+            buf.texture_target = GL_TEXTURE_3D;
+            break;
+#endif
+
+#if defined(GL_SHADER_STORAGE_BLOCK)
+        case GL_SHADER_STORAGE_BLOCK:
+            // untyped: set_buffer() accepts data of any type and shape, as the block's layout is up to the shader
+            buf.dtype    = VariableType::Invalid;
+            buf.ndim     = 1;
+            buf.shape[0] = 0;
+            buf.type     = StorageBuffer;
             break;
+#endif
 
         default:
             throw std::runtime_error("Shader::Shader(): unsupported "
@@ -249,6 +408,21 @@ Shader::Shader(RenderPass *render_pass, const std::string &name, const std::stri
         register_buffer(UniformBuffer, uniform_name, index, type);
     }
 
+#if defined(GL_SHADER_STORAGE_BLOCK)
+    if (program_interface_query_supported())
+    {
+        GLint block_count = 0;
+        CHK(glGetProgramInterfaceiv(m_shader_handle, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &block_count));
+        for (int i = 0; i < block_count; ++i)
+        {
+            char block_name[128];
+            CHK(glGetProgramResourceName(m_shader_handle, GL_SHADER_STORAGE_BLOCK, i, sizeof(block_name), nullptr,
+                                         block_name));
+            register_buffer(UniformBuffer, block_name, i, GL_SHADER_STORAGE_BLOCK);
+        }
+    }
+#endif
+
     Buffer &buf  = m_buffers["indices"];
     buf.index    = -1;
     buf.ndim     = 1;
@@ -256,32 +430,98 @@ Shader::Shader(RenderPass *render_pass, const std::string &name, const std::stri
     buf.shape[1] = buf.shape[2] = 1;
     buf.type                    = IndexBuffer;
     buf.dtype                   = VariableType::UInt32;
+    m_index_buffer              = &buf;
+
+    // flatten the arguments into an array sorted by type, so that begin() can walk just the dirty ones (via a
+    // bitmask, for the first dirty_mask_slots) and the textures can be assigned consecutive texture units
+    m_bindings.clear();
+    for (auto &entry : m_buffers)
+        m_bindings.push_back(&entry);
+    std::sort(m_bindings.begin(), m_bindings.end(),
+              [](const auto *a, const auto *b)
+              { return a->second.type != b->second.type ? a->second.type < b->second.type : a->first < b->first; });
+
+    m_texture_begin = m_texture_end = 0;
+    m_image_begin = m_image_end = 0;
+    m_storage_begin = m_storage_end = 0;
+    m_rebind_mask = 0;
+    for (size_t i = 0; i < m_bindings.size(); ++i)
+    {
+        Buffer &b = m_bindings[i]->second;
+        b.slot    = (int)i;
+
+        // textures, images and storage buffers are each assigned consecutive units/binding points
+        auto extend = [i](size_t &begin, size_t &end)
+        {
+            if (end == 0)
+                begin = i;
+            end = i + 1;
+        };
+        if (b.type == VertexTexture || b.type == FragmentTexture)
+            extend(m_texture_begin, m_texture_end);
+        else if (b.type == ImageTexture)
+            extend(m_image_begin, m_image_end);
+        else if (b.type == StorageBuffer)
+        {
+            extend(m_storage_begin, m_storage_end);
+#if defined(GL_SHADER_STORAGE_BLOCK)
+            CHK(glShaderStorageBlockBinding(m_shader_handle, b.index, (GLuint)(i - m_storage_begin)));
+#endif
+        }
+#if !defined(HELLOIMGUI_USE_GLAD)
+        // without vertex array objects, the attribute and index bindings must be re-specified in every begin()
+        if ((b.type == VertexBuffer || b.type == IndexBuffer) && i < dirty_mask_slots)
+            m_rebind_mask |= uint64_t(1) << i;
+#endif
+    }
 
 #if defined(HELLOIMGUI_USE_GLAD)
     CHK(glGenVertexArrays(1, &m_vertex_array_handle));
-
-    m_uses_point_size = vs_source.find("gl_PointSize") != std::string::npos;
 #endif
+
+    m_ready = true;
 }
 
 Shader::~Shader()
 {
+    capture::Call call(capture::Op::DestroyShader, this);
+    for (auto &[key, buf] : m_buffers)
+    {
+        if (!buf.buffer)
+            continue;
+        if (buf.type == UniformBuffer)
+        {
+            delete[] (uint8_t *)buf.buffer;
+            track_argument_bytes(-int64_t(buf.size));
+        }
+        else if (buf.type == VertexBuffer || buf.type == IndexBuffer || buf.type == StorageBuffer)
+            release_buffer(buf);
+    }
+
+    CHK(glDeleteShader(m_vertex_shader_handle));
+    CHK(glDeleteShader(m_fragment_shader_handle));
+    CHK(glDeleteShader(m_compute_shader_handle));
     CHK(glDeleteProgram(m_shader_handle));
+    gl_state::program_deleted(m_shader_handle);
 #if defined(HELLOIMGUI_USE_GLAD)
     CHK(glDeleteVertexArrays(1, &m_vertex_array_handle));
+    gl_state::vertex_array_deleted(m_vertex_array_handle);
 #endif
 }
 
 void Shader::set_buffer(const std::string &name, VariableType dtype, size_t ndim, const size_t *shape, const void *data)
 {
+    capture::Shape shape_arg{ndim, shape};
+    capture::Call  call(capture::Op::ShaderSetBuffer, this, name, dtype, shape_arg,
+                        capture::Blob{data, type_size(dtype) * shape_arg.count()});
     auto it = m_buffers.find(name);
     if (it == m_buffers.end())
         throw std::runtime_error("Shader::set_buffer(): could not find argument named \"" + name + "\"");
 
-    Buffer &buf = m_buffers[name];
+    Buffer &buf = it->second;
 
-    bool mismatch = ndim != buf.ndim || dtype != buf.dtype;
-    for (size_t i = (buf.type == UniformBuffer ? 0 : 1); i < ndim; ++i)
+    bool mismatch = buf.type != StorageBuffer && (ndim != buf.ndim || dtype != buf.dtype);
+    for (size_t i = (buf.type == UniformBuffer ? 0 : 1); i < ndim && buf.type != StorageBuffer; ++i)
         mismatch |= shape[i] != buf.shape[i];
 
     if (mismatch)
@@ -305,290 +545,448 @@ void Shader::set_buffer(const std::string &name, VariableType dtype, size_t ndim
 
     if (buf.type == UniformBuffer)
     {
+        // re-setting a uniform to its current value is common (e.g. every frame), and shouldn't count as a change
+        if (buf.buffer && buf.size == size && memcmp(buf.buffer, data, size) == 0)
+            return;
+
         if (buf.buffer && buf.size != size)
         {
             delete[] (uint8_t *)buf.buffer;
+            track_argument_bytes(-int64_t(buf.size));
             buf.buffer = nullptr;
         }
         if (!buf.buffer)
+        {
             buf.buffer = new uint8_t[size];
+            track_argument_bytes(int64_t(size));
+        }
         memcpy(buf.buffer, data, size);
     }
     else
     {
-        GLuint buffer_id = 0;
-        if (buf.buffer)
-        {
-            buffer_id = (GLuint)((uintptr_t)buf.buffer);
-        }
-        else
+        GLenum target = GL_ARRAY_BUFFER;
+#if defined(GL_SHADER_STORAGE_BUFFER)
+        if (buf.type == StorageBuffer)
+            target = GL_SHADER_STORAGE_BUFFER;
+#endif
+        if (buf.type == IndexBuffer)
         {
-            CHK(glGenBuffers(1, &buffer_id));
-            buf.buffer = (void *)((uintptr_t)buffer_id);
+            // the element array binding is part of the vertex array object state, so make sure it's ours
+            target = GL_ELEMENT_ARRAY_BUFFER;
+#if defined(HELLOIMGUI_USE_GLAD)
+            gl_state::bind_vertex_array(m_vertex_array_handle);
+#endif
         }
-        GLenum buf_type = (name == "indices") ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
-        CHK(glBindBuffer(buf_type, buffer_id));
-        CHK(glBufferData(buf_type, size, data, GL_DYNAMIC_DRAW));
+        upload_buffer(buf, target, size, data);
     }
 
     buf.dtype = dtype;
     buf.ndim  = ndim;
     buf.size  = size;
-    buf.dirty = true;
+    mark_dirty(buf);
+}
+
+void Shader::upload_buffer(Buffer &buf, uint32_t target, size_t size, const void *data)
+{
+    bool persistent = buf.usage == BufferUsage::Stream && size > 0 && buffer_storage_supported();
+
+    // immutable (persistently mapped) storage can't be resized or respecified, so start over with a new buffer object
+    if (buf.buffer && (buf.mapped || persistent) && (buf.capacity != size || (buf.mapped != nullptr) != persistent))
+        release_buffer(buf);
+
+    GLuint buffer_id = (GLuint)((uintptr_t)buf.buffer);
+    if (!buffer_id)
+    {
+        CHK(glGenBuffers(1, &buffer_id));
+        buf.buffer   = (void *)((uintptr_t)buffer_id);
+        buf.capacity = 0;
+    }
+    CHK(glBindBuffer(target, buffer_id));
+
+    if (persistent)
+    {
+#if defined(GL_MAP_PERSISTENT_BIT)
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        if (!buf.mapped)
+        {
+            CHK(glBufferStorage(target, size * Buffer::ring_regions, nullptr, flags));
+            track_buffer_bytes(int64_t(size * Buffer::ring_regions));
+            CHK(buf.mapped = glMapBufferRange(target, 0, size * Buffer::ring_regions, flags));
+            buf.capacity    = size;
+            buf.ring_region = 0;
+        }
+        else
+        {
+            // fence off the region the draws so far have read from, and wait until the GPU is done with the next one
+            CHK(buf.fences[buf.ring_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+            buf.ring_region = (buf.ring_region + 1) % Buffer::ring_regions;
+            if (GLsync fence = (GLsync)buf.fences[buf.ring_region])
+            {
+                CHK(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED));
+                CHK(glDeleteSync(fence));
+                buf.fences[buf.ring_region] = nullptr;
+            }
+        }
+        buf.ring_offset = buf.ring_region * size;
+        if (data)
+            memcpy((uint8_t *)buf.mapped + buf.ring_offset, data, size);
+#endif
+    }
+    else if (buf.capacity != size)
+    {
+        GLenum usage_gl = buf.usage == BufferUsage::Static    ? GL_STATIC_DRAW
+                          : buf.usage == BufferUsage::Dynamic ? GL_DYNAMIC_DRAW
+                                                              : GL_STREAM_DRAW;
+        CHK(glBufferData(target, size, data, usage_gl));
+        track_buffer_bytes(int64_t(size) - int64_t(buf.capacity));
+        buf.capacity = size;
+    }
+    else if (data)
+    {
+        // orphan the old storage, so the driver can hand us fresh memory instead of waiting for the GPU to finish
+        if (buf.usage == BufferUsage::Stream)
+            CHK(glBufferData(target, size, nullptr, GL_STREAM_DRAW));
+        CHK(glBufferSubData(target, 0, size, data));
+    }
+}
+
+void Shader::release_buffer(Buffer &buf)
+{
+    for (auto &fence : buf.fences)
+    {
+        if (fence)
+            CHK(glDeleteSync((GLsync)fence));
+        fence = nullptr;
+    }
+
+    // deleting a buffer object also unmaps it
+    GLuint buffer_id = (GLuint)((uintptr_t)buf.buffer);
+    CHK(glDeleteBuffers(1, &buffer_id));
+    track_buffer_bytes(-int64_t(buf.mapped ? buf.capacity * Buffer::ring_regions : buf.capacity));
+
+    buf.buffer      = nullptr;
+    buf.mapped      = nullptr;
+    buf.capacity    = 0;
+    buf.ring_offset = 0;
+    buf.ring_region = 0;
 }
 
 void Shader::set_texture(const std::string &name, Texture *texture)
 {
+    capture::Call call(capture::Op::ShaderSetTexture, this, name, texture);
     auto it = m_buffers.find(name);
     if (it == m_buffers.end())
         throw std::runtime_error("Shader::set_texture(): could not find argument named \"" + name + "\"");
-    Buffer &buf = m_buffers[name];
+    Buffer &buf = it->second;
     if (!(buf.type == VertexTexture || buf.type == FragmentTexture))
         throw std::runtime_error("Shader::set_texture(): argument named \"" + name + "\" is not a texture!");
-
-    buf.buffer = (void *)((uintptr_t)texture->texture_handle());
-    buf.dirty  = true;
+    if (buf.texture_target && texture->target() != buf.texture_target)
+        throw std::runtime_error("Shader::set_texture(): texture type does not match the sampler type of \"" + name +
+                                 "\"!");
+
+    void *handle = (void *)((uintptr_t)texture->texture_handle());
+    if (handle != buf.buffer)
+        ++m_revision;
+
+    bool was_bound = buf.buffer != nullptr;
+    buf.buffer     = handle;
+    // the sampler uniform only needs to be set the first time, afterwards the texture unit stays the same
+    if (!was_bound)
+        mark_dirty(buf);
 }
 
 void Shader::begin()
 {
-    int texture_unit = 0;
+    capture::Call call(capture::Op::ShaderBegin, this);
+    PROFILE_SCOPE("Shader::begin");
+    gl_state::use_program(m_shader_handle);
+#if defined(HELLOIMGUI_USE_GLAD)
+    gl_state::bind_vertex_array(m_vertex_array_handle);
+#endif
 
-    CHK(glUseProgram(m_shader_handle));
+    bind_arguments();
 
-#if defined(HELLOIMGUI_USE_GLAD)
-    CHK(glBindVertexArray(m_vertex_array_handle));
+    gl_state::set_enabled(GL_BLEND, m_blend_mode == BlendMode::AlphaBlend);
+    if (m_blend_mode == BlendMode::AlphaBlend)
+        gl_state::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+#ifndef __EMSCRIPTEN__
+    gl_state::set_enabled(GL_PROGRAM_POINT_SIZE, m_uses_point_size);
 #endif
+}
 
-    for (auto &[key, buf] : m_buffers)
+void Shader::bind_arguments()
+{
+    if (!m_all_bound)
     {
-        bool indices = key == "indices";
-        if (!buf.buffer)
+        m_all_bound = true;
+        for (auto *entry : m_bindings)
         {
-            if (!indices)
-                fprintf(stderr,
-                        "Shader::begin(): shader \"%s\" has an unbound "
-                        "argument \"%s\"!\n",
-                        m_name.c_str(), key.c_str());
-            continue;
+            if (entry->second.buffer || entry->second.type == IndexBuffer)
+                continue;
+            fprintf(stderr,
+                    "Shader::begin(): shader \"%s\" has an unbound "
+                    "argument \"%s\"!\n",
+                    m_name.c_str(), entry->first.c_str());
+            m_all_bound = false;
         }
+    }
+
+    for (size_t i = m_texture_begin; i < m_texture_end; ++i)
+    {
+        const Buffer &buf = m_bindings[i]->second;
+        if (buf.buffer)
+            gl_state::bind_texture_to_unit((uint32_t)(i - m_texture_begin), buf.texture_target,
+                                           (GLuint)((uintptr_t)buf.buffer));
+    }
+
+#if defined(GL_IMAGE_2D)
+    // image units and storage buffer binding points are shared by all programs, so these are bound every time
+    for (size_t i = m_image_begin; i < m_image_end; ++i)
+    {
+        const Buffer &buf = m_bindings[i]->second;
+        // array and 3D images are bound in full (layered), so the shader can address every layer/slice
+        GLboolean layered = buf.texture_target != GL_TEXTURE_2D;
+        if (buf.buffer)
+            CHK(glBindImageTexture((GLuint)(i - m_image_begin), (GLuint)((uintptr_t)buf.buffer), 0, layered, 0,
+                                   GL_READ_WRITE, buf.image_format));
+    }
+#endif
 
-        GLuint buffer_id = (GLuint)((uintptr_t)buf.buffer);
-        GLenum gl_type   = 0;
+#if defined(GL_SHADER_STORAGE_BUFFER)
+    for (size_t i = m_storage_begin; i < m_storage_end; ++i)
+    {
+        const Buffer &buf = m_bindings[i]->second;
+        if (buf.buffer && buf.size > 0)
+            CHK(glBindBufferRange(GL_SHADER_STORAGE_BUFFER, (GLuint)(i - m_storage_begin),
+                                  (GLuint)((uintptr_t)buf.buffer), buf.ring_offset, buf.size));
+    }
+#endif
+
+    for (uint64_t dirty = m_dirty | m_rebind_mask; dirty; dirty &= dirty - 1)
+    {
+        auto &[key, buf] = *m_bindings[lowest_bit(dirty)];
+        bind_argument(key, buf);
+    }
+    m_dirty = 0;
 
+    // the slots past the bitmask are rare enough that they are simply walked
+    for (size_t i = dirty_mask_slots; i < m_bindings.size(); ++i)
+    {
+        auto &[key, buf] = *m_bindings[i];
 #if defined(HELLOIMGUI_USE_GLAD)
-        if (!buf.dirty && buf.type != VertexTexture && buf.type != FragmentTexture)
-            continue;
+        bool rebind = false;
+#else
+        bool rebind = buf.type == VertexBuffer || buf.type == IndexBuffer;
 #endif
+        if (buf.dirty || rebind)
+            bind_argument(key, buf);
+    }
+}
+
+void Shader::bind_argument(const std::string &key, Buffer &buf)
+{
+    if (!buf.buffer)
+        return;
+
+    GLuint buffer_id = (GLuint)((uintptr_t)buf.buffer);
+    GLenum gl_type   = 0;
+
+    bool uniform_error = false;
+    switch (buf.type)
+    {
+    case IndexBuffer: CHK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_id)); break;
 
-        bool uniform_error = false;
-        switch (buf.type)
+    case VertexBuffer:
+        CHK(glBindBuffer(GL_ARRAY_BUFFER, buffer_id));
+        CHK(glEnableVertexAttribArray(buf.index));
+
+        switch (buf.dtype)
         {
-        case IndexBuffer: CHK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_id)); break;
+        case VariableType::Int8: gl_type = GL_BYTE; break;
+        case VariableType::UInt8: gl_type = GL_UNSIGNED_BYTE; break;
+        case VariableType::Int16: gl_type = GL_SHORT; break;
+        case VariableType::UInt16: gl_type = GL_UNSIGNED_SHORT; break;
+        case VariableType::Int32: gl_type = GL_INT; break;
+        case VariableType::UInt32: gl_type = GL_UNSIGNED_INT; break;
+        case VariableType::Float16: gl_type = GL_HALF_FLOAT; break;
+        case VariableType::Float32: gl_type = GL_FLOAT; break;
+        default: throw std::runtime_error("Shader::begin(): unsupported vertex buffer type!");
+        }
 
-        case VertexBuffer:
-            CHK(glBindBuffer(GL_ARRAY_BUFFER, buffer_id));
-            CHK(glEnableVertexAttribArray(buf.index));
+        if (buf.ndim != 2)
+            throw std::runtime_error("\"" + m_name + "\": vertex attribute \"" + key +
+                                     "\" has an invalid shapeension (expected ndim=2, got " +
+                                     std::to_string(buf.ndim) + ")");
 
-            switch (buf.dtype)
-            {
-            case VariableType::Int8: gl_type = GL_BYTE; break;
-            case VariableType::UInt8: gl_type = GL_UNSIGNED_BYTE; break;
-            case VariableType::Int16: gl_type = GL_SHORT; break;
-            case VariableType::UInt16: gl_type = GL_UNSIGNED_SHORT; break;
-            case VariableType::Int32: gl_type = GL_INT; break;
-            case VariableType::UInt32: gl_type = GL_UNSIGNED_INT; break;
-            case VariableType::Float16: gl_type = GL_HALF_FLOAT; break;
-            case VariableType::Float32: gl_type = GL_FLOAT; break;
-            default: throw std::runtime_error("Shader::begin(): unsupported vertex buffer type!");
-            }
+        CHK(glVertexAttribPointer(buf.index, (GLint)buf.shape[1], gl_type, GL_FALSE, 0,
+                                  (const void *)(buf.ring_offset + buf.pointer_offset)));
+        CHK(glVertexAttribDivisor(buf.index, (GLuint)buf.instance_divisor));
+        break;
 
-            if (buf.ndim != 2)
-                throw std::runtime_error("\"" + m_name + "\": vertex attribute \"" + key +
-                                         "\" has an invalid shapeension (expected ndim=2, got " +
-                                         std::to_string(buf.ndim) + ")");
+    case VertexTexture:
+    case FragmentTexture: CHK(glUniform1i(buf.index, (GLint)(buf.slot - m_texture_begin))); break;
 
-            CHK(glVertexAttribPointer(buf.index, (GLint)buf.shape[1], gl_type, GL_FALSE, 0,
-                                      (const void *)buf.pointer_offset));
-            CHK(glVertexAttribDivisor(buf.index, (GLuint)buf.instance_divisor));
-            break;
+    case ImageTexture: CHK(glUniform1i(buf.index, (GLint)(buf.slot - m_image_begin))); break;
 
-        case VertexTexture:
-        case FragmentTexture:
-            CHK(glActiveTexture(GL_TEXTURE0 + texture_unit));
-            CHK(glBindTexture(GL_TEXTURE_2D, (GLuint)((uintptr_t)buf.buffer)));
-            if (buf.dirty)
-                CHK(glUniform1i(buf.index, texture_unit));
-            texture_unit++;
-            break;
+    case StorageBuffer: break; // bound above
 
-        case UniformBuffer:
-            if (buf.ndim > 2)
-                throw std::runtime_error("\"" + m_name + "\": uniform attribute \"" + key +
-                                         "\" has an invalid shape (expected ndim=0/1/2, got " +
-                                         std::to_string(buf.ndim) + ")");
-            switch (buf.dtype)
+    case UniformBuffer:
+        if (buf.ndim > 2)
+            throw std::runtime_error("\"" + m_name + "\": uniform attribute \"" + key +
+                                     "\" has an invalid shape (expected ndim=0/1/2, got " +
+                                     std::to_string(buf.ndim) + ")");
+        switch (buf.dtype)
+        {
+        case VariableType::Float32:
+            if (buf.ndim < 2)
             {
-            case VariableType::Float32:
-                if (buf.ndim < 2)
+                const float *v = (const float *)buf.buffer;
+                switch (buf.shape[0])
                 {
-                    const float *v = (const float *)buf.buffer;
-                    switch (buf.shape[0])
-                    {
-                    case 1: CHK(glUniform1f(buf.index, v[0])); break;
-                    case 2: CHK(glUniform2f(buf.index, v[0], v[1])); break;
-                    case 3: CHK(glUniform3f(buf.index, v[0], v[1], v[2])); break;
-                    case 4: CHK(glUniform4f(buf.index, v[0], v[1], v[2], v[3])); break;
-                    default: uniform_error = true; break;
-                    }
+                case 1: CHK(glUniform1f(buf.index, v[0])); break;
+                case 2: CHK(glUniform2f(buf.index, v[0], v[1])); break;
+                case 3: CHK(glUniform3f(buf.index, v[0], v[1], v[2])); break;
+                case 4: CHK(glUniform4f(buf.index, v[0], v[1], v[2], v[3])); break;
+                default: uniform_error = true; break;
                 }
-                else if (buf.ndim == 2 && buf.shape[0] == buf.shape[1])
-                {
-                    const float *v = (const float *)buf.buffer;
-                    switch (buf.shape[0])
-                    {
-                    case 2: CHK(glUniformMatrix2fv(buf.index, 1, GL_FALSE, v)); break;
-                    case 3: CHK(glUniformMatrix3fv(buf.index, 1, GL_FALSE, v)); break;
-                    case 4: CHK(glUniformMatrix4fv(buf.index, 1, GL_FALSE, v)); break;
-                    default: uniform_error = true; break;
-                    }
-                }
-                else
+            }
+            else if (buf.ndim == 2 && buf.shape[0] == buf.shape[1])
+            {
+                const float *v = (const float *)buf.buffer;
+                switch (buf.shape[0])
                 {
-                    uniform_error = true;
+                case 2: CHK(glUniformMatrix2fv(buf.index, 1, GL_FALSE, v)); break;
+                case 3: CHK(glUniformMatrix3fv(buf.index, 1, GL_FALSE, v)); break;
+                case 4: CHK(glUniformMatrix4fv(buf.index, 1, GL_FALSE, v)); break;
+                default: uniform_error = true; break;
                 }
-                break;
+            }
+            else
+            {
+                uniform_error = true;
+            }
+            break;
 
 #if defined(HELLOIMGUI_USE_GLES2) || defined(HELLOIMGUI_USE_GLES3)
-            case VariableType::UInt32:
+        case VariableType::UInt32:
 #endif
-            case VariableType::Int32:
+        case VariableType::Int32:
+        {
+            const int32_t *v = (const int32_t *)buf.buffer;
+            if (buf.ndim < 2)
             {
-                const int32_t *v = (const int32_t *)buf.buffer;
-                if (buf.ndim < 2)
-                {
-                    switch (buf.shape[0])
-                    {
-                    case 1: CHK(glUniform1i(buf.index, v[0])); break;
-                    case 2: CHK(glUniform2i(buf.index, v[0], v[1])); break;
-                    case 3: CHK(glUniform3i(buf.index, v[0], v[1], v[2])); break;
-                    case 4: CHK(glUniform4i(buf.index, v[0], v[1], v[2], v[3])); break;
-                    default: uniform_error = true; break;
-                    }
-                }
-                else
+                switch (buf.shape[0])
                 {
-                    uniform_error = true;
+                case 1: CHK(glUniform1i(buf.index, v[0])); break;
+                case 2: CHK(glUniform2i(buf.index, v[0], v[1])); break;
+                case 3: CHK(glUniform3i(buf.index, v[0], v[1], v[2])); break;
+                case 4: CHK(glUniform4i(buf.index, v[0], v[1], v[2], v[3])); break;
+                default: uniform_error = true; break;
                 }
             }
-            break;
+            else
+            {
+                uniform_error = true;
+            }
+        }
+        break;
 
 #if !defined(HELLOIMGUI_USE_GLES2) && !defined(HELLOIMGUI_USE_GLES3)
-            case VariableType::UInt32:
+        case VariableType::UInt32:
+        {
+            const uint32_t *v = (const uint32_t *)buf.buffer;
+            if (buf.ndim < 2)
             {
-                const uint32_t *v = (const uint32_t *)buf.buffer;
-                if (buf.ndim < 2)
+                switch (buf.shape[0])
                 {
-                    switch (buf.shape[0])
-                    {
-                    case 1: CHK(glUniform1ui(buf.index, v[0])); break;
-                    case 2: CHK(glUniform2ui(buf.index, v[0], v[1])); break;
-                    case 3: CHK(glUniform3ui(buf.index, v[0], v[1], v[2])); break;
-                    case 4: CHK(glUniform4ui(buf.index, v[0], v[1], v[2], v[3])); break;
-                    default: uniform_error = true; break;
-                    }
-                }
-                else
-                {
-                    uniform_error = true;
+                case 1: CHK(glUniform1ui(buf.index, v[0])); break;
+                case 2: CHK(glUniform2ui(buf.index, v[0], v[1])); break;
+                case 3: CHK(glUniform3ui(buf.index, v[0], v[1], v[2])); break;
+                case 4: CHK(glUniform4ui(buf.index, v[0], v[1], v[2], v[3])); break;
+                default: uniform_error = true; break;
                 }
             }
-            break;
+            else
+            {
+                uniform_error = true;
+            }
+        }
+        break;
 #endif
 
-            case VariableType::Bool:
+        case VariableType::Bool:
+        {
+            const uint8_t *v = (const uint8_t *)buf.buffer;
+            if (buf.ndim < 2)
             {
-                const uint8_t *v = (const uint8_t *)buf.buffer;
-                if (buf.ndim < 2)
-                {
-                    switch (buf.shape[0])
-                    {
-                    case 1: CHK(glUniform1i(buf.index, v[0])); break;
-                    case 2: CHK(glUniform2i(buf.index, v[0], v[1])); break;
-                    case 3: CHK(glUniform3i(buf.index, v[0], v[1], v[2])); break;
-                    case 4: CHK(glUniform4i(buf.index, v[0], v[1], v[2], v[3])); break;
-                    default: uniform_error = true; break;
-                    }
-                }
-                else
+                switch (buf.shape[0])
                 {
-                    uniform_error = true;
+                case 1: CHK(glUniform1i(buf.index, v[0])); break;
+                case 2: CHK(glUniform2i(buf.index, v[0], v[1])); break;
+                case 3: CHK(glUniform3i(buf.index, v[0], v[1], v[2])); break;
+                case 4: CHK(glUniform4i(buf.index, v[0], v[1], v[2], v[3])); break;
+                default: uniform_error = true; break;
                 }
             }
-            break;
-
-            default: uniform_error = true; break;
+            else
+            {
+                uniform_error = true;
             }
+        }
+        break;
 
-            if (uniform_error)
-                throw std::runtime_error("\"" + m_name + "\": uniform attribute \"" + key +
-                                         "\" has an unsupported dtype/shape configuration: " + buf.to_string());
-            break;
-
-        default:
-            throw std::runtime_error("\"" + m_name + "\": uniform attribute \"" + key +
-                                     "\" has an unsupported dtype/shape configuration:" + buf.to_string());
+        default: uniform_error = true; break;
         }
 
-        buf.dirty = false;
-    }
+        if (uniform_error)
+            throw std::runtime_error("\"" + m_name + "\": uniform attribute \"" + key +
+                                     "\" has an unsupported dtype/shape configuration: " + buf.to_string());
+        break;
 
-    if (m_blend_mode == BlendMode::AlphaBlend)
-    {
-        CHK(glEnable(GL_BLEND));
-        CHK(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    default:
+        throw std::runtime_error("\"" + m_name + "\": uniform attribute \"" + key +
+                                 "\" has an unsupported dtype/shape configuration:" + buf.to_string());
     }
 
-#ifndef __EMSCRIPTEN__
-    if (m_uses_point_size)
-        CHK(glEnable(GL_PROGRAM_POINT_SIZE));
-#endif
+    buf.dirty = false;
 }
 
 void Shader::end()
 {
-    if (m_blend_mode == BlendMode::AlphaBlend)
-        CHK(glDisable(GL_BLEND));
-#ifndef __EMSCRIPTEN__
-    if (m_uses_point_size)
-        CHK(glDisable(GL_PROGRAM_POINT_SIZE));
-    CHK(glBindVertexArray(0));
-#else
-    for (const auto &[key, buf] : m_buffers)
+    capture::Call call(capture::Op::ShaderEnd, this);
+    // the program, vertex array and blend state are left bound (and tracked by gl_state), so that drawing with the
+    // same shader again does not cause any redundant state changes
+#if defined(__EMSCRIPTEN__)
+    for (const auto *entry : m_bindings)
     {
-        if (buf.type != VertexBuffer)
+        if (entry->second.type != VertexBuffer)
             continue;
-        CHK(glDisableVertexAttribArray(buf.index));
+        CHK(glDisableVertexAttribArray(entry->second.index));
     }
 #endif
-    CHK(glUseProgram(0));
 }
 
-void Shader::draw_array(PrimitiveType primitive_type, size_t offset, size_t count, bool indexed, size_t instances)
+static GLenum gl_primitive_type(Shader::PrimitiveType primitive_type)
 {
-    GLenum primitive_type_gl;
+    using PrimitiveType = Shader::PrimitiveType;
     switch (primitive_type)
     {
-    case PrimitiveType::Point: primitive_type_gl = GL_POINTS; break;
-    case PrimitiveType::Line: primitive_type_gl = GL_LINES; break;
-    case PrimitiveType::LineStrip: primitive_type_gl = GL_LINE_STRIP; break;
-    case PrimitiveType::LineLoop: primitive_type_gl = GL_LINE_LOOP; break;
-    case PrimitiveType::Triangle: primitive_type_gl = GL_TRIANGLES; break;
-    case PrimitiveType::TriangleStrip: primitive_type_gl = GL_TRIANGLE_STRIP; break;
-    case PrimitiveType::TriangleFan: primitive_type_gl = GL_TRIANGLE_FAN; break;
+    case PrimitiveType::Point: return GL_POINTS;
+    case PrimitiveType::Line: return GL_LINES;
+    case PrimitiveType::LineStrip: return GL_LINE_STRIP;
+    case PrimitiveType::LineLoop: return GL_LINE_LOOP;
+    case PrimitiveType::Triangle: return GL_TRIANGLES;
+    case PrimitiveType::TriangleStrip: return GL_TRIANGLE_STRIP;
+    case PrimitiveType::TriangleFan: return GL_TRIANGLE_FAN;
     default: throw std::runtime_error("Shader::draw_array(): invalid primitive type!");
     }
+}
 
+/// Issue one draw call, untimed; \p index_offset is the byte offset of the indices in the bound index buffer
+static void issue_draw(GLenum primitive_type_gl, size_t offset, size_t count, bool indexed, size_t instances,
+                       size_t index_offset)
+{
     if (!indexed)
     {
         if (instances == 0)
@@ -598,12 +996,113 @@ void Shader::draw_array(PrimitiveType primitive_type, size_t offset, size_t coun
     }
     else
     {
+        const void *indices = (const void *)(index_offset + offset * sizeof(uint32_t));
         if (instances == 0)
-            CHK(glDrawElements(primitive_type_gl, (GLsizei)count, GL_UNSIGNED_INT,
-                               (const void *)(offset * sizeof(uint32_t))));
+            CHK(glDrawElements(primitive_type_gl, (GLsizei)count, GL_UNSIGNED_INT, indices));
+        else
+            CHK(glDrawElementsInstanced(primitive_type_gl, (GLsizei)count, GL_UNSIGNED_INT, indices, instances));
+    }
+}
+
+void Shader::draw_array(PrimitiveType primitive_type, size_t offset, size_t count, bool indexed, size_t instances)
+{
+    capture::Call call(capture::Op::ShaderDrawArray, this, primitive_type, offset, count, indexed, instances);
+    gpu_timer::Scope timer(m_gpu_label);
+    issue_draw(gl_primitive_type(primitive_type), offset, count, indexed, instances,
+               indexed ? m_index_buffer->ring_offset : 0);
+}
+
+void Shader::draw(DrawList &list)
+{
+    capture::Call call(capture::Op::ShaderDrawList, this, list.primitive_type(), list.indexed(), list);
+    list.m_calls = 0;
+    if (list.m_commands.empty())
+        return;
+
+    gpu_timer::Scope timer(m_gpu_label);
+
+    GLenum primitive_type_gl = gl_primitive_type(list.primitive_type());
+    bool   indexed           = list.indexed();
+
+#if defined(HELLOIMGUI_USE_GLAD) && defined(GL_DRAW_INDIRECT_BUFFER)
+    static const bool multi_draw_indirect =
+        gl_version_at_least(4, 3) || gl_extension_supported("GL_ARB_multi_draw_indirect");
+
+    if (multi_draw_indirect)
+    {
+        // a Stream index buffer may have moved to another ring region, which is baked into the commands' first index
+        size_t base = indexed ? m_index_buffer->ring_offset / sizeof(uint32_t) : 0;
+        if (list.m_indirect_dirty || list.m_indirect_base != base)
+        {
+            auto &data = list.m_indirect_data;
+            data.clear();
+            for (const auto &cmd : list.m_commands)
+            {
+                // layout of Draw{Arrays,Elements}IndirectCommand
+                data.push_back(cmd.count);
+                data.push_back(cmd.instances);
+                data.push_back(cmd.offset + (uint32_t)base);
+                if (indexed)
+                    data.push_back(0); // base vertex
+                data.push_back(cmd.base_instance);
+            }
+
+            if (!list.m_indirect_buffer)
+                CHK(glGenBuffers(1, &list.m_indirect_buffer));
+            CHK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, list.m_indirect_buffer));
+
+            size_t size = data.size() * sizeof(uint32_t);
+            if (size > list.m_indirect_capacity)
+            {
+                CHK(glBufferData(GL_DRAW_INDIRECT_BUFFER, size, data.data(), GL_DYNAMIC_DRAW));
+                list.m_indirect_capacity = size;
+            }
+            else
+                CHK(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, data.data()));
+
+            list.m_indirect_base  = base;
+            list.m_indirect_dirty = false;
+        }
+        else
+            CHK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, list.m_indirect_buffer));
+
+        if (indexed)
+            CHK(glMultiDrawElementsIndirect(primitive_type_gl, GL_UNSIGNED_INT, nullptr,
+                                            (GLsizei)list.m_commands.size(), 0));
+        else
+            CHK(glMultiDrawArraysIndirect(primitive_type_gl, nullptr, (GLsizei)list.m_commands.size(), 0));
+
+        list.m_calls = 1;
+        return;
+    }
+#endif
+
+    // the whole list is timed once (above), rather than each of its draw calls
+    for (const auto &cmd : list.m_commands)
+    {
+        if (cmd.base_instance == 0)
+            issue_draw(primitive_type_gl, cmd.offset, cmd.count, indexed, cmd.instances,
+                       indexed ? m_index_buffer->ring_offset : 0);
         else
-            CHK(glDrawElementsInstanced(primitive_type_gl, (GLsizei)count, GL_UNSIGNED_INT,
-                                        (const void *)(offset * sizeof(uint32_t)), instances));
+        {
+#if defined(HELLOIMGUI_USE_GLAD) && defined(GL_VERSION_4_2)
+            static const bool base_instance = gl_version_at_least(4, 2);
+            if (!base_instance)
+                throw std::runtime_error("Shader::draw(): base instances require OpenGL 4.2!");
+
+            if (indexed)
+                CHK(glDrawElementsInstancedBaseInstance(
+                    primitive_type_gl, (GLsizei)cmd.count, GL_UNSIGNED_INT,
+                    (const void *)(m_index_buffer->ring_offset + cmd.offset * sizeof(uint32_t)),
+                    (GLsizei)cmd.instances, cmd.base_instance));
+            else
+                CHK(glDrawArraysInstancedBaseInstance(primitive_type_gl, (GLint)cmd.offset, (GLsizei)cmd.count,
+                                                      (GLsizei)cmd.instances, cmd.base_instance));
+#else
+            throw std::runtime_error("Shader::draw(): base instances are not supported by this backend!");
+#endif
+        }
+        list.m_calls++;
     }
 }
 
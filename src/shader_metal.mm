@@ -1,5 +1,8 @@
 #if defined(HELLOIMGUI_HAS_METAL)
 
+#include "capture.h"
+#include "draw_list.h"
+#include "profiler.h"
 #include "renderpass.h"
 #include "shader.h"
 #include "texture.h"
@@ -38,6 +41,7 @@ id<MTLFunction> compile_metal_shader(id<MTLDevice> device, const std::string &na
         MTLCompileOptions *opts = [MTLCompileOptions new];
         library                 = [device newLibraryWithSource:str options:opts error:&error];
         activity                = "compile";
+        PROFILE_COUNT("Shader compiles", 1);
     }
     if (error)
     {
@@ -65,6 +69,9 @@ Shader::Shader(RenderPass *render_pass, const std::string &name, const std::stri
     m_render_pass(render_pass),
     m_name(name), m_blend_mode(blend_mode)
 {
+    capture::Call call(capture::Op::CreateShader, this, m_render_pass, m_name,
+                       capture::Blob{vs_source.data(), vs_source.size()},
+                       capture::Blob{fs_source.data(), fs_source.size()}, m_blend_mode);
     auto           &gMetalGlobals = HelloImGui::GetMetalGlobals();
     id<MTLDevice>   device        = gMetalGlobals.caMetalLayer.device;
     id<MTLFunction> fragment_func = compile_metal_shader(device, name, "fragment", fs_source),
@@ -156,10 +163,25 @@ Shader::Shader(RenderPass *render_pass, const std::string &name, const std::stri
     Buffer &buf = m_buffers["indices"];
     buf.index   = -1;
     buf.type    = IndexBuffer;
+
+    m_ready = true;
+}
+
+// Metal pipeline creation is synchronous, so the asynchronous variant is ready as soon as it returns
+Shader::Shader(RenderPass *render_pass, const std::string &name, const std::string &vs_source,
+               const std::string &fs_source, BlendMode blend_mode, Async) :
+    Shader(render_pass, name, vs_source, fs_source, blend_mode)
+{
+}
+
+bool Shader::poll()
+{
+    return m_ready;
 }
 
 Shader::~Shader()
 {
+    capture::Call call(capture::Op::DestroyShader, this);
     for (const auto &[key, buf] : m_buffers)
     {
         if (!buf.buffer)
@@ -167,9 +189,15 @@ Shader::~Shader()
         if (buf.type == VertexBuffer || buf.type == FragmentBuffer || buf.type == IndexBuffer)
         {
             if (buf.size <= METAL_BUFFER_THRESHOLD)
+            {
                 delete[] (uint8_t *)buf.buffer;
+                track_argument_bytes(-int64_t(buf.size));
+            }
             else
+            {
                 (void)(__bridge_transfer id<MTLBuffer>)buf.buffer;
+                track_buffer_bytes(-int64_t(buf.size));
+            }
         }
         else if (buf.type == VertexTexture || buf.type == FragmentTexture)
             (void)(__bridge_transfer id<MTLTexture>)buf.buffer;
@@ -184,6 +212,9 @@ Shader::~Shader()
 
 void Shader::set_buffer(const std::string &name, VariableType dtype, size_t ndim, const size_t *shape, const void *data)
 {
+    capture::Shape shape_arg{ndim, shape};
+    capture::Call  call(capture::Op::ShaderSetBuffer, this, name, dtype, shape_arg,
+                        capture::Blob{data, type_size(dtype) * shape_arg.count()});
     auto &gMetalGlobals = HelloImGui::GetMetalGlobals();
 
     auto it = m_buffers.find(name);
@@ -200,16 +231,25 @@ void Shader::set_buffer(const std::string &name, VariableType dtype, size_t ndim
     if (buf.buffer && buf.size != size)
     {
         if (buf.size <= METAL_BUFFER_THRESHOLD)
+        {
             delete[] (uint8_t *)buf.buffer;
+            track_argument_bytes(-int64_t(buf.size));
+        }
         else
+        {
             (void)(__bridge_transfer id<MTLBuffer>)buf.buffer;
+            track_buffer_bytes(-int64_t(buf.size));
+        }
         buf.buffer = nullptr;
     }
 
     if (size <= METAL_BUFFER_THRESHOLD && name != "indices")
     {
         if (!buf.buffer)
+        {
             buf.buffer = new uint8_t[size];
+            track_argument_bytes(int64_t(size));
+        }
         memcpy(buf.buffer, data, size);
     }
     else
@@ -221,7 +261,10 @@ void Shader::set_buffer(const std::string &name, VariableType dtype, size_t ndim
         if (buf.buffer)
             mtl_buffer = (__bridge_transfer id<MTLBuffer>)buf.buffer;
         else
+        {
             mtl_buffer = [device newBufferWithLength:size options:MTLResourceStorageModePrivate];
+            track_buffer_bytes(int64_t(size));
+        }
 
         id<MTLBuffer> temp_buffer = [device newBufferWithBytes:data length:size options:MTLResourceStorageModeShared];
 
@@ -240,10 +283,12 @@ void Shader::set_buffer(const std::string &name, VariableType dtype, size_t ndim
     buf.dtype = dtype;
     buf.ndim  = ndim;
     buf.size  = size;
+    ++m_revision;
 }
 
 void Shader::set_texture(const std::string &name, Texture *texture)
 {
+    capture::Call call(capture::Op::ShaderSetTexture, this, name, texture);
     auto it = m_buffers.find(name);
     if (it == m_buffers.end())
         throw std::runtime_error("Shader::set_texture(): could not find argument named \"" + name + "\"");
@@ -258,6 +303,7 @@ void Shader::set_texture(const std::string &name, Texture *texture)
     }
 
     buf.buffer = (__bridge_retained void *)((__bridge id<MTLTexture>)texture->texture_handle());
+    ++m_revision;
 
     std::string sampler_name;
     if (name.length() > 8 && name.compare(name.length() - 8, 8, "_texture") == 0)
@@ -282,6 +328,8 @@ void Shader::set_texture(const std::string &name, Texture *texture)
 
 void Shader::begin()
 {
+    capture::Call call(capture::Op::ShaderBegin, this);
+    PROFILE_SCOPE("Shader::begin");
     id<MTLRenderPipelineState>  pipeline_state = (__bridge id<MTLRenderPipelineState>)m_pipeline_state;
     id<MTLRenderCommandEncoder> command_enc    = (__bridge id<MTLRenderCommandEncoder>)m_render_pass->command_encoder();
 
@@ -331,7 +379,9 @@ void Shader::begin()
             if (buf.size <= METAL_BUFFER_THRESHOLD && !indices)
             {
                 if (buf.type == VertexBuffer)
-                    [command_enc setVertexBytes:buf.buffer length:buf.size atIndex:buf.index];
+                    [command_enc setVertexBytes:(const uint8_t *)buf.buffer + buf.pointer_offset
+                                         length:buf.size - buf.pointer_offset
+                                        atIndex:buf.index];
                 else if (buf.type == FragmentBuffer)
                     [command_enc setFragmentBytes:buf.buffer length:buf.size atIndex:buf.index];
                 else
@@ -341,7 +391,7 @@ void Shader::begin()
             {
                 id<MTLBuffer> buffer = (__bridge id<MTLBuffer>)buf.buffer;
                 if (buf.type == VertexBuffer)
-                    [command_enc setVertexBuffer:buffer offset:0 atIndex:buf.index];
+                    [command_enc setVertexBuffer:buffer offset:buf.pointer_offset atIndex:buf.index];
                 else if (buf.type == FragmentBuffer)
                     [command_enc setFragmentBuffer:buffer offset:0 atIndex:buf.index];
             }
@@ -352,11 +402,13 @@ void Shader::begin()
 
 void Shader::end()
 {
+    capture::Call call(capture::Op::ShaderEnd, this);
     /* No-op */
 }
 
 void Shader::draw_array(PrimitiveType primitive_type, size_t offset, size_t count, bool indexed, size_t instances)
 {
+    capture::Call call(capture::Op::ShaderDrawArray, this, primitive_type, offset, count, indexed, instances);
     MTLPrimitiveType primitive_type_mtl;
     switch (primitive_type)
     {
@@ -385,4 +437,47 @@ void Shader::draw_array(PrimitiveType primitive_type, size_t offset, size_t coun
     }
 }
 
+void Shader::draw(DrawList &list)
+{
+    capture::Call call(capture::Op::ShaderDrawList, this, list.primitive_type(), list.indexed(), list);
+    // Metal has no multi-draw, so issue one draw call per (merged) command
+    list.m_calls = 0;
+    if (list.m_commands.empty())
+        return;
+
+    MTLPrimitiveType primitive_type_mtl;
+    switch (list.primitive_type())
+    {
+    case PrimitiveType::Point: primitive_type_mtl = MTLPrimitiveTypePoint; break;
+    case PrimitiveType::Line: primitive_type_mtl = MTLPrimitiveTypeLine; break;
+    case PrimitiveType::LineStrip: primitive_type_mtl = MTLPrimitiveTypeLineStrip; break;
+    case PrimitiveType::Triangle: primitive_type_mtl = MTLPrimitiveTypeTriangle; break;
+    case PrimitiveType::TriangleStrip: primitive_type_mtl = MTLPrimitiveTypeTriangleStrip; break;
+    default: throw std::runtime_error("Shader::draw(): invalid primitive type!");
+    }
+
+    id<MTLRenderCommandEncoder> command_enc = (__bridge id<MTLRenderCommandEncoder>)m_render_pass->command_encoder();
+    id<MTLBuffer> index_buffer = list.indexed() ? (__bridge id<MTLBuffer>)m_buffers["indices"].buffer : nil;
+
+    for (const auto &cmd : list.m_commands)
+    {
+        if (!list.indexed())
+            [command_enc drawPrimitives:primitive_type_mtl
+                            vertexStart:cmd.offset
+                            vertexCount:cmd.count
+                          instanceCount:cmd.instances
+                           baseInstance:cmd.base_instance];
+        else
+            [command_enc drawIndexedPrimitives:primitive_type_mtl
+                                    indexCount:cmd.count
+                                     indexType:MTLIndexTypeUInt32
+                                   indexBuffer:index_buffer
+                             indexBufferOffset:cmd.offset * 4
+                                 instanceCount:cmd.instances
+                                    baseVertex:0
+                                  baseInstance:cmd.base_instance];
+        list.m_calls++;
+    }
+}
+
 #endif // defined(HELLOIMGUI_HAS_METAL)
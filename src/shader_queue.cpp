@@ -0,0 +1,38 @@
+#include "shader_queue.h"
+
+Shader *ShaderQueue::submit(RenderPass *render_pass, const std::string &name, const std::string &vs_source,
+                            const std::string &fs_source, Shader::BlendMode blend_mode, ReadyCallback on_ready)
+{
+    auto shader = new Shader(render_pass, name, vs_source, fs_source, blend_mode, Shader::Async{});
+    m_pending.push_back({shader, std::move(on_ready)});
+    return shader;
+}
+
+size_t ShaderQueue::poll()
+{
+    for (size_t i = 0; i < m_pending.size();)
+    {
+        bool done = false;
+        try
+        {
+            done = m_pending[i].shader->poll();
+        }
+        catch (...)
+        {
+            m_pending.erase(m_pending.begin() + i);
+            throw;
+        }
+
+        if (!done)
+        {
+            ++i;
+            continue;
+        }
+
+        Entry entry = std::move(m_pending[i]);
+        m_pending.erase(m_pending.begin() + i);
+        if (entry.on_ready)
+            entry.on_ready(entry.shader);
+    }
+    return m_pending.size();
+}
@@ -0,0 +1,147 @@
+#include "startup.h"
+
+#include "hello_imgui/hello_imgui.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fmt/core.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+using namespace startup;
+using Clock = std::chrono::steady_clock;
+
+static std::vector<Phase> s_phases;
+static std::vector<Event> s_events;
+static Clock::time_point  s_origin;
+static std::string        s_current;     ///< name of the phase in progress (empty if none)
+static Clock::time_point  s_current_start;
+static double             s_current_cpu = 0.0;
+static bool               s_started     = false;
+static bool               s_finished    = false;
+
+/// Return the CPU time used by the process so far, in milliseconds
+static double cpu_ms()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    auto ticks = [](const FILETIME &t) { return (uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) * 1e-4; // 100 ns ticks
+#else
+    timespec t;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) != 0)
+        return 0.0;
+    return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+#endif
+}
+
+static double since_origin_ms(Clock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(t - s_origin).count();
+}
+
+/// End the phase in progress (if any) at \p now
+static void end_current(Clock::time_point now, double cpu)
+{
+    if (s_current.empty())
+        return;
+    s_phases.push_back({std::move(s_current), since_origin_ms(s_current_start),
+                        std::chrono::duration<double, std::milli>(now - s_current_start).count(), cpu - s_current_cpu});
+    s_current.clear();
+}
+
+namespace startup
+{
+
+void phase(const std::string &name)
+{
+    if (s_finished)
+        return;
+
+    auto   now = Clock::now();
+    double cpu = cpu_ms();
+    if (!s_started)
+    {
+        s_origin  = now;
+        s_started = true;
+    }
+    end_current(now, cpu);
+    s_current       = name;
+    s_current_start = now;
+    s_current_cpu   = cpu;
+}
+
+void event(const std::string &name)
+{
+    if (s_finished || !s_started)
+        return;
+    s_events.push_back({name, since_origin_ms(Clock::now())});
+}
+
+void finish()
+{
+    if (s_finished || !s_started)
+        return;
+    end_current(Clock::now(), cpu_ms());
+    s_finished = true;
+
+    std::string list;
+    for (auto &p : s_phases)
+        list += fmt::format("\n\t{:>8.1f} ms ({:>5.1f}%, CPU {:>8.1f} ms): {}", p.wall_ms,
+                            100.0 * p.wall_ms / std::max(total_ms(), 1e-9), p.cpu_ms, p.name);
+    for (auto &e : s_events)
+        list += fmt::format("\n\t{} at {:.1f} ms", e.name, e.time_ms);
+    HelloImGui::Log(HelloImGui::LogLevel::Info, "First frame presented after %.1f ms:%s", total_ms(), list.c_str());
+}
+
+bool finished()
+{
+    return s_finished;
+}
+
+const std::vector<Phase> &phases()
+{
+    return s_phases;
+}
+
+const std::vector<Event> &events()
+{
+    return s_events;
+}
+
+double total_ms()
+{
+    return s_phases.empty() ? 0.0 : s_phases.back().start_ms + s_phases.back().wall_ms;
+}
+
+std::string to_json()
+{
+    double cpu = 0.0;
+    for (auto &p : s_phases)
+        cpu += p.cpu_ms;
+
+    std::string out =
+        fmt::format("{{\n  \"total_ms\": {:.3f},\n  \"cpu_ms\": {:.3f},\n  \"phases\": [", total_ms(), cpu);
+    for (size_t i = 0; i < s_phases.size(); ++i)
+    {
+        auto &p = s_phases[i];
+        out += fmt::format("{}\n    {{\"name\": {}, \"start_ms\": {:.3f}, \"wall_ms\": {:.3f}, \"cpu_ms\": {:.3f}}}",
+                           i ? "," : "", trace::json_string(p.name), p.start_ms, p.wall_ms, p.cpu_ms);
+    }
+    out += "\n  ],\n  \"events\": [";
+    for (size_t i = 0; i < s_events.size(); ++i)
+        out += fmt::format("{}\n    {{\"name\": {}, \"time_ms\": {:.3f}}}", i ? "," : "",
+                           trace::json_string(s_events[i].name), s_events[i].time_ms);
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+} // namespace startup
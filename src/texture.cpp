@@ -1,4 +1,12 @@
 #include "texture.h"
+#include "capture.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fmt/core.h>
 #include <memory>
 
 #define STB_IMAGE_STATIC
@@ -6,6 +14,21 @@
 #include "stb_image.h"
 #undef STB_IMAGE_IMPLEMENTATION
 
+/// Record the creation of \p texture in the capture (if any), once its format is final
+static void capture_created(const Texture *texture, bool manual_mipmapping)
+{
+    capture::Call call(capture::Op::CreateTexture, texture, texture->type(), texture->pixel_format(),
+                       texture->component_format(), texture->size(), texture->depth(),
+                       texture->min_interpolation_mode(), texture->mag_interpolation_mode(), texture->wrap_mode(),
+                       texture->samples(), texture->flags(), manual_mipmapping);
+}
+
+uint64_t Texture::next_serial()
+{
+    static std::atomic<uint64_t> s_last{0};
+    return ++s_last;
+}
+
 Texture::Texture(PixelFormat pixel_format, ComponentFormat component_format, const int2 &size,
                  InterpolationMode min_interpolation_mode, InterpolationMode mag_interpolation_mode, WrapMode wrap_mode,
                  uint8_t samples, uint8_t flags, bool manual_mipmapping) :
@@ -15,14 +38,34 @@ Texture::Texture(PixelFormat pixel_format, ComponentFormat component_format, con
     m_size(size), m_manual_mipmapping(manual_mipmapping)
 {
     init();
+    capture_created(this, manual_mipmapping);
+}
+
+Texture::Texture(TextureType type, PixelFormat pixel_format, ComponentFormat component_format, const int3 &size,
+                 InterpolationMode min_interpolation_mode, InterpolationMode mag_interpolation_mode, WrapMode wrap_mode,
+                 bool manual_mipmapping) :
+    m_pixel_format(pixel_format),
+    m_component_format(component_format), m_min_interpolation_mode(min_interpolation_mode),
+    m_mag_interpolation_mode(mag_interpolation_mode), m_wrap_mode(wrap_mode), m_samples(1),
+    m_flags(TextureFlags::ShaderRead), m_size(size.x, size.y), m_manual_mipmapping(manual_mipmapping), m_type(type),
+    m_depth(size.z)
+{
+    if (size.z < 1)
+        throw std::runtime_error("Texture::Texture(): the number of layers/slices must be at least 1!");
+    if (type == TextureType::Texture2D && size.z != 1)
+        throw std::runtime_error("Texture::Texture(): 2D textures must have a single layer!");
+    init();
+    capture_created(this, manual_mipmapping);
 }
 
 Texture::Texture(const std::string &filename, InterpolationMode min_interpolation_mode,
                  InterpolationMode mag_interpolation_mode, WrapMode wrap_mode) :
     m_component_format(ComponentFormat::Float32),
     m_min_interpolation_mode(min_interpolation_mode), m_mag_interpolation_mode(mag_interpolation_mode),
-    m_wrap_mode(wrap_mode), m_samples(1), m_flags(TextureFlags::ShaderRead), m_manual_mipmapping(false)
+    m_wrap_mode(wrap_mode), m_samples(1), m_flags(TextureFlags::ShaderRead), m_manual_mipmapping(false),
+    m_name(filename)
 {
+    PROFILE_SCOPE("Texture::load");
     int n = 0;
     stbi_ldr_to_hdr_scale(1.0f);
     stbi_ldr_to_hdr_gamma(1.0f);
@@ -31,6 +74,12 @@ Texture::Texture(const std::string &filename, InterpolationMode min_interpolatio
     if (!texture_data)
         throw std::runtime_error("Could not load texture data from file \"" + filename +
                                  "\". Reason: " + stbi_failure_reason());
+    memory_tracker::Scoped decoded(memory_tracker::Category::Images, filename,
+                                   (size_t)m_size.x * m_size.y * 4 * sizeof(float));
+
+    std::error_code ec;
+    if (auto file_size = std::filesystem::file_size(filename, ec); !ec)
+        PROFILE_COUNT("File bytes read", file_size);
 
     n = 4;
     switch (n)
@@ -45,6 +94,7 @@ Texture::Texture(const std::string &filename, InterpolationMode min_interpolatio
     init();
     if (m_pixel_format != pixel_format)
         throw std::runtime_error("Texture::Texture(): pixel format not supported by the hardware!");
+    capture_created(this, false);
     upload((const uint8_t *)texture_data.get());
 }
 
@@ -52,21 +102,15 @@ Texture::Texture(const std::string &filename, std::string_view data, Interpolati
                  InterpolationMode mag_interpolation_mode, WrapMode wrap_mode) :
     m_component_format(ComponentFormat::Float32),
     m_min_interpolation_mode(min_interpolation_mode), m_mag_interpolation_mode(mag_interpolation_mode),
-    m_wrap_mode(wrap_mode), m_samples(1), m_flags(TextureFlags::ShaderRead), m_manual_mipmapping(false)
+    m_wrap_mode(wrap_mode), m_samples(1), m_flags(TextureFlags::ShaderRead), m_manual_mipmapping(false),
+    m_name(filename)
 {
-    int n = 0;
-    stbi_ldr_to_hdr_scale(1.0f);
-    stbi_ldr_to_hdr_gamma(1.0f);
-    using Holder = std::unique_ptr<float[], void (*)(void *)>;
+    PROFILE_SCOPE("Texture::load");
+    auto                   texture_data = decode_float(filename, data, m_size);
+    memory_tracker::Scoped decoded(memory_tracker::Category::Images, filename,
+                                   (size_t)m_size.x * m_size.y * 4 * sizeof(float));
 
-    Holder texture_data(
-        stbi_loadf_from_memory((const stbi_uc *)data.begin(), data.length(), &m_size.x, &m_size.y, &n, 4),
-        stbi_image_free);
-    if (!texture_data)
-        throw std::runtime_error("Could not load texture data from file \"" + filename +
-                                 "\". Reason: " + stbi_failure_reason());
-
-    n = 4;
+    int n = 4;
     switch (n)
     {
     case 1: m_pixel_format = PixelFormat::R; break;
@@ -79,13 +123,50 @@ Texture::Texture(const std::string &filename, std::string_view data, Interpolati
     init();
     if (m_pixel_format != pixel_format)
         throw std::runtime_error("Texture::Texture(): pixel format not supported by the hardware!");
+    capture_created(this, false);
     upload((const uint8_t *)texture_data.get());
 }
 
+bool Texture::is_hdr(std::string_view data)
+{
+    return stbi_is_hdr_from_memory((const stbi_uc *)data.data(), (int)data.size());
+}
+
+Texture::DecodedImage<float> Texture::decode_float(const std::string &filename, std::string_view data, int2 &size)
+{
+    int n = 0;
+    stbi_ldr_to_hdr_scale(1.0f);
+    stbi_ldr_to_hdr_gamma(1.0f);
+    DecodedImage<float> image(
+        stbi_loadf_from_memory((const stbi_uc *)data.data(), (int)data.size(), &size.x, &size.y, &n, 4),
+        stbi_image_free);
+    if (!image)
+        throw std::runtime_error("Could not load texture data from file \"" + filename +
+                                 "\". Reason: " + stbi_failure_reason());
+    return image;
+}
+
+Texture::DecodedImage<uint8_t> Texture::decode_uint8(const std::string &filename, std::string_view data, int2 &size)
+{
+    int                   n = 0;
+    DecodedImage<uint8_t> image(
+        stbi_load_from_memory((const stbi_uc *)data.data(), (int)data.size(), &size.x, &size.y, &n, 4),
+        stbi_image_free);
+    if (!image)
+        throw std::runtime_error("Could not load texture data from file \"" + filename +
+                                 "\". Reason: " + stbi_failure_reason());
+    return image;
+}
+
 size_t Texture::bytes_per_pixel() const
+{
+    return bytes_per_pixel(m_pixel_format, m_component_format);
+}
+
+size_t Texture::bytes_per_pixel(PixelFormat pixel_format, ComponentFormat component_format)
 {
     size_t result = 0;
-    switch (m_component_format)
+    switch (component_format)
     {
     case ComponentFormat::UInt8: result = 1; break;
     case ComponentFormat::Int8: result = 1; break;
@@ -98,13 +179,18 @@ size_t Texture::bytes_per_pixel() const
     default: throw std::runtime_error("Texture::bytes_per_pixel(): invalid component format!");
     }
 
-    return result * channels();
+    return result * channels(pixel_format);
 }
 
 size_t Texture::channels() const
+{
+    return channels(m_pixel_format);
+}
+
+size_t Texture::channels(PixelFormat pixel_format)
 {
     size_t result = 1;
-    switch (m_pixel_format)
+    switch (pixel_format)
     {
     case PixelFormat::R: result = 1; break;
     case PixelFormat::RA: result = 2; break;
@@ -118,3 +204,62 @@ size_t Texture::channels() const
     }
     return result;
 }
+
+void Texture::flip_rows(uint8_t *data, const int2 &size, size_t bytes_per_pixel)
+{
+    size_t                     stride = bytes_per_pixel * size.x;
+    std::unique_ptr<uint8_t[]> temp(new uint8_t[stride]);
+
+    uint8_t *low = data, *high = low + (size.y - 1) * stride;
+
+    for (; low < high; low += stride, high -= stride)
+    {
+        memcpy(temp.get(), low, stride);
+        memcpy(low, high, stride);
+        memcpy(high, temp.get(), stride);
+    }
+}
+
+size_t Texture::allocated_bytes() const
+{
+    size_t result = bytes();
+    if (m_samples > 1 || (m_min_interpolation_mode != InterpolationMode::Trilinear &&
+                          m_mag_interpolation_mode != InterpolationMode::Trilinear))
+        return result;
+
+    // add the smaller levels of the mipmap chain (3D textures shrink in depth too, array textures don't)
+    int3 size{m_size.x, m_size.y, m_depth};
+    while (size.x > 1 || size.y > 1 || (m_type == TextureType::Texture3D && size.z > 1))
+    {
+        size = int3{std::max(size.x / 2, 1), std::max(size.y / 2, 1),
+                    m_type == TextureType::Texture3D ? std::max(size.z / 2, 1) : size.z};
+        result += bytes_per_pixel() * size.x * size.y * size.z;
+    }
+    return result;
+}
+
+size_t Texture::total_bytes()
+{
+    return memory_tracker::usage(memory_tracker::Category::Textures).current +
+           memory_tracker::usage(memory_tracker::Category::RenderTargets).current;
+}
+
+void Texture::set_name(const std::string &name)
+{
+    m_name = name;
+    memory_tracker::rename(m_allocation, name);
+}
+
+void Texture::track_bytes(size_t bytes)
+{
+    if (m_allocation || bytes == 0)
+    {
+        memory_tracker::track(m_allocation, {}, {}, bytes);
+        return;
+    }
+
+    auto category = m_flags & TextureFlags::RenderTarget ? memory_tracker::Category::RenderTargets
+                                                         : memory_tracker::Category::Textures;
+    memory_tracker::track(m_allocation, category,
+                          m_name.empty() ? fmt::format("Unnamed {}x{} texture", m_size.x, m_size.y) : m_name, bytes);
+}
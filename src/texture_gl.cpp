@@ -1,10 +1,16 @@
 #if defined(HELLOIMGUI_HAS_OPENGL)
 
+#include "capture.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
 #include "hello_imgui/hello_imgui_include_opengl.h" // cross-platform way to include OpenGL headers
 #include "opengl_check.h"
+#include "profiler.h"
+#include "renderpass.h"
 
 #include "texture.h"
-#include <memory>
+#include <algorithm>
+#include <map>
 
 #if !defined(GL_HALF_FLOAT)
 #define GL_HALF_FLOAT 0x140B
@@ -51,14 +57,9 @@
 #define GL_DEPTH_COMPONENT32F 0x8CAC
 #endif
 
-static void gl_map_texture_format(Texture::PixelFormat &pixel_format, Texture::ComponentFormat &component_format,
-                                  GLenum &pixel_format_gl, GLenum &component_format_gl, GLenum &internal_format_gl);
-
 void Texture::init()
 {
-#if defined(__EMSCRIPTEN__)
-    m_samples = 1;
-#endif
+    m_samples = (uint8_t)std::clamp((int)m_samples, 1, max_samples(m_pixel_format, m_component_format, m_flags));
 
     GLuint interpolation_mode_gl[2];
     for (int i = 0; i < 2; ++i)
@@ -83,21 +84,28 @@ void Texture::init()
 
     GLenum pixel_format_gl, component_format_gl, internal_format_gl;
 
-    gl_map_texture_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+    gl_map_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+    m_internal_format = internal_format_gl;
 
     (void)pixel_format_gl;
     (void)component_format_gl;
 
-    GLenum tex_mode = m_samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    GLenum tex_mode = target();
 
     if (m_flags & (uint8_t)TextureFlags::ShaderRead)
     {
         CHK(glGenTextures(1, &m_texture_handle));
-        CHK(glBindTexture(tex_mode, m_texture_handle));
-        CHK(glTexParameteri(tex_mode, GL_TEXTURE_MIN_FILTER, interpolation_mode_gl[0]));
-        CHK(glTexParameteri(tex_mode, GL_TEXTURE_MAG_FILTER, interpolation_mode_gl[1]));
-        CHK(glTexParameteri(tex_mode, GL_TEXTURE_WRAP_S, wrap_mode_gl));
-        CHK(glTexParameteri(tex_mode, GL_TEXTURE_WRAP_T, wrap_mode_gl));
+        gl_state::bind_texture(tex_mode, m_texture_handle);
+        // multisampled textures are read with texelFetch() and have no sampler state
+        if (m_samples == 1)
+        {
+            CHK(glTexParameteri(tex_mode, GL_TEXTURE_MIN_FILTER, interpolation_mode_gl[0]));
+            CHK(glTexParameteri(tex_mode, GL_TEXTURE_MAG_FILTER, interpolation_mode_gl[1]));
+            CHK(glTexParameteri(tex_mode, GL_TEXTURE_WRAP_S, wrap_mode_gl));
+            CHK(glTexParameteri(tex_mode, GL_TEXTURE_WRAP_T, wrap_mode_gl));
+            if (m_type == TextureType::Texture3D)
+                CHK(glTexParameteri(tex_mode, GL_TEXTURE_WRAP_R, wrap_mode_gl));
+        }
 
         if (m_flags & (uint8_t)TextureFlags::RenderTarget)
             upload(nullptr);
@@ -106,15 +114,13 @@ void Texture::init()
     {
         CHK(glGenRenderbuffers(1, &m_renderbuffer_handle));
         CHK(glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer_handle));
-#if defined(HELLOIMGUI_USE_GLAD)
+        // (GLES 3 / WebGL 2 support multisampled renderbuffers too)
         if (m_samples == 1)
             CHK(glRenderbufferStorage(GL_RENDERBUFFER, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y));
         else
             CHK(glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, internal_format_gl, (GLsizei)m_size.x,
                                                  (GLsizei)m_size.y));
-#else
-        CHK(glRenderbufferStorage(GL_RENDERBUFFER, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y));
-#endif
+        track_bytes(allocated_bytes());
     }
     else
     {
@@ -124,23 +130,44 @@ void Texture::init()
 
 Texture::~Texture()
 {
+    capture::Call call(capture::Op::DestroyTexture, this);
+    track_bytes(0);
     CHK(glDeleteTextures(1, &m_texture_handle));
+    gl_state::texture_deleted(m_texture_handle);
     CHK(glDeleteRenderbuffers(1, &m_renderbuffer_handle));
 }
 
+/// Report the number of bytes uploaded to a texture to the profiler
+static void count_upload(size_t bytes)
+{
+    static const char *label = profiler::intern("Texture upload bytes");
+    profiler::count(label, (int64_t)bytes);
+}
+
 void Texture::upload(const uint8_t *data)
 {
+    capture::Call call(capture::Op::TextureUpload, this,
+                       capture::Blob{data, bytes_per_pixel() * m_size.x * m_size.y * m_depth});
+    ++m_revision;
     if (m_samples > 1 && data != nullptr)
-        throw std::runtime_error("Texture::upload(): only implemented for samples=1!");
+        throw std::runtime_error(
+            "Texture::upload(): cannot upload to a multisampled texture, render into it and resolve() it instead!");
+
+    static const char *label = profiler::intern("Texture::upload");
+    profiler::Scope     cpu_timer(label);
+    gpu_timer::Scope    timer(label);
+
+    if (data)
+        count_upload(bytes());
 
     GLenum pixel_format_gl, component_format_gl, internal_format_gl;
 
-    gl_map_texture_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+    gl_map_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
 
     if (m_texture_handle != 0)
     {
-        GLenum tex_mode = m_samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
-        CHK(glBindTexture(tex_mode, m_texture_handle));
+        GLenum tex_mode = target();
+        gl_state::bind_texture(tex_mode, m_texture_handle);
 
         if (data)
             CHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
@@ -152,45 +179,62 @@ void Texture::upload(const uint8_t *data)
             CHK(glPixelStorei(GL_UNPACK_SKIP_ROWS, 0));
             CHK(glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0));
         }
+#endif
 
-        if (m_samples == 1)
+        if (m_type != TextureType::Texture2D)
+            CHK(glTexImage3D(tex_mode, 0, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y, (GLsizei)m_depth,
+                             0, pixel_format_gl, component_format_gl, data));
+#if defined(HELLOIMGUI_USE_GLAD)
+        else if (m_samples == 1)
             CHK(glTexImage2D(tex_mode, 0, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y, 0, pixel_format_gl,
                              component_format_gl, data));
         else
             CHK(glTexImage2DMultisample(tex_mode, m_samples, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y,
                                         false));
 #else
-        CHK(glTexImage2D(tex_mode, 0, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y, 0, pixel_format_gl,
-                         component_format_gl, data));
+        else
+            CHK(glTexImage2D(tex_mode, 0, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y, 0,
+                             pixel_format_gl, component_format_gl, data));
 #endif
 
-        if (!m_manual_mipmapping && (m_min_interpolation_mode == InterpolationMode::Trilinear ||
-                                     m_mag_interpolation_mode == InterpolationMode::Trilinear))
+        if (m_samples == 1 && !m_manual_mipmapping &&
+            (m_min_interpolation_mode == InterpolationMode::Trilinear ||
+             m_mag_interpolation_mode == InterpolationMode::Trilinear))
             generate_mipmap();
     }
     else
     {
-#if defined(HELLOIMGUI_USE_GLAD)
         CHK(glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer_handle));
         if (m_samples == 1)
             CHK(glRenderbufferStorage(GL_RENDERBUFFER, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y));
         else
             CHK(glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, internal_format_gl, (GLsizei)m_size.x,
                                                  (GLsizei)m_size.y));
-#else
-        CHK(glRenderbufferStorage(GL_RENDERBUFFER, internal_format_gl, (GLsizei)m_size.x, (GLsizei)m_size.y));
-#endif
     }
+    track_bytes(allocated_bytes());
 }
 
 void Texture::upload_sub_region(const uint8_t *data, const int2 &origin, const int2 &size)
 {
-    if (m_samples > 1 && data != nullptr)
-        throw std::runtime_error("Texture::upload_sub_region(): only implemented for samples=1!");
+    capture::Call call(capture::Op::TextureUploadSubRegion, this,
+                       capture::Blob{data, bytes_per_pixel() * size.x * size.y}, origin, size);
+    ++m_revision;
+    if (m_type != TextureType::Texture2D)
+        return upload_sub_region(data, int3{origin.x, origin.y, 0}, int3{size.x, size.y, 1});
+
+    if (m_samples > 1)
+        throw std::runtime_error("Texture::upload_sub_region(): cannot upload to a multisampled texture!");
+
+    static const char *label = profiler::intern("Texture::upload_sub_region");
+    gpu_timer::Scope    timer(label);
+
+    if (!data)
+        return; // nothing to upload
+    count_upload(bytes_per_pixel() * size.x * size.y);
 
     GLenum pixel_format_gl, component_format_gl, internal_format_gl;
 
-    gl_map_texture_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+    gl_map_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
 
     if (m_texture_handle == 0)
         throw std::runtime_error("Texture::upload_sub_region(): not implemented for render targets!");
@@ -198,23 +242,65 @@ void Texture::upload_sub_region(const uint8_t *data, const int2 &origin, const i
     if (origin.x + size.x > m_size.x || origin.y + size.y > m_size.y)
         throw std::runtime_error("Texture::upload_sub_region(): out of bounds!");
 
-    GLenum tex_mode = m_samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
-    CHK(glBindTexture(tex_mode, m_texture_handle));
+    gl_state::bind_texture(GL_TEXTURE_2D, m_texture_handle);
 
-    if (data)
-        CHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    CHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
 
 #if defined(HELLOIMGUI_USE_GLAD)
-    if (data)
+    CHK(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+    CHK(glPixelStorei(GL_UNPACK_SKIP_ROWS, 0));
+    CHK(glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0));
+#endif
+
+    CHK(glTexSubImage2D(GL_TEXTURE_2D, 0, (GLsizei)origin.x, (GLsizei)origin.y, (GLsizei)size.x, (GLsizei)size.y,
+                        pixel_format_gl, component_format_gl, data));
+
+    if (!m_manual_mipmapping && (m_min_interpolation_mode == InterpolationMode::Trilinear ||
+                                 m_mag_interpolation_mode == InterpolationMode::Trilinear))
+        generate_mipmap();
+}
+
+void Texture::upload_sub_region(const uint8_t *data, const int3 &origin, const int3 &size)
+{
+    capture::Call call(capture::Op::TextureUploadSubVolume, this,
+                       capture::Blob{data, bytes_per_pixel() * size.x * size.y * size.z}, origin, size);
+    ++m_revision;
+    if (m_type == TextureType::Texture2D)
     {
-        CHK(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
-        CHK(glPixelStorei(GL_UNPACK_SKIP_ROWS, 0));
-        CHK(glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0));
+        if (origin.z != 0 || size.z != 1)
+            throw std::runtime_error("Texture::upload_sub_region(): 2D textures only have a single layer!");
+        return upload_sub_region(data, int2{origin.x, origin.y}, int2{size.x, size.y});
     }
+
+    static const char *label = profiler::intern("Texture::upload_sub_region");
+    gpu_timer::Scope    timer(label);
+
+    if (!data)
+        return; // nothing to upload
+    count_upload(bytes_per_pixel() * size.x * size.y * size.z);
+
+    GLenum pixel_format_gl, component_format_gl, internal_format_gl;
+
+    gl_map_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+
+    if (origin.x < 0 || origin.y < 0 || origin.z < 0 || origin.x + size.x > m_size.x ||
+        origin.y + size.y > m_size.y || origin.z + size.z > m_depth)
+        throw std::runtime_error("Texture::upload_sub_region(): out of bounds!");
+
+    gl_state::bind_texture(target(), m_texture_handle);
+
+    CHK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+#if defined(HELLOIMGUI_USE_GLAD)
+    CHK(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+    CHK(glPixelStorei(GL_UNPACK_SKIP_ROWS, 0));
+    CHK(glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0));
+    CHK(glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0));
+    CHK(glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0));
 #endif
 
-    CHK(glTexSubImage2D(tex_mode, 0, (GLsizei)origin.x, (GLsizei)origin.y, (GLsizei)size.x, (GLsizei)size.y,
-                        pixel_format_gl, component_format_gl, data));
+    CHK(glTexSubImage3D(target(), 0, (GLsizei)origin.x, (GLsizei)origin.y, (GLsizei)origin.z, (GLsizei)size.x,
+                        (GLsizei)size.y, (GLsizei)size.z, pixel_format_gl, component_format_gl, data));
 
     if (!m_manual_mipmapping && (m_min_interpolation_mode == InterpolationMode::Trilinear ||
                                  m_mag_interpolation_mode == InterpolationMode::Trilinear))
@@ -223,61 +309,120 @@ void Texture::upload_sub_region(const uint8_t *data, const int2 &origin, const i
 
 void Texture::download(uint8_t *data)
 {
+    capture::Call call(capture::Op::TextureDownload, this);
 #if defined(__EMSCRIPTEN__)
     (void)data;
     throw std::runtime_error("Texture::download(): not supported on GLES 2!");
 #else
+    if (m_samples > 1)
+    {
+        // resolve into a temporary single-sample copy and download that instead
+        Texture resolved(m_pixel_format, m_component_format, m_size, InterpolationMode::Nearest,
+                         InterpolationMode::Nearest, WrapMode::ClampToEdge, 1,
+                         TextureFlags::ShaderRead | TextureFlags::RenderTarget);
+        RenderPass(std::vector<Texture *>{this}, nullptr, false).resolve(&resolved);
+        resolved.download(data);
+        return;
+    }
     if (m_texture_handle == 0)
         throw std::runtime_error("Texture::download(): no texture handle!");
-    else if (m_samples > 1)
-        throw std::runtime_error("Texture::download(): only implemented for samples=1!");
+
+    static const char *label = profiler::intern("Texture::download");
+    gpu_timer::Scope    timer(label);
 
     GLenum pixel_format_gl, component_format_gl, internal_format_gl;
 
-    gl_map_texture_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+    gl_map_format(m_pixel_format, m_component_format, pixel_format_gl, component_format_gl, internal_format_gl);
 
     (void)internal_format_gl;
-    CHK(glBindTexture(GL_TEXTURE_2D, m_texture_handle));
-    CHK(glGetTexImage(GL_TEXTURE_2D, 0, pixel_format_gl, component_format_gl, data));
+    gl_state::bind_texture(target(), m_texture_handle);
+    CHK(glGetTexImage(target(), 0, pixel_format_gl, component_format_gl, data));
 
     if (m_flags & (uint8_t)TextureFlags::RenderTarget)
-    {
-        size_t                     stride = bytes_per_pixel() * m_size.x;
-        std::unique_ptr<uint8_t[]> temp(new uint8_t[stride]);
-
-        uint8_t *low = (uint8_t *)data, *high = low + (m_size.y - 1) * stride;
-
-        for (; low < high; low += stride, high -= stride)
-        {
-            memcpy(temp.get(), low, stride);
-            memcpy(low, high, stride);
-            memcpy(high, temp.get(), stride);
-        }
-    }
+        flip_rows(data, m_size, bytes_per_pixel());
 #endif
 }
 
 void Texture::resize(const int2 &size)
 {
+    capture::Call call(capture::Op::TextureResize, this, size);
     if (m_size == size)
         return;
     m_size = size;
+    ++m_revision;
     upload(nullptr);
 }
 
 void Texture::generate_mipmap()
 {
-    GLenum tex_mode = m_samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
-    CHK(glBindTexture(tex_mode, m_texture_handle));
-    CHK(glGenerateMipmap(tex_mode));
+    capture::Call call(capture::Op::TextureGenerateMipmap, this);
+    ++m_revision;
+    if (m_samples > 1)
+        throw std::runtime_error("Texture::generate_mipmap(): multisampled textures cannot have mipmaps!");
+
+    static const char *label = profiler::intern("Texture::generate_mipmap");
+    gpu_timer::Scope    timer(label);
+
+    gl_state::bind_texture(target(), m_texture_handle);
+    CHK(glGenerateMipmap(target()));
+}
+
+uint32_t Texture::target() const
+{
+    switch (m_type)
+    {
+    case TextureType::Texture2DArray: return GL_TEXTURE_2D_ARRAY;
+    case TextureType::Texture3D: return GL_TEXTURE_3D;
+    default: return m_samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    }
 }
 
-static void gl_map_texture_format(Texture::PixelFormat &pixel_format, Texture::ComponentFormat &component_format,
-                                  GLenum &pixel_format_gl, GLenum &component_format_gl, GLenum &internal_format_gl)
+int Texture::max_samples(PixelFormat pixel_format, ComponentFormat component_format, uint8_t flags)
 {
-    using PixelFormat     = Texture::PixelFormat;
-    using ComponentFormat = Texture::ComponentFormat;
+    bool texture = flags & (uint8_t)TextureFlags::ShaderRead;
+#if defined(__EMSCRIPTEN__)
+    // WebGL 2 supports multisampled renderbuffers, but not multisampled textures
+    if (texture)
+        return 1;
+#endif
+
+    uint32_t pixel_format_gl, component_format_gl, internal_format_gl;
+    gl_map_format(pixel_format, component_format, pixel_format_gl, component_format_gl, internal_format_gl);
+
+    // the limit only depends on the internal format and on whether it is a texture or a renderbuffer
+    static std::map<std::pair<uint32_t, bool>, int> cache;
+    auto [it, inserted] = cache.try_emplace({internal_format_gl, texture}, 1);
+    if (!inserted)
+        return it->second;
 
+    GLint limit = 0;
+#if defined(HELLOIMGUI_USE_GLAD)
+    bool depth = pixel_format == PixelFormat::Depth || pixel_format == PixelFormat::DepthStencil;
+    CHK(glGetIntegerv(!texture ? GL_MAX_SAMPLES : depth ? GL_MAX_DEPTH_TEXTURE_SAMPLES : GL_MAX_COLOR_TEXTURE_SAMPLES,
+                      &limit));
+
+    // those hold for every format of a kind, but a driver may support fewer samples for some (e.g. 32-bit float)
+    static const bool query = gl_version_at_least(4, 2) || gl_extension_supported("GL_ARB_internalformat_query");
+    if (query)
+    {
+        GLint samples = 0; // the supported counts are returned largest first
+        CHK(glGetInternalformativ(texture ? GL_TEXTURE_2D_MULTISAMPLE : GL_RENDERBUFFER, internal_format_gl,
+                                  GL_SAMPLES, 1, &samples));
+        if (samples > 0)
+            limit = std::min(limit, samples);
+    }
+#else
+    if (texture)
+        CHK(glGetIntegerv(GL_MAX_SAMPLES, &limit));
+    else
+        CHK(glGetInternalformativ(GL_RENDERBUFFER, internal_format_gl, GL_SAMPLES, 1, &limit));
+#endif
+    return it->second = std::max(1, (int)limit);
+}
+
+void Texture::gl_map_format(PixelFormat &pixel_format, ComponentFormat &component_format, uint32_t &pixel_format_gl,
+                            uint32_t &component_format_gl, uint32_t &internal_format_gl)
+{
     if (pixel_format == PixelFormat::BGR)
         pixel_format = PixelFormat::RGB;
     else if (pixel_format == PixelFormat::BGRA)
@@ -428,11 +573,11 @@ static void gl_map_texture_format(Texture::PixelFormat &pixel_format, Texture::C
     }
 
     if (component_format_gl == 0)
-        throw std::runtime_error("gl_map_texture_format(): invalid component format!");
+        throw std::runtime_error("Texture::gl_map_format(): invalid component format!");
     if (pixel_format_gl == 0)
-        throw std::runtime_error("gl_map_texture_format(): invalid pixel format!");
+        throw std::runtime_error("Texture::gl_map_format(): invalid pixel format!");
     if (internal_format_gl == 0)
-        throw std::runtime_error("gl_map_texture_format(): component format unsupported "
+        throw std::runtime_error("Texture::gl_map_format(): component format unsupported "
                                  "for the given pixel format!");
 }
 
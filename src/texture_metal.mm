@@ -1,6 +1,8 @@
 #if defined(HELLOIMGUI_HAS_METAL)
 
 #include "texture.h"
+#include "profiler.h"
+#include "capture.h"
 
 #include "hello_imgui/hello_imgui.h"
 #include "hello_imgui/internal/backend_impls/rendering_metal.h"
@@ -45,12 +47,36 @@ void Texture::init()
 
 Texture::~Texture()
 {
+    capture::Call call(capture::Op::DestroyTexture, this);
+    track_bytes(0);
     (void)(__bridge_transfer id<MTLTexture>)m_texture_handle;
     (void)(__bridge_transfer id<MTLSamplerState>)m_sampler_state_handle;
 }
 
+/// Report the number of bytes uploaded to a texture to the profiler
+static void count_upload(size_t bytes)
+{
+    static const char *label = profiler::intern("Texture upload bytes");
+    profiler::count(label, (int64_t)bytes);
+}
+
 void Texture::upload(const uint8_t *data)
 {
+    capture::Call call(capture::Op::TextureUpload, this,
+                       capture::Blob{data, bytes_per_pixel() * m_size.x * m_size.y * m_depth});
+    ++m_revision;
+    PROFILE_SCOPE("Texture::upload");
+    if (m_type != TextureType::Texture2D)
+    {
+        // the storage was already allocated by resize(), so there is nothing to do without data
+        if (data)
+            upload_sub_region(data, int3{0}, int3{m_size.x, m_size.y, m_depth});
+        return;
+    }
+
+    if (data)
+        count_upload(bytes());
+
     auto &gMetalGlobals = HelloImGui::GetMetalGlobals();
 
     id<MTLTexture> texture = (__bridge id<MTLTexture>)m_texture_handle;
@@ -91,6 +117,13 @@ void Texture::upload(const uint8_t *data)
 
 void Texture::upload_sub_region(const uint8_t *data, const int2 &origin, const int2 &size)
 {
+    capture::Call call(capture::Op::TextureUploadSubRegion, this,
+                       capture::Blob{data, bytes_per_pixel() * size.x * size.y}, origin, size);
+    ++m_revision;
+    if (!data)
+        return; // nothing to upload
+    count_upload(bytes_per_pixel() * size.x * size.y);
+
     auto &gMetalGlobals = HelloImGui::GetMetalGlobals();
 
     id<MTLTexture> texture = (__bridge id<MTLTexture>)m_texture_handle;
@@ -129,8 +162,106 @@ void Texture::upload_sub_region(const uint8_t *data, const int2 &origin, const i
         generate_mipmap();
 }
 
+void Texture::upload_sub_region(const uint8_t *data, const int3 &origin, const int3 &size)
+{
+    capture::Call call(capture::Op::TextureUploadSubVolume, this,
+                       capture::Blob{data, bytes_per_pixel() * size.x * size.y * size.z}, origin, size);
+    ++m_revision;
+    if (m_type == TextureType::Texture2D)
+    {
+        if (origin.z != 0 || size.z != 1)
+            throw std::runtime_error("Texture::upload_sub_region(): 2D textures only have a single layer!");
+        return upload_sub_region(data, int2{origin.x, origin.y}, int2{size.x, size.y});
+    }
+
+    if (origin.x < 0 || origin.y < 0 || origin.z < 0 || origin.x + size.x > m_size.x ||
+        origin.y + size.y > m_size.y || origin.z + size.z > m_depth)
+        throw std::runtime_error("Texture::upload_sub_region(): out of bounds!");
+
+    if (!data)
+        return; // nothing to upload
+    count_upload(bytes_per_pixel() * size.x * size.y * size.z);
+
+    auto &gMetalGlobals = HelloImGui::GetMetalGlobals();
+
+    id<MTLTexture> texture = (__bridge id<MTLTexture>)m_texture_handle;
+
+    // stage the region in a shared texture of the same type, then blit it over
+    bool                  is_3d        = m_type == TextureType::Texture3D;
+    MTLTextureDescriptor *texture_desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:texture.pixelFormat
+                                                                                            width:(NSUInteger)size.x
+                                                                                           height:(NSUInteger)size.y
+                                                                                        mipmapped:NO];
+    texture_desc.textureType           = texture.textureType;
+    if (is_3d)
+        texture_desc.depth = (NSUInteger)size.z;
+    else
+        texture_desc.arrayLength = (NSUInteger)size.z;
+
+    id<MTLDevice>             device          = gMetalGlobals.caMetalLayer.device;
+    id<MTLCommandQueue>       command_queue   = gMetalGlobals.mtlCommandQueue;
+    id<MTLCommandBuffer>      command_buffer  = [command_queue commandBuffer];
+    id<MTLBlitCommandEncoder> command_encoder = [command_buffer blitCommandEncoder];
+    id<MTLTexture>            temp_texture    = [device newTextureWithDescriptor:texture_desc];
+
+    NSUInteger bytes_per_row   = (NSUInteger)(bytes_per_pixel() * size.x);
+    NSUInteger bytes_per_image = bytes_per_row * (NSUInteger)size.y;
+
+    if (is_3d)
+    {
+        [temp_texture replaceRegion:MTLRegionMake3D(0, 0, 0, (NSUInteger)size.x, (NSUInteger)size.y, (NSUInteger)size.z)
+                        mipmapLevel:0
+                              slice:0
+                          withBytes:data
+                        bytesPerRow:bytes_per_row
+                      bytesPerImage:bytes_per_image];
+
+        [command_encoder copyFromTexture:temp_texture
+                             sourceSlice:0
+                             sourceLevel:0
+                            sourceOrigin:MTLOriginMake(0, 0, 0)
+                              sourceSize:MTLSizeMake((NSUInteger)size.x, (NSUInteger)size.y, (NSUInteger)size.z)
+                               toTexture:texture
+                        destinationSlice:0
+                        destinationLevel:0
+                       destinationOrigin:MTLOriginMake((NSUInteger)origin.x, (NSUInteger)origin.y,
+                                                       (NSUInteger)origin.z)];
+    }
+    else
+    {
+        // array layers are separate slices, so they are staged and copied one at a time
+        for (int layer = 0; layer < size.z; ++layer)
+        {
+            [temp_texture replaceRegion:MTLRegionMake2D(0, 0, (NSUInteger)size.x, (NSUInteger)size.y)
+                            mipmapLevel:0
+                                  slice:(NSUInteger)layer
+                              withBytes:data + layer * bytes_per_image
+                            bytesPerRow:bytes_per_row
+                          bytesPerImage:bytes_per_image];
+
+            [command_encoder copyFromTexture:temp_texture
+                                 sourceSlice:(NSUInteger)layer
+                                 sourceLevel:0
+                                sourceOrigin:MTLOriginMake(0, 0, 0)
+                                  sourceSize:MTLSizeMake((NSUInteger)size.x, (NSUInteger)size.y, 1)
+                                   toTexture:texture
+                            destinationSlice:(NSUInteger)(origin.z + layer)
+                            destinationLevel:0
+                           destinationOrigin:MTLOriginMake((NSUInteger)origin.x, (NSUInteger)origin.y, 0)];
+        }
+    }
+
+    [command_encoder endEncoding];
+    [command_buffer commit];
+    [command_buffer waitUntilCompleted];
+
+    if (!m_manual_mipmapping && m_min_interpolation_mode == InterpolationMode::Trilinear)
+        generate_mipmap();
+}
+
 void Texture::download(uint8_t *data)
 {
+    capture::Call call(capture::Op::TextureDownload, this);
     auto &gMetalGlobals = HelloImGui::GetMetalGlobals();
 
     id<MTLCommandQueue>       command_queue   = gMetalGlobals.mtlCommandQueue;
@@ -161,9 +292,11 @@ void Texture::download(uint8_t *data)
 
 void Texture::resize(const int2 &size)
 {
+    capture::Call call(capture::Op::TextureResize, this, size);
     if (m_size == size)
         return;
     m_size = size;
+    ++m_revision;
     if (m_texture_handle)
     {
         (void)(__bridge_transfer id<MTLTexture>)m_texture_handle;
@@ -293,7 +426,17 @@ void Texture::resize(const int2 &size)
     texture_desc.storageMode           = MTLStorageModePrivate;
     texture_desc.usage                 = 0;
 
-    if (m_samples > 1)
+    if (m_type == TextureType::Texture2DArray)
+    {
+        texture_desc.textureType = MTLTextureType2DArray;
+        texture_desc.arrayLength = (NSUInteger)m_depth;
+    }
+    else if (m_type == TextureType::Texture3D)
+    {
+        texture_desc.textureType = MTLTextureType3D;
+        texture_desc.depth       = (NSUInteger)m_depth;
+    }
+    else if (m_samples > 1)
     {
         texture_desc.textureType = MTLTextureType2DMultisample;
         texture_desc.sampleCount = m_samples;
@@ -308,10 +451,27 @@ void Texture::resize(const int2 &size)
 
     id<MTLTexture> texture = [device newTextureWithDescriptor:texture_desc];
     m_texture_handle       = (__bridge_retained void *)texture;
+    track_bytes(allocated_bytes());
+}
+
+int Texture::max_samples(PixelFormat, ComponentFormat, uint8_t)
+{
+    // Metal only reports the sample counts the device supports, for all formats alike
+    static int samples = []()
+    {
+        id<MTLDevice> device = HelloImGui::GetMetalGlobals().caMetalLayer.device;
+        for (int count : {8, 4, 2})
+            if ([device supportsTextureSampleCount:count])
+                return count;
+        return 1;
+    }();
+    return samples;
 }
 
 void Texture::generate_mipmap()
 {
+    capture::Call call(capture::Op::TextureGenerateMipmap, this);
+    ++m_revision;
     auto &gMetalGlobals = HelloImGui::GetMetalGlobals();
 
     id<MTLTexture>            texture         = (__bridge id<MTLTexture>)m_texture_handle;
@@ -0,0 +1,682 @@
+#if !defined(__EMSCRIPTEN__)
+
+#include "thumbnail_browser.h"
+
+#include "imgui.h"
+#include "memory_tracker.h"
+#include "profiler.h"
+#include "renderpass.h"
+#include "shader.h"
+#include "texture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb_rect_pack.h"
+#undef STB_RECT_PACK_IMPLEMENTATION
+
+namespace fs = std::filesystem;
+
+static constexpr int    atlas_size    = 2048;    ///< width and height of each atlas texture
+static constexpr float  cell_padding  = 6.f;     ///< space around each thumbnail in the grid (in points)
+static constexpr size_t upload_budget = 4 << 20; ///< max. bytes of thumbnails uploaded per frame
+
+struct ThumbnailBrowser::Page
+{
+    Texture                *texture = nullptr;
+    stbrp_context           packer;
+    std::vector<stbrp_node> nodes;
+};
+
+static ImVec2 im(const float2 &v)
+{
+    return ImVec2{v.x, v.y};
+}
+
+static float2 fl(const ImVec2 &v)
+{
+    return float2{v.x, v.y};
+}
+
+//
+// decoding and caching (on the worker threads)
+//
+
+static bool is_image(const fs::path &path)
+{
+    static const char *extensions[] = {".png", ".jpg", ".jpeg", ".hdr", ".bmp", ".tga",
+                                       ".gif", ".psd", ".pic", ".pnm", ".ppm", ".pgm"};
+
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions);
+}
+
+static uint8_t linear_to_srgb8(float v)
+{
+    v = std::clamp(v, 0.f, 1.f);
+    v = v <= 0.0031308f ? 12.92f * v : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+    return (uint8_t)(v * 255.f + 0.5f);
+}
+
+/// Box-filter RGBA pixels down to fit within thumbnail_size x thumbnail_size, converting them with \p encode
+template <typename T, typename Encode>
+static void downscale(const T *src, const int2 &src_size, std::vector<uint8_t> &dst, int2 &dst_size, Encode &&encode)
+{
+    float scale = std::min(1.f, (float)ThumbnailBrowser::thumbnail_size / std::max(src_size.x, src_size.y));
+    dst_size    = int2{std::max(1, (int)std::lround(src_size.x * scale)),
+                    std::max(1, (int)std::lround(src_size.y * scale))};
+    dst.resize((size_t)dst_size.x * dst_size.y * 4);
+
+    for (int y = 0; y < dst_size.y; ++y)
+    {
+        int y0 = (int)((int64_t)y * src_size.y / dst_size.y);
+        int y1 = std::max(y0 + 1, (int)((int64_t)(y + 1) * src_size.y / dst_size.y));
+        for (int x = 0; x < dst_size.x; ++x)
+        {
+            int x0 = (int)((int64_t)x * src_size.x / dst_size.x);
+            int x1 = std::max(x0 + 1, (int)((int64_t)(x + 1) * src_size.x / dst_size.x));
+
+            float4 sum{0.f};
+            for (int sy = y0; sy < y1; ++sy)
+            {
+                const T *row = src + ((size_t)sy * src_size.x + x0) * 4;
+                for (int sx = x0; sx < x1; ++sx, row += 4)
+                    sum += float4{(float)row[0], (float)row[1], (float)row[2], (float)row[3]};
+            }
+            sum /= (float)((y1 - y0) * (x1 - x0));
+
+            uint8_t *pixel = &dst[((size_t)y * dst_size.x + x) * 4];
+            for (int c = 0; c < 4; ++c)
+                pixel[c] = encode(sum[c], c);
+        }
+    }
+}
+
+void ThumbnailBrowser::make_thumbnail(const uint8_t *rgba, const int2 &size, std::vector<uint8_t> &pixels,
+                                      int2 &thumb_size)
+{
+    downscale(rgba, size, pixels, thumb_size, [](float v, int) { return (uint8_t)(v + 0.5f); });
+}
+
+void ThumbnailBrowser::make_thumbnail(const float *rgba, const int2 &size, std::vector<uint8_t> &pixels,
+                                      int2 &thumb_size)
+{
+    // HDR images are linear, so just clip and gamma-encode them (alpha stays linear)
+    downscale(rgba, size, pixels, thumb_size,
+              [](float v, int c)
+              { return c == 3 ? (uint8_t)(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f) : linear_to_srgb8(v); });
+}
+
+static bool decode(const std::string &path, int2 &source_size, std::vector<uint8_t> &pixels, int2 &size)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::string encoded(std::istreambuf_iterator<char>(file), {});
+
+    try
+    {
+        if (Texture::is_hdr(encoded))
+        {
+            auto                   data = Texture::decode_float(path, encoded, source_size);
+            memory_tracker::Scoped decoded(memory_tracker::Category::Images, path,
+                                           (size_t)source_size.x * source_size.y * 4 * sizeof(float));
+            ThumbnailBrowser::make_thumbnail(data.get(), source_size, pixels, size);
+        }
+        else
+        {
+            auto                   data = Texture::decode_uint8(path, encoded, source_size);
+            memory_tracker::Scoped decoded(memory_tracker::Category::Images, path,
+                                           (size_t)source_size.x * source_size.y * 4);
+            ThumbnailBrowser::make_thumbnail(data.get(), source_size, pixels, size);
+        }
+    }
+    catch (const std::runtime_error &)
+    {
+        return false; // not an image after all, or a damaged one
+    }
+    return true;
+}
+
+/// Header of a thumbnail in the disk cache, followed by its RGBA8 pixels
+struct CacheHeader
+{
+    char    magic[4] = {'H', 'G', 'T', '1'};
+    int32_t width = 0, height = 0;
+    int32_t source_width = 0, source_height = 0;
+};
+
+static std::string default_cache_directory()
+{
+    fs::path dir;
+#if defined(_WIN32)
+    if (const char *local = std::getenv("LOCALAPPDATA"))
+        dir = fs::path(local);
+#elif defined(__APPLE__)
+    if (const char *home = std::getenv("HOME"))
+        dir = fs::path(home) / "Library" / "Caches";
+#else
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        dir = fs::path(xdg);
+    else if (const char *home = std::getenv("HOME"))
+        dir = fs::path(home) / ".cache";
+#endif
+    std::error_code ec;
+    if (dir.empty())
+        dir = fs::temp_directory_path(ec);
+    if (ec || dir.empty())
+        return {};
+
+    dir /= fs::path("HelloGuiExperiments") / "thumbnails";
+    fs::create_directories(dir, ec);
+    return ec ? std::string{} : dir.string();
+}
+
+static uint64_t hash_bytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ ((const uint8_t *)data)[i]) * 1099511628211ull;
+    return hash;
+}
+
+static bool read_cache(const std::string &filename, int2 &source_size, std::vector<uint8_t> &pixels, int2 &size)
+{
+    std::ifstream file(filename, std::ios::binary);
+    CacheHeader   header, expected;
+    if (!file.read((char *)&header, sizeof(header)) ||
+        !std::equal(std::begin(header.magic), std::end(header.magic), expected.magic) || header.width <= 0 ||
+        header.height <= 0 || header.width > ThumbnailBrowser::thumbnail_size ||
+        header.height > ThumbnailBrowser::thumbnail_size)
+        return false;
+
+    pixels.resize((size_t)header.width * header.height * 4);
+    if (!file.read((char *)pixels.data(), pixels.size()))
+        return false;
+
+    size        = int2{header.width, header.height};
+    source_size = int2{header.source_width, header.source_height};
+    PROFILE_COUNT("File bytes read", sizeof(header) + pixels.size());
+    return true;
+}
+
+static void write_cache(const std::string &filename, const int2 &source_size, const std::vector<uint8_t> &pixels,
+                        const int2 &size)
+{
+    // write to a temporary file first, so that other processes (or threads) never see a partial thumbnail
+    std::string tmp = fmt::format("{}.{:x}.tmp", filename, std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream file(tmp, std::ios::binary);
+        CacheHeader   header;
+        header.width         = size.x;
+        header.height        = size.y;
+        header.source_width  = source_size.x;
+        header.source_height = source_size.y;
+        if (!file.write((const char *)&header, sizeof(header)) ||
+            !file.write((const char *)pixels.data(), pixels.size()))
+            return;
+    }
+    PROFILE_COUNT("File bytes written", sizeof(CacheHeader) + pixels.size());
+
+    std::error_code ec;
+    fs::rename(tmp, filename, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+}
+
+bool ThumbnailBrowser::load(const std::string &path, Decoded &result)
+{
+    PROFILE_SCOPE("ThumbnailBrowser::load");
+    // the cache key covers everything that affects the thumbnail
+    std::string     cache_file;
+    std::error_code ec;
+    auto            file_size = fs::file_size(path, ec);
+    auto            modified  = ec ? 0 : fs::last_write_time(path, ec).time_since_epoch().count();
+    if (!m_cache_directory.empty() && !ec)
+    {
+        uint64_t key = hash_bytes(path.data(), path.size());
+        key          = hash_bytes(&file_size, sizeof(file_size), key);
+        key          = hash_bytes(&modified, sizeof(modified), key);
+        key          = hash_bytes(&thumbnail_size, sizeof(thumbnail_size), key);
+        cache_file   = (fs::path(m_cache_directory) / fmt::format("{:016x}.thumb", key)).string();
+
+        if (read_cache(cache_file, result.source_size, result.pixels, result.size))
+        {
+            ++m_cache_hits;
+            return true;
+        }
+    }
+
+    if (file_size != std::uintmax_t(-1))
+        PROFILE_COUNT("File bytes read", file_size);
+    if (!decode(path, result.source_size, result.pixels, result.size))
+    {
+        result.size = int2{0};
+        return false;
+    }
+
+    ++m_decoded;
+    if (!cache_file.empty())
+        write_cache(cache_file, result.source_size, result.pixels, result.size);
+    return true;
+}
+
+void ThumbnailBrowser::worker()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+        if (m_quit)
+            return;
+
+        Decoded result;
+        result.index      = m_queue.front();
+        result.generation = m_generation;
+        m_queue.pop_front();
+        m_states[result.index] = State::Loading;
+        std::string path       = m_paths[result.index];
+
+        lock.unlock();
+        load(path, result);
+        lock.lock();
+
+        // drop the result if the directory changed in the meantime
+        if (result.generation != m_generation)
+            continue;
+        m_states[result.index] = State::Done;
+        m_done.push_back(std::move(result));
+    }
+}
+
+//
+// main thread
+//
+
+ThumbnailBrowser::ThumbnailBrowser(OpenCallback on_open) :
+    m_on_open(std::move(on_open)), m_cache_directory(default_cache_directory())
+{
+    // leave one core for the main thread (hardware_concurrency() may return 0 if it is unknown)
+    unsigned count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned i = 0; i < count; ++i)
+        m_workers.emplace_back(&ThumbnailBrowser::worker, this);
+}
+
+ThumbnailBrowser::~ThumbnailBrowser()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (auto &thread : m_workers)
+        thread.join();
+
+    release();
+    delete m_shader;
+    delete m_render_pass;
+    delete m_target;
+}
+
+void ThumbnailBrowser::release()
+{
+    for (auto page : m_pages)
+    {
+        delete page->texture;
+        delete page;
+    }
+    m_pages.clear();
+    m_page_instances.clear();
+}
+
+void ThumbnailBrowser::set_directory(const std::string &directory)
+{
+    std::vector<fs::path> files;
+    std::error_code       ec;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        if (it->is_regular_file(ec) && is_image(it->path()))
+            files.push_back(it->path());
+    if (ec)
+        throw std::runtime_error("ThumbnailBrowser::set_directory(): could not read directory \"" + directory +
+                                 "\": " + ec.message());
+    std::sort(files.begin(), files.end());
+
+    m_directory = directory;
+    m_items.clear();
+    m_items.reserve(files.size());
+    for (auto &file : files)
+    {
+        Item item;
+        item.path = file.string();
+        item.name = file.filename().string();
+        m_items.push_back(std::move(item));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_generation;
+        m_queue.clear();
+        m_done.clear();
+        m_paths.resize(m_items.size());
+        for (size_t i = 0; i < m_items.size(); ++i)
+            m_paths[i] = m_items[i].path;
+        m_states.assign(m_items.size(), State::Unloaded);
+    }
+
+    release();
+    m_cache_hits      = 0;
+    m_decoded         = 0;
+    m_loaded          = 0;
+    m_selected        = -1;
+    m_first_requested = m_last_requested = 0;
+    m_columns                            = 0;
+    m_dirty                              = true;
+}
+
+void ThumbnailBrowser::request(size_t first, size_t last, size_t prefetch)
+{
+    if (first == m_first_requested && last == m_last_requested)
+        return;
+    m_first_requested = first;
+    m_last_requested  = last;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // whatever wasn't picked up yet and has scrolled out of range is no longer wanted
+    for (size_t index : m_queue)
+        m_states[index] = State::Unloaded;
+    m_queue.clear();
+
+    auto want = [this](size_t index)
+    {
+        if (m_states[index] != State::Unloaded)
+            return;
+        m_states[index] = State::Queued;
+        m_queue.push_back(index);
+    };
+
+    // the visible thumbnails in reading order, then the ones just below and above, nearest first
+    for (size_t i = first; i < last; ++i)
+        want(i);
+    for (size_t i = last; i < std::min(last + prefetch, m_states.size()); ++i)
+        want(i);
+    for (size_t i = first; i > (first > prefetch ? first - prefetch : 0); --i)
+        want(i - 1);
+
+    m_wake.notify_all();
+}
+
+void ThumbnailBrowser::receive()
+{
+    std::vector<Decoded> done;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_done.empty())
+            return;
+
+        // spread the uploads over several frames if a lot of thumbnails arrive at once
+        size_t count = 0, bytes = 0;
+        while (count < m_done.size() && bytes < upload_budget)
+            bytes += m_done[count++].pixels.size();
+
+        done.assign(std::make_move_iterator(m_done.begin()), std::make_move_iterator(m_done.begin() + count));
+        m_done.erase(m_done.begin(), m_done.begin() + count);
+    }
+
+    for (auto &thumbnail : done)
+    {
+        auto &item       = m_items[thumbnail.index];
+        item.source_size = thumbnail.source_size;
+        if (thumbnail.size.x > 0 && thumbnail.size.y > 0)
+            add_to_atlas(item, thumbnail);
+        else
+            item.failed = true;
+        ++m_loaded;
+    }
+
+    m_columns = 0; // rebuild the instances
+}
+
+void ThumbnailBrowser::add_to_atlas(Item &item, const Decoded &thumbnail)
+{
+    stbrp_rect rect{};
+    rect.w = thumbnail.size.x;
+    rect.h = thumbnail.size.y;
+
+    // only the newest atlas can have room left
+    if (!m_pages.empty())
+        stbrp_pack_rects(&m_pages.back()->packer, &rect, 1);
+
+    if (!rect.was_packed)
+    {
+        auto page     = new Page;
+        page->texture = new Texture(Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8,
+                                    {atlas_size, atlas_size}, Texture::InterpolationMode::Bilinear,
+                                    Texture::InterpolationMode::Bilinear, Texture::WrapMode::ClampToEdge);
+        page->texture->set_name(fmt::format("Thumbnail atlas {}", m_pages.size()));
+        page->nodes.resize(atlas_size);
+        stbrp_init_target(&page->packer, atlas_size, atlas_size, page->nodes.data(), (int)page->nodes.size());
+        m_pages.push_back(page);
+
+        stbrp_pack_rects(&page->packer, &rect, 1);
+        if (!rect.was_packed)
+            throw std::runtime_error("ThumbnailBrowser::add_to_atlas(): thumbnail does not fit into an empty atlas!");
+    }
+
+    int2 origin{(int)rect.x, (int)rect.y};
+    m_pages.back()->texture->upload_sub_region(thumbnail.pixels.data(), origin, thumbnail.size);
+
+    // center the thumbnail in its cell, and inset the texture coordinates by half a texel so that bilinear filtering
+    // never reaches into the neighboring thumbnails
+    float2 size = float2{thumbnail.size};
+    float2 pos  = (float2{(float)thumbnail_size} - size) * 0.5f;
+    item.page   = (int)m_pages.size() - 1;
+    item.rect   = float4{std::floor(pos.x), std::floor(pos.y), size.x, size.y};
+    item.uv     = float4{origin.x + 0.5f, origin.y + 0.5f, origin.x + size.x - 0.5f, origin.y + size.y - 0.5f} /
+              (float)atlas_size;
+}
+
+void ThumbnailBrowser::update_instances(int columns)
+{
+    m_columns = columns;
+    m_dirty   = true;
+    if (!m_shader)
+        return;
+
+    float  label_height = ImGui::GetTextLineHeight();
+    float2 cell         = float2{thumbnail_size + 2 * cell_padding, thumbnail_size + 2 * cell_padding + label_height};
+
+    // group the instances by atlas, so that each atlas is a contiguous range drawn with one instanced draw
+    std::vector<float4> rects, uvs;
+    m_page_instances.assign(m_pages.size() + 1, 0);
+    for (size_t page = 0; page < m_pages.size(); ++page)
+    {
+        m_page_instances[page] = rects.size();
+        for (size_t i = 0; i < m_items.size(); ++i)
+        {
+            const auto &item = m_items[i];
+            if (item.page != (int)page)
+                continue;
+
+            float2 pos = float2{(float)(i % columns), (float)(i / columns)} * cell + float2{cell_padding};
+            rects.push_back(item.rect + float4{pos.x, pos.y, 0.f, 0.f});
+            uvs.push_back(item.uv);
+        }
+    }
+    m_page_instances.back() = rects.size();
+
+    if (rects.empty())
+        return;
+    m_shader->set_buffer("rect", VariableType::Float32, {rects.size(), 4}, rects.data());
+    m_shader->set_buffer("uv_rect", VariableType::Float32, {uvs.size(), 4}, uvs.data());
+}
+
+void ThumbnailBrowser::render(const int2 &size, float scroll)
+{
+    if (!m_target)
+    {
+        m_target      = new Texture(Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8, size,
+                                    Texture::InterpolationMode::Nearest, Texture::InterpolationMode::Nearest,
+                                    Texture::WrapMode::ClampToEdge, 1,
+                                    Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget);
+        m_target->set_name("Thumbnails");
+        m_render_pass = new RenderPass(std::vector<Texture *>{m_target});
+        m_render_pass->set_cull_mode(RenderPass::CullMode::Disabled);
+        m_render_pass->set_depth_test(RenderPass::DepthTest::Always, false);
+        m_shader = new Shader(m_render_pass, "Thumbnails", Shader::from_asset("shaders/thumbnails_vert"),
+                              Shader::from_asset("shaders/thumbnails_frag"));
+
+        const float corners[] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 0.f, 1.f, 1.f, 0.f, 1.f};
+        m_shader->set_buffer_usage("corner", Shader::BufferUsage::Static);
+        m_shader->set_buffer("corner", VariableType::Float32, {6, 2}, corners);
+        m_shader->set_buffer_divisor("rect", 1);
+        m_shader->set_buffer_divisor("uv_rect", 1);
+        update_instances(m_columns);
+    }
+
+    auto bg = ImGui::GetStyleColorVec4(ImGuiCol_WindowBg);
+    m_render_pass->resize(size);
+    m_render_pass->set_clear_color(float4{bg.x, bg.y, bg.z, bg.w});
+    m_render_pass->begin();
+
+    if (m_page_instances.size() > 1 && m_page_instances.back() > 0)
+    {
+        float2 view_size = float2{size} / fl(ImGui::GetIO().DisplayFramebufferScale);
+        m_shader->set_uniform("view_size", view_size);
+        m_shader->set_uniform("scroll", scroll);
+
+        for (size_t page = 0; page < m_pages.size(); ++page)
+        {
+            size_t first = m_page_instances[page], count = m_page_instances[page + 1] - first;
+            if (count == 0)
+                continue;
+
+            m_shader->set_texture("atlas", m_pages[page]->texture);
+            m_shader->set_buffer_pointer_offset("rect", first * sizeof(float4));
+            m_shader->set_buffer_pointer_offset("uv_rect", first * sizeof(float4));
+            m_shader->begin();
+            m_shader->draw_array(Shader::PrimitiveType::Triangle, 0, 6, false, count);
+            m_shader->end();
+        }
+    }
+
+    m_render_pass->end();
+    m_dirty       = false;
+    m_last_scroll = scroll;
+}
+
+void ThumbnailBrowser::draw()
+{
+    receive();
+
+    if (m_directory.empty())
+    {
+        ImGui::TextDisabled("No directory selected");
+        return;
+    }
+
+    ImGui::TextUnformatted(m_directory.c_str());
+    ImGui::TextDisabled("%zu of %zu images loaded (%zu decoded, %zu from the cache)", m_loaded, m_items.size(),
+                        (size_t)m_decoded, (size_t)m_cache_hits);
+
+    ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2{0.f, 0.f});
+    bool visible = ImGui::BeginChild("##thumbnails");
+    ImGui::PopStyleVar();
+
+    float2 view = fl(ImGui::GetContentRegionAvail());
+    if (!visible || m_items.empty() || view.x < 1.f || view.y < 1.f)
+    {
+        ImGui::EndChild();
+        return;
+    }
+
+    float  scroll  = ImGui::GetScrollY();
+    float  label   = ImGui::GetTextLineHeight();
+    float2 cell    = float2{thumbnail_size + 2 * cell_padding, thumbnail_size + 2 * cell_padding + label};
+    int    columns = std::max(1, (int)(view.x / cell.x));
+    size_t rows    = (m_items.size() + columns - 1) / columns;
+    if (columns != m_columns)
+        update_instances(columns);
+
+    // load the visible thumbnails, and a screenful above and below
+    size_t first_row = (size_t)(scroll / cell.y);
+    size_t last_row  = std::min(rows, (size_t)((scroll + view.y) / cell.y) + 1);
+    size_t first     = std::min(first_row * columns, m_items.size());
+    size_t last      = std::min(last_row * columns, m_items.size());
+    request(first, last, last - first);
+
+    int2 size = int2{view * fl(ImGui::GetIO().DisplayFramebufferScale)};
+    if (m_dirty || scroll != m_last_scroll || !m_target || m_target->size() != size)
+        render(size, scroll);
+
+    float2 origin = fl(ImGui::GetCursorScreenPos()); // top-left corner of the (scrolled) grid
+    ImGui::SetCursorPos(ImVec2{0.f, scroll});
+    ImGui::Image((ImTextureID)(intptr_t)m_target->texture_handle(), im(view));
+    ImGui::SetCursorPos(ImVec2{0.f, 0.f});
+    ImGui::Dummy(ImVec2{columns * cell.x, rows * cell.y});
+
+    int hovered = -1;
+    if (ImGui::IsWindowHovered())
+    {
+        float2 mouse = fl(ImGui::GetMousePos()) - origin;
+        int    col = (int)std::floor(mouse.x / cell.x), row = (int)std::floor(mouse.y / cell.y);
+        if (col >= 0 && col < columns && row >= 0 && (size_t)row * columns + col < m_items.size())
+            hovered = row * columns + col;
+    }
+
+    // placeholders, labels and highlights of the visible cells
+    auto *draw_list = ImGui::GetWindowDrawList();
+    for (size_t i = first; i < last; ++i)
+    {
+        const auto &item = m_items[i];
+        float2      pos  = origin + float2{(float)(i % columns), (float)(i / columns)} * cell;
+        float2      box  = pos + float2{cell_padding};
+
+        if (item.page < 0)
+            draw_list->AddRect(im(box), im(box + float2{(float)thumbnail_size}),
+                               ImGui::GetColorU32(item.failed ? ImGuiCol_PlotHistogram : ImGuiCol_Border));
+
+        if ((int)i == m_selected || (int)i == hovered)
+        {
+            auto color = (int)i == m_selected ? ImGuiCol_ButtonActive : ImGuiCol_ButtonHovered;
+            draw_list->AddRect(im(pos + float2{1.f}), im(pos + cell - float2{1.f}), ImGui::GetColorU32(color), 4.f, 0,
+                               2.f);
+        }
+
+        float2 label_pos = box + float2{0.f, (float)thumbnail_size + 0.5f * cell_padding};
+        float  width     = ImGui::CalcTextSize(item.name.c_str()).x;
+        draw_list->PushClipRect(im(label_pos), im(label_pos + float2{(float)thumbnail_size, label}), true);
+        draw_list->AddText(im(label_pos + float2{std::max(0.f, 0.5f * (thumbnail_size - width)), 0.f}),
+                           ImGui::GetColorU32(item.failed ? ImGuiCol_TextDisabled : ImGuiCol_Text),
+                           item.name.c_str());
+        draw_list->PopClipRect();
+    }
+
+    if (hovered >= 0)
+    {
+        const auto &item = m_items[hovered];
+        if (item.failed)
+            ImGui::SetTooltip("%s\n(could not be loaded)", item.name.c_str());
+        else if (item.page >= 0)
+            ImGui::SetTooltip("%s\n%d x %d", item.name.c_str(), item.source_size.x, item.source_size.y);
+        else
+            ImGui::SetTooltip("%s", item.name.c_str());
+
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+            m_selected = hovered;
+        if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left) && m_on_open && !item.failed)
+            m_on_open(item.path);
+    }
+
+    ImGui::EndChild();
+}
+
+#endif // !defined(__EMSCRIPTEN__)
@@ -0,0 +1,288 @@
+#include "trace.h"
+
+#include "hello_imgui/hello_imgui.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace trace
+{
+
+void append_escaped(std::string &out, std::string_view text)
+{
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20)
+                fmt::format_to(std::back_inserter(out), "\\u{:04x}", (unsigned)c);
+            else
+                out += c;
+        }
+    }
+}
+
+std::string json_string(std::string_view text)
+{
+    std::string out = "\"";
+    append_escaped(out, text);
+    return out + "\"";
+}
+
+} // namespace trace
+
+#if !defined(__EMSCRIPTEN__)
+
+// track ids for the zones that don't belong to a CPU thread
+static constexpr uint32_t gpu_track    = 1000000;
+static constexpr uint32_t frames_track = 1000001;
+
+struct Recording
+{
+    std::string                  filename;
+    int64_t                      origin_ns   = 0; ///< zero time of the trace
+    uint32_t                     main_thread = 0;
+    std::vector<profiler::Frame> frames;
+};
+
+static Recording s_recording;
+static bool      s_active     = false;
+static int64_t   s_end_ns     = 0;
+static uint64_t  s_next_frame = 0; ///< next frame to copy into the recording
+static uint64_t  s_last_frame = 0; ///< last frame to record, or 0 until the recording is stopped
+
+static std::thread       s_writer;
+static std::atomic<bool> s_writing{false};
+static std::string       s_result; ///< what the writer reports when it's done (written by the writer thread)
+
+/// Append the start of an event: its name, phase, time stamp (in microseconds since the origin) and track
+static void begin_event(std::string &out, std::string_view name, char phase, int64_t time_ns, int64_t origin_ns,
+                        uint32_t track)
+{
+    out += out.back() == '[' ? "\n{\"name\":\"" : ",\n{\"name\":\"";
+    trace::append_escaped(out, name);
+    fmt::format_to(std::back_inserter(out), "\",\"ph\":\"{}\",\"ts\":{:.3f},\"pid\":1,\"tid\":{}", phase,
+                   (time_ns - origin_ns) * 1e-3, track);
+}
+
+static void add_track_name(std::string &out, uint32_t track, std::string_view name, int sort_index)
+{
+    begin_event(out, "thread_name", 'M', 0, 0, track);
+    out += ",\"args\":{\"name\":\"";
+    trace::append_escaped(out, name);
+    out += "\"}}";
+    begin_event(out, "thread_sort_index", 'M', 0, 0, track);
+    fmt::format_to(std::back_inserter(out), ",\"args\":{{\"sort_index\":{}}}}}", sort_index);
+}
+
+/// Convert a recording to Chrome trace-event JSON (see the "Trace Event Format" document)
+static std::string to_json(const Recording &rec)
+{
+    const int64_t origin = rec.origin_ns;
+
+    std::string out;
+    out.reserve(256 * 1024);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    begin_event(out, "process_name", 'M', 0, 0, 0);
+    out += ",\"args\":{\"name\":\"HelloGuiExperiments\"}}";
+    add_track_name(out, frames_track, "Frames", 0);
+    add_track_name(out, gpu_track, "GPU", 2);
+
+    std::vector<uint32_t>                          threads;
+    std::vector<std::pair<const char *, int64_t>> totals;
+    for (const auto &f : rec.frames)
+    {
+        begin_event(out, fmt::format("Frame {}", f.index), 'X', f.start_ns, origin, frames_track);
+        fmt::format_to(std::back_inserter(out), ",\"dur\":{:.3f},\"args\":{{\"cpu_ms\":{:.3f},\"gpu_ms\":{:.3f}}}}}",
+                       f.duration_ns * 1e-3, f.cpu_ns * 1e-6, f.gpu_ns * 1e-6);
+
+        for (const auto &z : f.zones)
+        {
+            bool cpu = z.source == profiler::Source::CPU;
+            if (cpu && std::find(threads.begin(), threads.end(), z.thread) == threads.end())
+                threads.push_back(z.thread);
+
+            begin_event(out, z.label, 'X', z.start_ns, origin, cpu ? z.thread : gpu_track);
+            fmt::format_to(std::back_inserter(out), ",\"cat\":\"{}\",\"dur\":{:.3f}}}", cpu ? "cpu" : "gpu",
+                           z.duration_ns * 1e-3);
+        }
+
+        // each amount as an instant event on the thread that reported it, and the totals of the frame as counters
+        totals.clear();
+        for (const auto &c : f.counters)
+        {
+            begin_event(out, c.label, 'i', c.time_ns, origin, c.thread);
+            fmt::format_to(std::back_inserter(out), ",\"s\":\"t\",\"args\":{{\"value\":{}}}}}", c.value);
+
+            auto it = std::find_if(totals.begin(), totals.end(), [&c](auto &t) { return t.first == c.label; });
+            if (it == totals.end())
+                totals.emplace_back(c.label, c.value);
+            else
+                it->second += c.value;
+        }
+        for (auto &[label, total] : totals)
+        {
+            begin_event(out, fmt::format("{} per frame", label), 'C', f.start_ns, origin, 0);
+            fmt::format_to(std::back_inserter(out), ",\"args\":{{\"value\":{}}}}}", total);
+        }
+
+        for (const auto &m : f.messages)
+        {
+            begin_event(out, m.text, 'i', m.time_ns, origin, m.thread);
+            out += ",\"s\":\"g\"}";
+        }
+    }
+
+    for (uint32_t t : threads)
+        add_track_name(out, t, t == rec.main_thread ? std::string("Main thread") : fmt::format("Thread {}", t),
+                       t == rec.main_thread ? 1 : 3);
+
+    out += "\n]}\n";
+    return out;
+}
+
+static void finish()
+{
+    s_active = false;
+    s_writing.store(true);
+
+    HelloImGui::Log(HelloImGui::LogLevel::Info, "Writing a trace of %zu frames to '%s'...",
+                    s_recording.frames.size(), s_recording.filename.c_str());
+
+    s_writer = std::thread(
+        [rec = std::move(s_recording)]()
+        {
+            std::string   json = to_json(rec);
+            std::ofstream out(rec.filename, std::ios::binary);
+            out.write(json.data(), (std::streamsize)json.size());
+            out.close();
+            s_result = out ? fmt::format("Wrote trace '{}' ({:.1f} MB)", rec.filename, json.size() / (1024.0 * 1024.0))
+                           : fmt::format("Could not write trace '{}'", rec.filename);
+            s_writing.store(false);
+        });
+    s_recording = Recording{};
+}
+
+/// Copy the frames up to (and including) \p last into the recording
+static void copy_frames(uint64_t last)
+{
+    for (; s_next_frame <= last; ++s_next_frame)
+        if (auto f = profiler::frame(s_next_frame))
+            s_recording.frames.push_back(*f);
+}
+
+namespace trace
+{
+
+bool start(const std::string &filename, double seconds)
+{
+    if (s_active || s_writing.load())
+        return false;
+    if (s_writer.joinable())
+        s_writer.join();
+
+    s_recording.filename    = filename;
+    s_recording.origin_ns   = profiler::now_ns();
+    s_recording.main_thread = profiler::thread_index();
+    s_recording.frames.clear();
+    s_end_ns     = s_recording.origin_ns + int64_t(seconds * 1e9);
+    s_next_frame = std::max<uint64_t>(1, profiler::frame_index());
+    s_last_frame = 0;
+    s_active     = true;
+
+    HelloImGui::Log(HelloImGui::LogLevel::Info, "Recording a %.1f s trace...", seconds);
+    return true;
+}
+
+void stop()
+{
+    if (s_active && !s_last_frame)
+        s_last_frame = profiler::frame_index();
+}
+
+bool recording()
+{
+    return s_active;
+}
+
+bool writing()
+{
+    return s_writing.load();
+}
+
+float progress()
+{
+    if (!s_active)
+        return 0.f;
+    float t = float(profiler::now_ns() - s_recording.origin_ns) / float(s_end_ns - s_recording.origin_ns);
+    return std::clamp(t, 0.f, 1.f);
+}
+
+std::string default_filename(std::string_view kind)
+{
+    std::time_t now = std::time(nullptr);
+    char        stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    return fmt::format("HelloGuiExperiments-{}-{}.json", kind, stamp);
+}
+
+void new_frame()
+{
+    // report a finished write
+    if (s_writer.joinable() && !s_writing.load())
+    {
+        s_writer.join();
+        HelloImGui::Log(HelloImGui::LogLevel::Info, "%s", s_result.c_str());
+    }
+
+    if (!s_active)
+        return;
+
+    // the frame that just ended is the last one, if it reached the end of the requested duration
+    uint64_t current = profiler::frame_index();
+    if (!s_last_frame && profiler::now_ns() >= s_end_ns)
+        s_last_frame = std::max(current - 1, s_next_frame);
+
+    // frames are copied once their GPU results have arrived
+    uint64_t ready = current > profiler::complete_after ? current - profiler::complete_after : 0;
+    if (s_last_frame)
+        ready = std::min(ready, s_last_frame);
+    copy_frames(ready);
+
+    if (s_last_frame && s_next_frame > s_last_frame)
+        finish();
+}
+
+void shutdown()
+{
+    if (s_active)
+    {
+        // the GPU results of the last few frames may be missing, but everything else is there
+        copy_frames(s_last_frame ? s_last_frame : profiler::frame_index());
+        finish();
+    }
+    if (s_writer.joinable())
+    {
+        s_writer.join();
+        fmt::print("{}\n", s_result);
+    }
+}
+
+} // namespace trace
+
+#endif // !defined(__EMSCRIPTEN__)
@@ -0,0 +1,30 @@
+/**
+    \file test.h
+    \brief A minimal test harness: test cases register themselves, and \ref REQUIRE throws when a check fails.
+*/
+#pragma once
+
+#include <fmt/core.h>
+#include <stdexcept>
+
+namespace test
+{
+
+/// Register a test case to be run by test_main.cpp. Returns true, so that it can initialize a static.
+bool add(const char *name, void (*run)());
+
+} // namespace test
+
+/// Define a test case, which fails if it throws
+#define TEST_CASE(name)                                                                                               \
+    static void       name();                                                                                         \
+    static const bool name##_registered = test::add(#name, name);                                                     \
+    static void       name()
+
+/// Fail the current test case unless \p condition holds
+#define REQUIRE(condition)                                                                                            \
+    do                                                                                                                \
+    {                                                                                                                 \
+        if (!(condition))                                                                                             \
+            throw std::runtime_error(fmt::format("{}:{}: REQUIRE({}) failed", __FILE__, __LINE__, #condition));       \
+    } while (false)
@@ -0,0 +1,114 @@
+/** \file test_draw_list.cpp
+    \brief Checks that submitting a \ref DrawList draws the same pixels as issuing its draws one by one.
+
+    Whichever way the list is submitted on this driver (one multi-draw indirect call, or one call per merged command),
+    it must match the reference of one \ref Shader::draw_array() call per recorded draw.
+*/
+
+#include "draw_list.h"
+#include "headless_context.h"
+#include "renderpass.h"
+#include "shader.h"
+#include "test.h"
+#include "texture.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+using std::vector;
+
+/// A draw as passed to \ref DrawList::add() and \ref Shader::draw_array()
+struct Draw
+{
+    size_t offset, count, instances;
+};
+
+/// Draws flat white triangles into a small render target and reads them back
+class Fixture
+{
+public:
+    Fixture() :
+        m_target(new Texture(Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8, int2{16},
+                             Texture::InterpolationMode::Nearest, Texture::InterpolationMode::Nearest,
+                             Texture::WrapMode::ClampToEdge, 1,
+                             Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget)),
+        m_pass(vector<Texture *>{m_target.get()}),
+        m_shader(&m_pass, "test shader", "in vec2 position;\nvoid main() { gl_Position = vec4(position, 0.0, 1.0); }\n",
+                 "out vec4 frag_color;\nvoid main() { frag_color = vec4(1.0); }\n", Shader::BlendMode::None)
+    {
+        m_pass.set_cull_mode(RenderPass::CullMode::Disabled);
+
+        // one triangle in each quadrant, so that every draw covers different pixels
+        const float positions[] = {
+            -1.f, -1.f, 0.f, -1.f, -1.f, 0.f, // bottom left
+            0.f,  -1.f, 1.f, -1.f, 0.f,  0.f, // bottom right
+            -1.f, 0.f,  0.f, 0.f,  -1.f, 1.f, // top left
+            0.f,  0.f,  1.f, 0.f,  0.f,  1.f, // top right
+        };
+        m_shader.set_buffer("position", VariableType::Float32, {12, 2}, positions);
+    }
+
+    /// Render with \p draw (between begin() and end() of the pass and shader) and return the pixels
+    vector<uint8_t> render(const std::function<void(Shader &)> &draw)
+    {
+        m_pass.begin();
+        m_shader.begin();
+        draw(m_shader);
+        m_shader.end();
+        m_pass.end();
+
+        vector<uint8_t> pixels(m_target->bytes());
+        m_target->download(pixels.data());
+        return pixels;
+    }
+
+    /// Render \p draws with a draw list, check that it matches drawing them one by one, and return the list
+    std::unique_ptr<DrawList> check(const vector<Draw> &draws)
+    {
+        auto list = std::make_unique<DrawList>(Shader::PrimitiveType::Triangle);
+        for (auto &d : draws)
+            list->add(d.offset, d.count, d.instances);
+
+        auto reference = render(
+            [&](Shader &shader)
+            {
+                for (auto &d : draws)
+                    shader.draw_array(Shader::PrimitiveType::Triangle, d.offset, d.count, false, d.instances);
+            });
+        auto pixels = render([&](Shader &shader) { shader.draw(*list); });
+
+        size_t covered = 0;
+        for (uint8_t p : reference)
+            covered += p != 0;
+        REQUIRE(covered > 0);
+        REQUIRE(pixels == reference);
+        return list;
+    }
+
+protected:
+    HeadlessContext          m_context;
+    std::unique_ptr<Texture> m_target;
+    RenderPass               m_pass;
+    Shader                   m_shader;
+};
+
+TEST_CASE(draw_list_matches_individual_draws)
+{
+    Fixture fixture;
+    // the second and third draws are contiguous, so they are merged into one command; the fourth triangle is skipped
+    auto list = fixture.check({{9, 3, 1}, {0, 3, 1}, {3, 3, 1}});
+    REQUIRE(list->draws() == 3);
+    REQUIRE(list->commands().size() == 2);
+    REQUIRE(list->calls() >= 1 && list->calls() <= 2);
+}
+
+TEST_CASE(draw_list_draws_zero_instances_once)
+{
+    // draw_array() treats 0 instances as a plain, non-instanced draw, and so must every way of submitting a list
+    Fixture fixture;
+    auto    list = fixture.check({{0, 3, 0}, {6, 3, 0}});
+    REQUIRE(list->commands().size() == 2);
+    for (auto &cmd : list->commands())
+        REQUIRE(cmd.instances == 1);
+}
@@ -0,0 +1,56 @@
+/** \file test_main.cpp
+    \brief Runs the registered test cases (or those whose names contain the first argument) and reports the failures.
+*/
+
+#include "test.h"
+
+#include <cstring>
+#include <exception>
+#include <vector>
+
+struct Case
+{
+    const char *name;
+    void (*run)();
+};
+
+static std::vector<Case> &cases()
+{
+    static std::vector<Case> s_cases;
+    return s_cases;
+}
+
+namespace test
+{
+
+bool add(const char *name, void (*run)())
+{
+    cases().push_back({name, run});
+    return true;
+}
+
+} // namespace test
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : "";
+    int         failed = 0, passed = 0;
+    for (auto &c : cases())
+    {
+        if (!strstr(c.name, filter))
+            continue;
+        try
+        {
+            c.run();
+            fmt::print("[  OK  ] {}\n", c.name);
+            ++passed;
+        }
+        catch (const std::exception &e)
+        {
+            fmt::print(stderr, "[FAILED] {}: {}\n", c.name, e.what());
+            ++failed;
+        }
+    }
+    fmt::print("{} passed, {} failed\n", passed, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/** \file test_render_graph.cpp
+    \brief Checks the scheduling, culling and texture aliasing of the \ref RenderGraph, and its handling of imports.
+*/
+
+#include "headless_context.h"
+#include "render_graph.h"
+#include "test.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+static std::unique_ptr<Texture> make_target(const int2 &size)
+{
+    return std::make_unique<Texture>(Texture::PixelFormat::RGBA, Texture::ComponentFormat::UInt8, size,
+                                     Texture::InterpolationMode::Nearest, Texture::InterpolationMode::Nearest,
+                                     Texture::WrapMode::ClampToEdge, 1,
+                                     Texture::TextureFlags::ShaderRead | Texture::TextureFlags::RenderTarget);
+}
+
+/// A pass that only clears its targets
+static void no_draws(RenderGraph &, RenderPass &)
+{
+}
+
+/// Build a chain of four passes (A -> B -> C -> D), each writing a transient texture read by the next
+static vector<RenderGraph::Resource> build_chain(RenderGraph &graph)
+{
+    RenderGraph::TextureDesc      desc{int2{8}};
+    vector<RenderGraph::Resource> r;
+    for (const char *name : {"a", "b", "c", "d"})
+        r.push_back(graph.create_texture(name, desc));
+
+    graph.add_pass("A", {}, {r[0]}, no_draws);
+    graph.add_pass("B", {r[0]}, {r[1]}, no_draws);
+    graph.add_pass("C", {r[1]}, {r[2]}, no_draws);
+    graph.add_pass("D", {r[2]}, {r[3]}, no_draws);
+    graph.mark_output(r[3]);
+    return r;
+}
+
+TEST_CASE(render_graph_aliases_transient_textures)
+{
+    HeadlessContext context;
+    RenderGraph     graph;
+    auto            r = build_chain(graph);
+    graph.execute();
+
+    REQUIRE((graph.schedule() == vector<string>{"A", "B", "C", "D"}));
+    REQUIRE(graph.culled_passes() == 0);
+
+    // each texture is free again once the pass after its writer has read it, so two textures suffice
+    REQUIRE(graph.texture(r[2]) == graph.texture(r[0]));
+    REQUIRE(graph.texture(r[3]) == graph.texture(r[1]));
+    REQUIRE(graph.texture(r[0]) != graph.texture(r[1]));
+    REQUIRE(graph.pool_bytes() * 2 == graph.unaliased_bytes());
+
+    // rebuilding the same graph reuses the pool
+    size_t pool_bytes = graph.pool_bytes();
+    graph.reset();
+    build_chain(graph);
+    graph.execute();
+    REQUIRE(graph.pool_bytes() == pool_bytes);
+}
+
+TEST_CASE(render_graph_culls_unused_passes)
+{
+    HeadlessContext context;
+    RenderGraph     graph;
+    auto            target = make_target(int2{8});
+
+    auto input  = graph.create_texture("input", {int2{8}});
+    auto unused = graph.create_texture("unused", {int2{8}});
+    auto output = graph.import_texture("output", target.get());
+
+    // added out of order: the graph must still run "input" first
+    graph.add_pass("final", {input}, {output}, no_draws);
+    graph.add_pass("unused", {input}, {unused}, no_draws);
+    graph.add_pass("input", {}, {input}, no_draws);
+    graph.execute();
+
+    // writing an imported texture keeps a pass alive, but nothing reads "unused"
+    REQUIRE((graph.schedule() == vector<string>{"input", "final"}));
+    REQUIRE(graph.culled_passes() == 1);
+
+    bool threw = false;
+    try
+    {
+        graph.texture(unused);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    REQUIRE(threw);
+}
+
+TEST_CASE(render_graph_follows_changed_imports)
+{
+    HeadlessContext context;
+    RenderGraph     graph;
+    auto            target = make_target(int2{8});
+
+    // run a single clearing pass into the imported target, checking the size of the framebuffer it renders into
+    auto run = [&graph](Texture *texture)
+    {
+        graph.reset();
+        auto output = graph.import_texture("output", texture);
+        int2 viewport{0};
+        graph.add_pass("clear", {}, {output},
+                       [&viewport](RenderGraph &, RenderPass &rp) { viewport = rp.viewport().second; });
+        graph.execute();
+        REQUIRE(viewport == texture->size());
+    };
+
+    run(target.get());
+
+    target->resize(int2{16});
+    run(target.get());
+
+    // a new texture, possibly at the same address: the pass must clear it rather than the freed one
+    target.reset();
+    target = make_target(int2{16});
+    vector<uint8_t> pixels(target->bytes(), 0xff);
+    target->upload(pixels.data());
+    run(target.get());
+    target->download(pixels.data());
+    REQUIRE(std::all_of(pixels.begin(), pixels.end(), [](uint8_t p) { return p == 0; }));
+}